@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "fixed_format.h"
+
+static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+								 100000000, 1000000000};
+
+BUILD_ASSERT(FIXED_FORMAT_MAX_DECIMALS < ARRAY_SIZE(pow10));
+
+/* Text being written into a caller buffer, always leaving room for the terminator */
+struct writer
+{
+	char *buf;
+	size_t size;
+	size_t len;
+	bool overflow;
+};
+
+static void put_char(struct writer *w, char c)
+{
+	if (w->len + 1 >= w->size)
+	{
+		w->overflow = true;
+		return;
+	}
+
+	w->buf[w->len++] = c;
+}
+
+static void put_str(struct writer *w, const char *str)
+{
+	while (*str != '\0')
+	{
+		put_char(w, *str++);
+	}
+}
+
+/* Writes value in decimal, zero padded to at least min_digits */
+static void put_uint(struct writer *w, uint64_t value, int min_digits)
+{
+	char digits[20];
+	int count = 0;
+
+	do
+	{
+		digits[count++] = '0' + (value % 10);
+		value /= 10;
+	} while ((value > 0) || (count < min_digits));
+
+	while (count > 0)
+	{
+		put_char(w, digits[--count]);
+	}
+}
+
+static void put_int(struct writer *w, int64_t value)
+{
+	if (value < 0)
+	{
+		put_char(w, '-');
+	}
+
+	put_uint(w, (value < 0) ? -(uint64_t)value : (uint64_t)value, 1);
+}
+
+/* Rounds |value| * 10^decimals to an integer from the exact binary value of the double, ties to
+ * even, like printf. |value| = mantissa / 2^shift, the product of the mantissa and 10^decimals
+ * needs up to 83 bits and is kept as hi * 2^32 + lo.
+ */
+static uint64_t scale_exact(uint64_t bits, uint8_t decimals)
+{
+	uint64_t mantissa = bits & (BIT64(52) - 1);
+	int exponent = (bits >> 52) & 0x7ff;
+	uint64_t hi, lo, q, rem_hi, rem_lo, half_hi, half_lo;
+	int shift;
+
+	if (exponent == 0)
+	{
+		/* Subnormal */
+		exponent = 1;
+	}
+	else
+	{
+		mantissa |= BIT64(52);
+	}
+
+	shift = 1075 - exponent;
+
+	if (shift <= 0)
+	{
+		return (mantissa << -shift) * pow10[decimals];
+	}
+
+	if (shift > 83)
+	{
+		/* Below half of the last decimal */
+		return 0;
+	}
+
+	lo = (mantissa & UINT32_MAX) * pow10[decimals];
+	hi = (mantissa >> 32) * pow10[decimals] + (lo >> 32);
+	lo &= UINT32_MAX;
+
+	/* Quotient and remainder of the division by 2^shift, half is 2^(shift - 1) */
+	if (shift > 32)
+	{
+		q = hi >> (shift - 32);
+		rem_hi = hi & (BIT64(shift - 32) - 1);
+		rem_lo = lo;
+		half_hi = BIT64(shift - 33);
+		half_lo = 0;
+	}
+	else
+	{
+		q = (hi << (32 - shift)) | (lo >> shift);
+		rem_hi = 0;
+		rem_lo = lo & (BIT64(shift) - 1);
+		half_hi = 0;
+		half_lo = BIT64(shift - 1);
+	}
+
+	if ((rem_hi > half_hi) || ((rem_hi == half_hi) && (rem_lo > half_lo)) ||
+		((rem_hi == half_hi) && (rem_lo == half_lo) && (q & 1)))
+	{
+		q++;
+	}
+
+	return q;
+}
+
+/* Writes a reading with a fixed number of decimals */
+static void put_fixed(struct writer *w, double value, uint8_t decimals)
+{
+	uint64_t bits;
+	uint64_t magnitude;
+
+	memcpy(&bits, &value, sizeof(bits));
+	magnitude = scale_exact(bits, decimals);
+
+	/* Like printf, a negative reading keeps its sign when it rounds to zero, so does -0.0 */
+	if (bits & BIT64(63))
+	{
+		put_char(w, '-');
+	}
+
+	put_uint(w, magnitude / pow10[decimals], 1);
+
+	if (decimals > 0)
+	{
+		put_char(w, '.');
+		put_uint(w, magnitude % pow10[decimals], decimals);
+	}
+}
+
+static int writer_finish(struct writer *w)
+{
+	if (w->size > 0)
+	{
+		w->buf[w->len] = '\0';
+	}
+
+	return w->overflow ? -ENOMEM : (int)w->len;
+}
+
+int fixed_format(char *buf, size_t size, double value, uint8_t decimals)
+{
+	struct writer w = {.buf = buf, .size = size};
+
+	__ASSERT_NO_MSG(decimals <= FIXED_FORMAT_MAX_DECIMALS);
+
+	put_fixed(&w, value, decimals);
+
+	return writer_finish(&w);
+}
+
+/* Writes a member name, including its separator, and a reading as quoted string */
+static void put_quoted_fixed(struct writer *w, const char *name, double value, uint8_t decimals)
+{
+	put_str(w, name);
+	put_char(w, '"');
+	put_fixed(w, value, decimals);
+	put_char(w, '"');
+}
+
+int gnss_json_format(const struct velopera_gps_data *gps, char *buf, size_t size)
+{
+	const struct nrf_modem_gnss_pvt_data_frame *pvt = &gps->pvt;
+	const struct nrf_modem_gnss_datetime *dt = &pvt->datetime;
+	uint64_t uptime_us = k_cyc_to_us_floor64(gps->timestamp);
+	struct writer w = {.buf = buf, .size = size};
+
+	put_quoted_fixed(&w, "{\"Latitude\":", pvt->latitude, 6);
+	put_quoted_fixed(&w, ",\"Longitude\":", pvt->longitude, 6);
+	put_quoted_fixed(&w, ",\"Altitude\":", pvt->altitude, 1);
+	put_quoted_fixed(&w, ",\"Accuracy\":", pvt->accuracy, 1);
+	put_quoted_fixed(&w, ",\"Speed\":", pvt->speed, 1);
+	put_quoted_fixed(&w, ",\"Speed accuracy\":", pvt->speed_accuracy, 1);
+	put_quoted_fixed(&w, ",\"Heading\":", pvt->heading, 1);
+
+	put_str(&w, ",\"Date\":\"");
+	put_uint(&w, dt->year, 4);
+	put_char(&w, '-');
+	put_uint(&w, dt->month, 2);
+	put_char(&w, '-');
+	put_uint(&w, dt->day, 2);
+
+	put_str(&w, "\",\"Time\":\"");
+	put_uint(&w, dt->hour, 2);
+	put_char(&w, ':');
+	put_uint(&w, dt->minute, 2);
+	put_char(&w, ':');
+	put_uint(&w, dt->seconds, 2);
+	put_char(&w, '.');
+	put_uint(&w, dt->ms, 3);
+	put_char(&w, '"');
+
+	put_quoted_fixed(&w, ",\"PDOP\":", pvt->pdop, 1);
+	put_quoted_fixed(&w, ",\"HDOP\":", pvt->hdop, 1);
+	put_quoted_fixed(&w, ",\"VDOP\":", pvt->vdop, 1);
+	put_quoted_fixed(&w, ",\"TDOP\":", pvt->tdop, 1);
+
+	put_str(&w, ",\"measId\":");
+	put_int(&w, gps->meas_id);
+
+	put_str(&w, ",\"uptime\":");
+	put_uint(&w, uptime_us / USEC_PER_SEC, 1);
+	put_char(&w, '.');
+	put_uint(&w, uptime_us % USEC_PER_SEC, 6);
+	put_char(&w, '}');
+
+	return writer_finish(&w);
+}
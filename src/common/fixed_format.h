@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Formatting of measurements without floating point printf support.
+ *
+ * Readings are scaled to integers once and the digits are generated with integer arithmetic only,
+ * so the firmware does not need CONFIG_PICOLIBC_IO_FLOAT.
+ */
+
+#ifndef FIXED_FORMAT_H__
+#define FIXED_FORMAT_H__
+
+#include <zephyr/kernel.h>
+
+#include "message_channel.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Maximum number of decimals supported by fixed_format() */
+#define FIXED_FORMAT_MAX_DECIMALS 9
+
+	/**
+	 * @brief Formats a reading with a fixed number of decimals, like printf("%.*f").
+	 *
+	 * The exact binary value of the reading is rounded half to even, as printf does, so the
+	 * text is the same as printf("%.*f") gives. Readings beyond +-2^63 / 10^decimals,
+	 * infinities and NaN are not supported.
+	 *
+	 * @param buf output buffer, the text is null-terminated
+	 * @param size size of the output buffer
+	 * @param value reading
+	 * @param decimals number of decimals, up to FIXED_FORMAT_MAX_DECIMALS
+	 *
+	 * @return Number of characters written, without the terminator.
+	 * @retval -ENOMEM if the buffer is too small.
+	 */
+	int fixed_format(char *buf, size_t size, double value, uint8_t decimals);
+
+	/**
+	 * @brief Formats a GPS fix as JSON object, the same text as printf with the former
+	 *	  GNSS_DATA_JSON format.
+	 *
+	 * @param gps GPS fix
+	 * @param buf output buffer, the text is null-terminated
+	 * @param size size of the output buffer
+	 *
+	 * @return Number of characters written, without the terminator.
+	 * @retval -ENOMEM if the buffer is too small.
+	 */
+	int gnss_json_format(const struct velopera_gps_data *gps, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FIXED_FORMAT_H__ */
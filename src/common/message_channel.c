@@ -9,6 +9,30 @@
 #include <zephyr/zbus/zbus.h>
 
 #include "message_channel.h"
+#include "payload_buf.h"
+
+#if defined(CONFIG_MQTT_SAMPLE_AGGREGATOR) && defined(CONFIG_MQTT_SAMPLE_REPLAY)
+#define NINA_DATA_CHAN_OBSERVERS ZBUS_OBSERVERS(aggregator, replay)
+#elif defined(CONFIG_MQTT_SAMPLE_AGGREGATOR)
+#define NINA_DATA_CHAN_OBSERVERS ZBUS_OBSERVERS(aggregator)
+#elif defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES) && defined(CONFIG_MQTT_SAMPLE_REPLAY)
+#define NINA_DATA_CHAN_OBSERVERS ZBUS_OBSERVERS(transport, replay)
+#elif defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+#define NINA_DATA_CHAN_OBSERVERS ZBUS_OBSERVERS(transport)
+#elif defined(CONFIG_MQTT_SAMPLE_REPLAY)
+#define NINA_DATA_CHAN_OBSERVERS ZBUS_OBSERVERS(replay)
+#else
+#define NINA_DATA_CHAN_OBSERVERS ZBUS_OBSERVERS_EMPTY
+#endif /* CONFIG_MQTT_SAMPLE_AGGREGATOR && CONFIG_MQTT_SAMPLE_REPLAY */
+
+/* The transport_payload listener takes a reference to the line before transport is notified */
+#if defined(CONFIG_MQTT_SAMPLE_REPLAY)
+#define MQTT_CHAN_OBSERVERS ZBUS_OBSERVERS(transport_payload, transport, replay)
+#define QUEUE_STATUS_CHAN_OBSERVERS ZBUS_OBSERVERS(trigger, replay)
+#else
+#define MQTT_CHAN_OBSERVERS ZBUS_OBSERVERS(transport_payload, transport)
+#define QUEUE_STATUS_CHAN_OBSERVERS ZBUS_OBSERVERS(trigger)
+#endif /* CONFIG_MQTT_SAMPLE_REPLAY */
 
 /* Define FOTA_CHAN */
 ZBUS_CHAN_DEFINE(FOTA_CHAN,							  /* Name */
@@ -19,15 +43,23 @@ ZBUS_CHAN_DEFINE(FOTA_CHAN,							  /* Name */
 				 ZBUS_MSG_INIT(0)					  /* Initial value {0} */
 );
 
-/* Define MQTT_CHAN */
+/* Define MQTT_CHAN, a reference to a payload buffer, see payload_buf.h */
 ZBUS_CHAN_DEFINE(MQTT_CHAN,
-				 struct velopera_payload,
+				 struct net_buf *,
 				 NULL,
 				 NULL,
-				 ZBUS_OBSERVERS(transport),
+				 MQTT_CHAN_OBSERVERS,
+				 ZBUS_MSG_INIT(0));
+
+/* Define NINA_DATA_CHAN */
+ZBUS_CHAN_DEFINE(NINA_DATA_CHAN,
+				 struct velopera_nina_data,
+				 NULL,
+				 NULL,
+				 NINA_DATA_CHAN_OBSERVERS,
 				 ZBUS_MSG_INIT(0));
 
-/* Define MQTT_CHAN */
+/* Define GPS_CHAN */
 ZBUS_CHAN_DEFINE(GPS_CHAN,
 				 struct velopera_gps_data,
 				 NULL,
@@ -43,6 +75,22 @@ ZBUS_CHAN_DEFINE(NETWORK_CHAN,
 				 ZBUS_OBSERVERS(transport),
 				 ZBUS_MSG_INIT(0));
 
+/* Define QUEUE_STATUS_CHAN */
+ZBUS_CHAN_DEFINE(QUEUE_STATUS_CHAN,
+				 struct velopera_queue_status,
+				 NULL,
+				 NULL,
+				 QUEUE_STATUS_CHAN_OBSERVERS,
+				 ZBUS_MSG_INIT(0));
+
+/* Define TRIGGER_STATS_CHAN, read when needed */
+ZBUS_CHAN_DEFINE(TRIGGER_STATS_CHAN,
+				 struct velopera_trigger_stats,
+				 NULL,
+				 NULL,
+				 ZBUS_OBSERVERS_EMPTY,
+				 ZBUS_MSG_INIT(0));
+
 /* Define FATAL_ERROR_CHAN */
 ZBUS_CHAN_DEFINE(FATAL_ERROR_CHAN,
 				 int,
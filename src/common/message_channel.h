@@ -12,13 +12,12 @@
 #include <zephyr/logging/log_ctrl.h>
 #include <nrf_modem_gnss.h>
 
+#include "nina_data.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
-#define GNSS_DATA_JSON \
-	"{\"Latitude\":\"%.06f\",\"Longitude\":\"%.06f\",\"Altitude\":\"%.01f\",\"Accuracy\":\"%.01f\",\"Speed\":\"%.01f\",\"Speed accuracy\":\"%.01f\",\"Heading\":\"%.01f\",\"Date\":\"%04u-%02u-%02u\",\"Time\":\"%02u:%02u:%02u.%03u\",\"PDOP\":\"%.01f\",\"HDOP\":\"%.01f\",\"VDOP\":\"%.01f\",\"TDOP\":\"%.01f\",\"measId\":%d}"
-
 /** @brief Macro used to send a message on the FATAL_ERROR_CHANNEL.
  *	   The message will be handled in the error module.
  */
@@ -31,14 +30,47 @@ extern "C"
 		IF_ENABLED(CONFIG_REBOOT, (sys_reboot(0)));                                \
 	}
 
+	/** Line assembled by a producer, published on MQTT_CHAN in a payload buffer, see payload_buf.h */
 	struct velopera_payload
 	{
 		char string[700];
+
+		/** Uptime in hardware cycles when the line was completely received, see k_cycle_get_64(). */
+		uint64_t timestamp;
 	};
 	struct velopera_gps_data
 	{
 		int meas_id;
 		struct nrf_modem_gnss_pvt_data_frame pvt;
+
+		/** Uptime in hardware cycles of the fix event, see k_cycle_get_64(). */
+		uint64_t timestamp;
+	};
+	/** Fill level of the transport sensor data queue in bytes, used for backpressure. */
+	struct velopera_queue_status
+	{
+		uint32_t used;
+		uint32_t capacity;
+	};
+	/** Line counters of the trigger module since boot, published on TRIGGER_STATS_CHAN. */
+	struct velopera_trigger_stats
+	{
+		/** Lines published on MQTT_CHAN */
+		uint32_t published;
+		/** Lines with known signals only, published on NINA_DATA_CHAN alone */
+		uint32_t typed;
+		/** Lines dropped because the RX line ring was full, with the asynchronous API the
+		 *  lines longer than an RX buffer plus the RX chunks dropped
+		 */
+		uint32_t rx_dropped;
+		/** Lines dropped because the payload buffer pool was full */
+		uint32_t payload_buf_drops;
+		/** Lines dropped by the JSON filter */
+		uint32_t json_rejects;
+		/** Lines of rx_dropped the start of which had been received already */
+		uint32_t incomplete;
+		/** Lines published truncated */
+		uint32_t truncated;
 	};
 	enum network_status
 	{
@@ -56,6 +88,7 @@ extern "C"
 	};
 
 	/* Declare the zbus channels */
-	ZBUS_CHAN_DECLARE(FOTA_CHAN, MQTT_CHAN, GPS_CHAN, NETWORK_CHAN, FATAL_ERROR_CHAN);
+	ZBUS_CHAN_DECLARE(FOTA_CHAN, MQTT_CHAN, NINA_DATA_CHAN, GPS_CHAN, NETWORK_CHAN,
+					  QUEUE_STATUS_CHAN, TRIGGER_STATS_CHAN, FATAL_ERROR_CHAN);
 
 #endif /* _MESSAGE_CHANNEL_H_ */
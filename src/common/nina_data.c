@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include "nina_data.h"
+
+const struct nina_signal_schema nina_schema[NINA_SIGNAL_COUNT] = {
+	[NINA_SIGNAL_SPEED] = {.name = "speed", .decimals = 2},
+	[NINA_SIGNAL_CADENCE] = {.name = "cadence", .decimals = 0},
+	[NINA_SIGNAL_BATTERY] = {.name = "battery", .decimals = 1},
+	[NINA_SIGNAL_MOTOR_CURRENT] = {.name = "motorCurrent", .decimals = 3},
+	[NINA_SIGNAL_HEADING] = {.name = "heading", .decimals = 1},
+	[NINA_SIGNAL_PITCH] = {.name = "pitch", .decimals = 1},
+	[NINA_SIGNAL_ROLL] = {.name = "roll", .decimals = 1},
+};
+
+static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000,
+								 100000000, 1000000000};
+
+/* Mantissa digits beyond this are only counted in the exponent */
+#define MANTISSA_LIMIT 100000000000000000LL
+
+static bool is_digit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+static bool is_space(char c)
+{
+	return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+}
+
+static const char *skip_space(const char *p, const char *end)
+{
+	while ((p < end) && is_space(*p))
+	{
+		p++;
+	}
+
+	return p;
+}
+
+/* Returns the end of the string starting at p, past the closing quote, or NULL if unterminated */
+static const char *string_end(const char *p, const char *end)
+{
+	for (p++; p < end; p++)
+	{
+		if (*p == '\\')
+		{
+			p++;
+		}
+		else if (*p == '"')
+		{
+			return p + 1;
+		}
+	}
+
+	return NULL;
+}
+
+static int signal_lookup(const char *name, size_t len)
+{
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		if ((strncmp(nina_schema[i].name, name, len) == 0) && (nina_schema[i].name[len] == '\0'))
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/* Parses a JSON number into a fixed-point value with the given number of decimals, rounding half
+ * away from zero. Returns the end of the number, or NULL if it is malformed or out of range.
+ */
+static const char *parse_fixed(const char *p, const char *end, uint8_t decimals, int32_t *value)
+{
+	bool negative = false;
+	bool fraction = false;
+	int64_t mantissa = 0;
+	int exponent = decimals;
+	int digits = 0;
+
+	if ((p < end) && (*p == '-'))
+	{
+		negative = true;
+		p++;
+	}
+
+	for (; p < end; p++)
+	{
+		if (is_digit(*p))
+		{
+			if (mantissa < MANTISSA_LIMIT)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent -= fraction;
+			}
+			else
+			{
+				exponent += !fraction;
+			}
+			digits++;
+		}
+		else if ((*p == '.') && !fraction)
+		{
+			fraction = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (digits == 0)
+	{
+		return NULL;
+	}
+
+	if ((p < end) && ((*p == 'e') || (*p == 'E')))
+	{
+		bool exp_negative = false;
+		int exp = 0;
+
+		digits = 0;
+		p++;
+
+		if ((p < end) && ((*p == '+') || (*p == '-')))
+		{
+			exp_negative = (*p == '-');
+			p++;
+		}
+
+		for (; (p < end) && is_digit(*p); p++)
+		{
+			exp = MIN(exp * 10 + (*p - '0'), 1000);
+			digits++;
+		}
+
+		if (digits == 0)
+		{
+			return NULL;
+		}
+
+		exponent += exp_negative ? -exp : exp;
+	}
+
+	if (mantissa == 0)
+	{
+		exponent = 0;
+	}
+
+	for (; exponent > 0; exponent--)
+	{
+		if (mantissa > INT32_MAX)
+		{
+			return NULL;
+		}
+		mantissa *= 10;
+	}
+
+	/* Truncate all but the first dropped digit, which decides the rounding */
+	for (; (exponent < -1) && (mantissa > 0); exponent++)
+	{
+		mantissa /= 10;
+	}
+
+	if (exponent == -1)
+	{
+		mantissa = (mantissa + 5) / 10;
+	}
+	else if (exponent < -1)
+	{
+		mantissa = 0;
+	}
+
+	if (mantissa > INT32_MAX)
+	{
+		return NULL;
+	}
+
+	*value = negative ? -(int32_t)mantissa : (int32_t)mantissa;
+
+	return p;
+}
+
+/* Parses the value of a known signal. Returns false if it is not a number or boolean. */
+static bool parse_value(const char *p, const char *end, uint8_t decimals, int32_t *value)
+{
+	if (p == end)
+	{
+		return false;
+	}
+
+	switch (*p)
+	{
+	case '"':
+		p = parse_fixed(p + 1, end, decimals, value);
+		return (p != NULL) && (p < end) && (*p == '"');
+	case 't':
+	case 'f':
+		if (((size_t)(end - p) >= 4) && (memcmp(p, "true", 4) == 0))
+		{
+			*value = pow10[decimals];
+			return true;
+		}
+		if (((size_t)(end - p) >= 5) && (memcmp(p, "false", 5) == 0))
+		{
+			*value = 0;
+			return true;
+		}
+		return false;
+	default:
+		p = parse_fixed(p, end, decimals, value);
+		return (p != NULL) && ((p == end) || is_space(*p) || (*p == ',') || (*p == '}') ||
+							   (*p == ']'));
+	}
+}
+
+int nina_data_parse(const char *json, size_t len, struct velopera_nina_data *data,
+					uint32_t *others)
+{
+	const char *end = json + len;
+	const char *p = json;
+	int found = 0;
+
+	data->present = 0;
+	*others = 0;
+
+	while (p < end)
+	{
+		const char *name;
+		size_t name_len;
+		int signal;
+
+		if (*p != '"')
+		{
+			p++;
+			continue;
+		}
+
+		/* A string followed by a colon is a member name, any other string is skipped */
+		name = p + 1;
+		p = string_end(p, end);
+		if (p == NULL)
+		{
+			return -EBADMSG;
+		}
+
+		name_len = p - 1 - name;
+		p = skip_space(p, end);
+
+		if ((p == end) || (*p != ':'))
+		{
+			continue;
+		}
+
+		p = skip_space(p + 1, end);
+		signal = signal_lookup(name, name_len);
+
+		if ((signal >= 0) &&
+			parse_value(p, end, nina_schema[signal].decimals, &data->value[signal]))
+		{
+			found += !(data->present & BIT(signal));
+			data->present |= BIT(signal);
+		}
+		else if ((p == end) || (*p != '{'))
+		{
+			(*others)++;
+		}
+	}
+
+	return found;
+}
+
+int nina_data_format(enum nina_signal signal, int32_t value, char *buf, size_t size)
+{
+	uint8_t decimals = nina_schema[signal].decimals;
+	uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+
+	__ASSERT_NO_MSG(decimals < ARRAY_SIZE(pow10));
+
+	if (decimals == 0)
+	{
+		return snprintf(buf, size, "%d", value);
+	}
+
+	return snprintf(buf, size, "%s%u.%0*u", (value < 0) ? "-" : "", magnitude / pow10[decimals],
+					decimals, magnitude % pow10[decimals]);
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Typed representation of the CAN and compass messages of the Nina module.
+ *
+ * Every known JSON member of a Nina message maps to one signal. Signal values are stored as
+ * fixed-point integers, value = reading * 10^decimals, with the number of decimals given by the
+ * schema. The schema table in nina_data.c has to match the member names sent by the Nina
+ * firmware, messages may carry any subset of the signals.
+ */
+
+#ifndef NINA_DATA_H__
+#define NINA_DATA_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	enum nina_signal
+	{
+		/** Vehicle speed, km/h */
+		NINA_SIGNAL_SPEED,
+		/** Pedalling cadence, rpm */
+		NINA_SIGNAL_CADENCE,
+		/** Battery state of charge, % */
+		NINA_SIGNAL_BATTERY,
+		/** Motor current, A */
+		NINA_SIGNAL_MOTOR_CURRENT,
+		/** Compass heading, degrees */
+		NINA_SIGNAL_HEADING,
+		/** Pitch, degrees */
+		NINA_SIGNAL_PITCH,
+		/** Roll, degrees */
+		NINA_SIGNAL_ROLL,
+
+		NINA_SIGNAL_COUNT,
+	};
+
+	struct nina_signal_schema
+	{
+		/** JSON member name */
+		const char *name;
+
+		/** Number of decimals kept in the fixed-point value */
+		uint8_t decimals;
+	};
+
+	/** Schema of all signals, indexed by enum nina_signal. */
+	extern const struct nina_signal_schema nina_schema[NINA_SIGNAL_COUNT];
+
+	/** One parsed Nina message. */
+	struct velopera_nina_data
+	{
+		/** Uptime in hardware cycles when the message was received, see k_cycle_get_64(). */
+		uint64_t timestamp;
+
+		/** Bit n is set if value[n] was present in the message. */
+		uint32_t present;
+
+		/** Fixed-point signal values, indexed by enum nina_signal. */
+		int32_t value[NINA_SIGNAL_COUNT];
+	};
+
+	BUILD_ASSERT(NINA_SIGNAL_COUNT <= 32, "The presence mask holds 32 signals");
+
+	/**
+	 * @brief Extracts the known signals from a Nina JSON message without allocating.
+	 *
+	 * Members are matched by name at any nesting depth. Numbers and strings holding a number
+	 * are accepted as values, true and false are stored as 1 and 0. Unknown members, values of
+	 * other types and values that do not fit the fixed-point range are skipped.
+	 *
+	 * @param json JSON text, does not need to be null-terminated
+	 * @param len length of the text
+	 * @param data parsed signals, present is cleared first, timestamp is left untouched
+	 * @param others number of the other members, unknown ones and known ones without a valid
+	 *               value. Members holding an object are not counted, their members are.
+	 *
+	 * @return Number of signals found.
+	 * @retval -EBADMSG if a string in the text is not terminated.
+	 */
+	int nina_data_parse(const char *json, size_t len, struct velopera_nina_data *data,
+						uint32_t *others);
+
+	/**
+	 * @brief Formats a fixed-point signal value as a JSON number.
+	 *
+	 * @param signal signal the value belongs to
+	 * @param value fixed-point value
+	 * @param buf output buffer
+	 * @param size size of the output buffer
+	 *
+	 * @return Number of characters written, as snprintf().
+	 */
+	int nina_data_format(enum nina_signal signal, int32_t value, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NINA_DATA_H__ */
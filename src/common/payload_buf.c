@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+
+#include "payload_buf.h"
+
+/* The user data of a buffer holds the reception timestamp */
+NET_BUF_POOL_VAR_DEFINE(payload_pool, CONFIG_MQTT_SAMPLE_PAYLOAD_BUF_COUNT,
+						CONFIG_MQTT_SAMPLE_PAYLOAD_BUF_POOL_SIZE, sizeof(uint64_t), NULL);
+
+struct net_buf *payload_buf_get(size_t len)
+{
+	return net_buf_alloc_len(&payload_pool, len + PAYLOAD_BUF_TAILROOM, K_NO_WAIT);
+}
+
+size_t payload_buf_room(struct net_buf *buf)
+{
+	return net_buf_tailroom(buf) - PAYLOAD_BUF_TAILROOM;
+}
+
+void payload_buf_finish(struct net_buf *buf, uint64_t timestamp)
+{
+	buf->data[buf->len] = '\0';
+	memcpy(net_buf_user_data(buf), &timestamp, sizeof(timestamp));
+}
+
+struct net_buf *payload_buf_alloc(const char *line, size_t len, uint64_t timestamp)
+{
+	struct net_buf *buf = payload_buf_get(len);
+
+	if (buf == NULL)
+	{
+		return NULL;
+	}
+
+	net_buf_add_mem(buf, line, len);
+	payload_buf_finish(buf, timestamp);
+
+	return buf;
+}
+
+int payload_buf_member_add(struct net_buf *buf, const char *member)
+{
+	char *line = (char *)buf->data;
+	size_t len = strlen(member);
+	size_t first = 0;
+	size_t last = buf->len;
+	size_t prev;
+	bool empty;
+
+	while ((first < last) && isspace((unsigned char)line[first]))
+	{
+		first++;
+	}
+
+	while ((last > first) && isspace((unsigned char)line[last - 1]))
+	{
+		last--;
+	}
+
+	if ((last - first < 2) || (line[first] != '{') || (line[last - 1] != '}'))
+	{
+		return -EINVAL;
+	}
+
+	/* No separator in an empty object */
+	prev = last - 1;
+
+	while (isspace((unsigned char)line[prev - 1]))
+	{
+		prev--;
+	}
+
+	empty = (prev - 1 == first);
+
+	/* Separator, member, closing brace and terminator in place of the closing brace */
+	if ((last - 1) + !empty + len + 2 > buf->len + net_buf_tailroom(buf))
+	{
+		return -ENOMEM;
+	}
+
+	buf->len = last - 1;
+
+	if (!empty)
+	{
+		net_buf_add_u8(buf, ',');
+	}
+
+	net_buf_add_mem(buf, member, len);
+	net_buf_add_u8(buf, '}');
+	buf->data[buf->len] = '\0';
+
+	return 0;
+}
+
+uint64_t payload_buf_timestamp(const struct net_buf *buf)
+{
+	uint64_t timestamp;
+
+	memcpy(&timestamp, net_buf_user_data(buf), sizeof(timestamp));
+
+	return timestamp;
+}
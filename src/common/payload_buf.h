@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Variable length payload buffers, the messages of MQTT_CHAN.
+ *
+ * A line is written into a net_buf sized to its length, with its reception timestamp as user
+ * data, and only a reference to the buffer is published on MQTT_CHAN. Producers that frame a line
+ * piece by piece add the pieces to the buffer directly, see payload_buf_get(). Observers that keep the
+ * line take their own reference with net_buf_ref() in their callback, the publisher releases its
+ * reference with net_buf_unref() once zbus_chan_pub() has returned.
+ *
+ * The line is NUL terminated behind its length, and has PAYLOAD_BUF_TAILROOM bytes of room for
+ * members added on the way, like the "uptime" of the transport.
+ */
+
+#ifndef PAYLOAD_BUF_H__
+#define PAYLOAD_BUF_H__
+
+#include <zephyr/kernel.h>
+#include <zephyr/net/buf.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Bytes of room behind the line, including its terminator */
+#define PAYLOAD_BUF_TAILROOM 40
+
+/** Longest line, longer ones are truncated */
+#define PAYLOAD_BUF_LINE_MAX 699
+
+	/**
+	 * @brief Allocates an empty payload buffer, without waiting.
+	 *
+	 * The line is added with net_buf_add_mem() or written to net_buf_tail() and added with
+	 * net_buf_add(), up to payload_buf_room() bytes, and completed by payload_buf_finish().
+	 *
+	 * @param len longest line the buffer has to hold
+	 *
+	 * @return Empty buffer, or NULL if the pool has no room for it.
+	 */
+	struct net_buf *payload_buf_get(size_t len);
+
+	/**
+	 * @brief Returns the number of bytes that can still be added to the line, see
+	 *        payload_buf_get().
+	 */
+	size_t payload_buf_room(struct net_buf *buf);
+
+	/**
+	 * @brief Terminates the line of a buffer and sets its reception timestamp.
+	 *
+	 * @param buf buffer returned by payload_buf_get()
+	 * @param timestamp uptime in hardware cycles when the line was received, see
+	 *                  k_cycle_get_64()
+	 */
+	void payload_buf_finish(struct net_buf *buf, uint64_t timestamp);
+
+	/**
+	 * @brief Allocates a payload buffer for a line, without waiting.
+	 *
+	 * @param line line, does not have to be NUL terminated
+	 * @param len length of the line
+	 * @param timestamp uptime in hardware cycles when the line was received, see
+	 *                  k_cycle_get_64()
+	 *
+	 * @return Buffer holding the line, or NULL if the pool has no room for it.
+	 */
+	struct net_buf *payload_buf_alloc(const char *line, size_t len, uint64_t timestamp);
+
+	/**
+	 * @brief Adds a member to the JSON object of a line, in the tailroom of its buffer.
+	 *
+	 * Only a line holding one object, a '{' and its '}' as first and last non-whitespace
+	 * characters, is changed. Whitespace behind the object is dropped. Other lines, like arrays
+	 * and plain text, are left as they are.
+	 *
+	 * @param buf buffer holding a line, see payload_buf_finish()
+	 * @param member member to add, like "\"uptime\":12.000345"
+	 *
+	 * @return 0 if the member was added, -EINVAL if the line is not an object, -ENOMEM if the
+	 *         buffer has no room for the member.
+	 */
+	int payload_buf_member_add(struct net_buf *buf, const char *member);
+
+	/**
+	 * @brief Returns the reception timestamp of a line, see payload_buf_alloc().
+	 */
+	uint64_t payload_buf_timestamp(const struct net_buf *buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PAYLOAD_BUF_H__ */
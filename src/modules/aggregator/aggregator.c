@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "message_channel.h"
+#include "payload_buf.h"
+
+/* Register log module */
+LOG_MODULE_REGISTER(aggregator, CONFIG_MQTT_SAMPLE_AGGREGATOR_LOG_LEVEL);
+
+/* Parsed messages handed over from the listener to aggregator_task */
+K_MSGQ_DEFINE(sample_queue, sizeof(struct velopera_nina_data),
+			  CONFIG_MQTT_SAMPLE_AGGREGATOR_QUEUE_SIZE, 4);
+
+/* Window length per signal, 0 for passthrough */
+static const uint32_t window_ms[NINA_SIGNAL_COUNT] = {
+	[NINA_SIGNAL_SPEED] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_SPEED_MS,
+	[NINA_SIGNAL_CADENCE] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_CADENCE_MS,
+	[NINA_SIGNAL_BATTERY] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_BATTERY_MS,
+	[NINA_SIGNAL_MOTOR_CURRENT] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_MOTOR_CURRENT_MS,
+	[NINA_SIGNAL_HEADING] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_HEADING_MS,
+	[NINA_SIGNAL_PITCH] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_PITCH_MS,
+	[NINA_SIGNAL_ROLL] = CONFIG_MQTT_SAMPLE_AGGREGATOR_WINDOW_ROLL_MS,
+};
+
+/* Running statistics of one signal, the window opens with its first sample */
+struct window
+{
+	int64_t end;
+	uint32_t count;
+	int32_t min;
+	int32_t max;
+	int32_t last;
+	int64_t sum;
+};
+
+static struct window windows[NINA_SIGNAL_COUNT];
+
+#if defined(CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND)
+
+static const int32_t deadband[NINA_SIGNAL_COUNT] = {
+	[NINA_SIGNAL_SPEED] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_SPEED,
+	[NINA_SIGNAL_CADENCE] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_CADENCE,
+	[NINA_SIGNAL_BATTERY] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_BATTERY,
+	[NINA_SIGNAL_MOTOR_CURRENT] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_MOTOR_CURRENT,
+	[NINA_SIGNAL_HEADING] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_HEADING,
+	[NINA_SIGNAL_PITCH] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_PITCH,
+	[NINA_SIGNAL_ROLL] = CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND_ROLL,
+};
+
+#define MAX_SILENCE_MS (CONFIG_MQTT_SAMPLE_AGGREGATOR_MAX_SILENCE_S * MSEC_PER_SEC)
+#define KEYFRAME_MS (CONFIG_MQTT_SAMPLE_AGGREGATOR_KEYFRAME_S * MSEC_PER_SEC)
+
+/* Last received and last sent value of one signal */
+struct field
+{
+	bool received;
+	int32_t latest;
+	bool sent_valid;
+	int32_t sent;
+	int64_t sent_at;
+};
+
+static struct field fields[NINA_SIGNAL_COUNT];
+static int64_t keyframe_at = KEYFRAME_MS;
+
+static uint32_t fields_sent;
+static uint32_t fields_suppressed;
+
+#endif /* CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND */
+
+/* JSON object being built for publishing on MQTT_CHAN */
+static struct velopera_payload out;
+static size_t out_len;
+
+/* Statistics */
+static uint32_t samples_received;
+static uint32_t samples_dropped;
+static uint32_t summaries_published;
+static uint32_t objects_dropped;
+
+static void aggregator_callback(const struct zbus_channel *chan)
+{
+	if (&NINA_DATA_CHAN != chan)
+	{
+		return;
+	}
+
+	if (k_msgq_put(&sample_queue, zbus_chan_const_msg(chan), K_NO_WAIT))
+	{
+		samples_dropped++;
+		LOG_WRN("Sample queue full, %d samples dropped in total", samples_dropped);
+	}
+}
+
+/* Register listener - aggregator_callback is called everytime a parsed Nina message is
+ * published.
+ */
+ZBUS_LISTENER_DEFINE(aggregator, aggregator_callback);
+
+static void out_begin(uint64_t timestamp)
+{
+	out.string[0] = '{';
+	out_len = 1;
+	out.timestamp = timestamp;
+}
+
+/* Publishes the object on MQTT_CHAN, as reference to a payload buffer sized to the object */
+static void out_publish(void)
+{
+	struct net_buf *buf;
+	int err;
+
+	if (out_len <= 1)
+	{
+		return;
+	}
+
+	out.string[out_len++] = '}';
+
+	buf = payload_buf_alloc(out.string, out_len, out.timestamp);
+	out_begin(out.timestamp);
+	if (buf == NULL)
+	{
+		objects_dropped++;
+		LOG_WRN("Payload buffers full, object dropped, %d in total", objects_dropped);
+		return;
+	}
+
+	err = zbus_chan_pub(&MQTT_CHAN, &buf, K_SECONDS(10));
+	net_buf_unref(buf);
+	if (err)
+	{
+		LOG_ERR("zbus_chan_pub, error:%d", err);
+		SEND_FATAL_ERROR();
+	}
+}
+
+/* Adds one member to the object, publishing the object first if the member does not fit */
+static void out_add(const char *member, size_t len)
+{
+	/* Separator, closing brace and terminator */
+	if (out_len + len + 3 > sizeof(out.string))
+	{
+		out_publish();
+	}
+
+	if (out_len > 1)
+	{
+		out.string[out_len++] = ',';
+	}
+
+	memcpy(&out.string[out_len], member, len);
+	out_len += len;
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND)
+
+static bool within_deadband(int signal, int32_t reference, int32_t value)
+{
+	int64_t delta = (int64_t)value - reference;
+
+	return (delta >= -deadband[signal]) && (delta <= deadband[signal]);
+}
+
+/* Decides whether a signal is sent. Values in [min, max] that all stay within the deadband of the
+ * last sent value are suppressed until the maximum silence interval expires. value is remembered
+ * as the last sent value.
+ */
+static bool field_send(int signal, int32_t value, int32_t min, int32_t max, int64_t now)
+{
+	struct field *f = &fields[signal];
+
+	if (f->sent_valid && within_deadband(signal, f->sent, min) &&
+		within_deadband(signal, f->sent, max) && (now - f->sent_at < MAX_SILENCE_MS))
+	{
+		fields_suppressed++;
+		return false;
+	}
+
+	f->sent_valid = true;
+	f->sent = value;
+	f->sent_at = now;
+	fields_sent++;
+
+	return true;
+}
+
+/* Publishes the latest value of every signal received so far */
+static void keyframe_publish(int64_t now)
+{
+	static const char keyframe[] = "\"keyframe\":true";
+	char member[48];
+	char value[16];
+	int len;
+
+	keyframe_at = now + KEYFRAME_MS;
+
+	if (fields_sent == 0)
+	{
+		/* Nothing received yet */
+		return;
+	}
+
+	out_begin(k_cycle_get_64());
+	out_add(keyframe, sizeof(keyframe) - 1);
+
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		struct field *f = &fields[i];
+
+		if (!f->received)
+		{
+			continue;
+		}
+
+		nina_data_format(i, f->latest, value, sizeof(value));
+		len = snprintf(member, sizeof(member), "\"%s\":%s", nina_schema[i].name, value);
+		out_add(member, len);
+
+		f->sent_valid = true;
+		f->sent = f->latest;
+		f->sent_at = now;
+	}
+
+	out_publish();
+
+	LOG_DBG("fields sent: %d, suppressed: %d", fields_sent, fields_suppressed);
+}
+
+#else
+
+static bool field_send(int signal, int32_t value, int32_t min, int32_t max, int64_t now)
+{
+	return true;
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND */
+
+/* Publishes the signals of a sample that are not aggregated */
+static void passthrough(const struct velopera_nina_data *sample, int64_t now)
+{
+	char member[48];
+	char value[16];
+	int len;
+
+	out_begin(sample->timestamp);
+
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		int32_t v = sample->value[i];
+
+		if (!(sample->present & BIT(i)) || window_ms[i] || !field_send(i, v, v, v, now))
+		{
+			continue;
+		}
+
+		nina_data_format(i, sample->value[i], value, sizeof(value));
+		len = snprintf(member, sizeof(member), "\"%s\":%s", nina_schema[i].name, value);
+		out_add(member, len);
+	}
+
+	out_publish();
+}
+
+static void sample_add(const struct velopera_nina_data *sample)
+{
+	int64_t now = k_uptime_get();
+
+	samples_received++;
+
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		struct window *w = &windows[i];
+		int32_t value = sample->value[i];
+
+		if (!(sample->present & BIT(i)))
+		{
+			continue;
+		}
+
+#if defined(CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND)
+		fields[i].received = true;
+		fields[i].latest = value;
+#endif /* CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND */
+
+		if (window_ms[i] == 0)
+		{
+			continue;
+		}
+
+		if (w->count == 0)
+		{
+			w->end = now + window_ms[i];
+			w->min = value;
+			w->max = value;
+			w->sum = 0;
+		}
+
+		w->count++;
+		w->min = MIN(w->min, value);
+		w->max = MAX(w->max, value);
+		w->last = value;
+		w->sum += value;
+	}
+
+	passthrough(sample, now);
+}
+
+/* Mean of a window in fixed-point, rounded half away from zero */
+static int32_t window_mean(const struct window *w)
+{
+	int64_t half = (w->sum < 0) ? -(int64_t)(w->count / 2) : (int64_t)(w->count / 2);
+
+	return (int32_t)((w->sum + half) / w->count);
+}
+
+/* Publishes a summary of every window that ended by now */
+static void windows_flush(int64_t now)
+{
+	char member[160];
+	char min[16], max[16], mean[16], last[16];
+	int len;
+
+	out_begin(k_cycle_get_64());
+
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		struct window *w = &windows[i];
+
+		if ((w->count == 0) || (w->end > now))
+		{
+			continue;
+		}
+
+		if (!field_send(i, window_mean(w), w->min, w->max, now))
+		{
+			w->count = 0;
+			continue;
+		}
+
+		nina_data_format(i, w->min, min, sizeof(min));
+		nina_data_format(i, w->max, max, sizeof(max));
+		nina_data_format(i, window_mean(w), mean, sizeof(mean));
+		nina_data_format(i, w->last, last, sizeof(last));
+
+		len = snprintf(member, sizeof(member),
+					   "\"%s\":{\"count\":%u,\"min\":%s,\"max\":%s,\"mean\":%s,\"last\":%s,"
+					   "\"window\":%u}",
+					   nina_schema[i].name, w->count, min, max, mean, last, window_ms[i]);
+		out_add(member, len);
+
+		w->count = 0;
+		summaries_published++;
+	}
+
+	out_publish();
+
+	LOG_DBG("samples received: %d, dropped: %d, summaries published: %d, objects dropped: %d",
+			samples_received, samples_dropped, summaries_published, objects_dropped);
+}
+
+/* Time until the earliest open window ends */
+static k_timeout_t next_deadline(void)
+{
+	int64_t end = INT64_MAX;
+
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		if (windows[i].count)
+		{
+			end = MIN(end, windows[i].end);
+		}
+	}
+
+#if defined(CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND)
+	if (KEYFRAME_MS)
+	{
+		end = MIN(end, keyframe_at);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND */
+
+	if (end == INT64_MAX)
+	{
+		return K_FOREVER;
+	}
+
+	return K_MSEC(MAX(end - k_uptime_get(), 0));
+}
+
+static void aggregator_task(void)
+{
+	struct velopera_nina_data sample;
+	int err;
+
+	while (true)
+	{
+		err = k_msgq_get(&sample_queue, &sample, next_deadline());
+
+		/* Close expired windows before the sample opens new ones */
+		windows_flush(k_uptime_get());
+
+#if defined(CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND)
+		if (KEYFRAME_MS && (k_uptime_get() >= keyframe_at))
+		{
+			keyframe_publish(k_uptime_get());
+		}
+#endif /* CONFIG_MQTT_SAMPLE_AGGREGATOR_DEADBAND */
+
+		if (err == 0)
+		{
+			sample_add(&sample);
+		}
+	}
+}
+
+K_THREAD_DEFINE(aggregator_task_id,
+				CONFIG_MQTT_SAMPLE_AGGREGATOR_THREAD_STACK_SIZE,
+				aggregator_task, NULL, NULL, NULL, 3, 0, 0);
@@ -15,6 +15,7 @@
 #include <nrf_modem_gnss.h>
 
 #include "message_channel.h"
+#include "fixed_format.h"
 
 /* Register log module */
 LOG_MODULE_REGISTER(location_app, 4);
@@ -47,8 +48,13 @@ static void print_fix_data(struct velopera_gps_data *pvt_data)
 	// LOG_INF("HDOP:           %.01f\n", pvt_data->hdop);
 	// LOG_INF("VDOP:           %.01f\n", pvt_data->vdop);
 	// LOG_INF("TDOP:           %.01f\n", pvt_data->tdop);
-	LOG_INF("  Google maps URL: https://maps.google.com/?q=%.06f,%.06f\n\n",
-			pvt_data->pvt.latitude, pvt_data->pvt.longitude);
+	char latitude[16];
+	char longitude[16];
+
+	(void)fixed_format(latitude, sizeof(latitude), pvt_data->pvt.latitude, 6);
+	(void)fixed_format(longitude, sizeof(longitude), pvt_data->pvt.longitude, 6);
+
+	LOG_INF("  Google maps URL: https://maps.google.com/?q=%s,%s\n\n", latitude, longitude);
 }
 static void print_satellite_stats(struct nrf_modem_gnss_pvt_data_frame *pvt_data)
 {
@@ -88,6 +94,7 @@ static void gnss_event_handler(int event)
 
 		break;
 	case NRF_MODEM_GNSS_EVT_FIX:
+		velo_gps_data.timestamp = k_cycle_get_64();
 		LOG_INF("GNSS fix event\n\r");
 		retval = nrf_modem_gnss_read(&velo_gps_data.pvt, sizeof(velo_gps_data.pvt), NRF_MODEM_GNSS_DATA_PVT);
 		if (retval == 0)
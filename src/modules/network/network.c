@@ -17,6 +17,7 @@
 #include <nrf_modem_gnss.h>
 
 #include "message_channel.h"
+#include "fixed_format.h"
 
 /* Register log module */
 LOG_MODULE_REGISTER(network, 4);
@@ -105,15 +106,13 @@ static void lte_event_handler(const struct lte_lc_evt *const evt)
 		break;
 	case LTE_LC_EVT_EDRX_UPDATE:
 	{
-		char log_buf[60];
-		long len;
+		char edrx[16];
+		char ptw[16];
 
-		len = snprintf(log_buf, sizeof(log_buf),
-					   "eDRX parameter update: eDRX: %.2f, PTW: %.2f",
-					   evt->edrx_cfg.edrx, evt->edrx_cfg.ptw);
-		if (len > 0)
+		if ((fixed_format(edrx, sizeof(edrx), evt->edrx_cfg.edrx, 2) > 0) &&
+			(fixed_format(ptw, sizeof(ptw), evt->edrx_cfg.ptw, 2) > 0))
 		{
-			LOG_DBG("%s", log_buf);
+			LOG_DBG("eDRX parameter update: eDRX: %s, PTW: %s", edrx, ptw);
 		}
 
 		break;
@@ -0,0 +1,352 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <zephyr/drivers/serial/uart_emul.h>
+#include <zephyr/random/rand32.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "message_channel.h"
+
+/* native_posix board */
+#include "cmdline.h"
+#include "posix_board_if.h"
+#include "soc.h"
+
+/* Register log module */
+LOG_MODULE_REGISTER(replay, CONFIG_MQTT_SAMPLE_REPLAY_LOG_LEVEL);
+
+BUILD_ASSERT(DT_NODE_HAS_COMPAT(DT_NODELABEL(uart0), zephyr_uart_emul),
+			 "The replay harness needs uart0 to be an emulated UART, see replay.overlay");
+
+static const struct device *const dev = DEVICE_DT_GET(DT_NODELABEL(uart0));
+
+/* Replay parameters, Kconfig defaults that can be overridden on the command line */
+static char *replay_file = CONFIG_MQTT_SAMPLE_REPLAY_FILE;
+static uint32_t replay_rate = CONFIG_MQTT_SAMPLE_REPLAY_RATE;
+static uint32_t replay_jitter = CONFIG_MQTT_SAMPLE_REPLAY_JITTER_PERCENT;
+static uint32_t replay_burst_size = CONFIG_MQTT_SAMPLE_REPLAY_BURST_SIZE;
+static uint32_t replay_burst_interval = CONFIG_MQTT_SAMPLE_REPLAY_BURST_INTERVAL;
+static uint32_t replay_baudrate = CONFIG_MQTT_SAMPLE_REPLAY_BAUDRATE;
+static uint32_t replay_loops = CONFIG_MQTT_SAMPLE_REPLAY_LOOPS;
+
+/* Counted by the listener, MQTT_CHAN also carries the summaries of the aggregator */
+static atomic_t mqtt_messages;
+static atomic_t typed_messages;
+static atomic_t queue_peak;
+
+/* Counted by replay_task */
+static uint32_t lines_replayed;
+static uint32_t bytes_replayed;
+static uint32_t bytes_overrun;
+
+/* Time in microseconds at which the emulated line is idle again */
+static int64_t wire_free_us;
+
+static void replay_options(void)
+{
+	static struct args_struct_t replay_args[] = {
+		{.option = "replay-file",
+		 .name = "path",
+		 .type = 's',
+		 .dest = (void *)&replay_file,
+		 .descript = "Nina capture replayed into uart0"},
+		{.option = "replay-rate",
+		 .name = "lines/s",
+		 .type = 'u',
+		 .dest = (void *)&replay_rate,
+		 .descript = "Replay rate in lines per second"},
+		{.option = "replay-jitter",
+		 .name = "percent",
+		 .type = 'u',
+		 .dest = (void *)&replay_jitter,
+		 .descript = "Random jitter of every line in percent of the line period"},
+		{.option = "replay-burst-size",
+		 .name = "lines",
+		 .type = 'u',
+		 .dest = (void *)&replay_burst_size,
+		 .descript = "Lines sent back to back at the start of every burst interval"},
+		{.option = "replay-burst-interval",
+		 .name = "lines",
+		 .type = 'u',
+		 .dest = (void *)&replay_burst_interval,
+		 .descript = "Paced lines between bursts"},
+		{.option = "replay-baudrate",
+		 .name = "baud",
+		 .type = 'u',
+		 .dest = (void *)&replay_baudrate,
+		 .descript = "Emulated baud rate of the Nina link"},
+		{.option = "replay-loops",
+		 .name = "count",
+		 .type = 'u',
+		 .dest = (void *)&replay_loops,
+		 .descript = "Number of passes over the capture"},
+		ARG_TABLE_ENDMARKER};
+
+	native_add_command_line_opts(replay_args);
+}
+
+NATIVE_TASK(replay_options, PRE_BOOT_1, 10);
+
+static void replay_callback(const struct zbus_channel *chan)
+{
+	if (&MQTT_CHAN == chan)
+	{
+		atomic_inc(&mqtt_messages);
+	}
+	else if (&NINA_DATA_CHAN == chan)
+	{
+		atomic_inc(&typed_messages);
+	}
+	else if (&QUEUE_STATUS_CHAN == chan)
+	{
+		const struct velopera_queue_status *status = zbus_chan_const_msg(chan);
+
+		if (status->used > atomic_get(&queue_peak))
+		{
+			atomic_set(&queue_peak, status->used);
+		}
+	}
+}
+
+/* Register listener - replay_callback is called everytime a line, summary or queue status is
+ * published.
+ */
+ZBUS_LISTENER_DEFINE(replay, replay_callback);
+
+static int64_t now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void sleep_until_us(int64_t deadline)
+{
+	int64_t remaining = deadline - now_us();
+
+	if (remaining > 0)
+	{
+		k_sleep(K_USEC(remaining));
+	}
+}
+
+/* Host CPU time of the whole firmware process, all threads run on it */
+static int64_t cpu_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (int64_t)ts.tv_sec * USEC_PER_SEC + ts.tv_nsec / NSEC_PER_USEC;
+}
+
+/* Writes data into the emulated receiver no faster than the baud rate, 8N1. Bytes that do not
+ * fit into the receive FIFO are lost, like on a real UART overrun.
+ */
+static void wire_write(const uint8_t *data, size_t len)
+{
+	int64_t bytes_per_s = replay_baudrate / 10;
+	int64_t start = MAX(now_us(), wire_free_us);
+	size_t sent = 0;
+
+	if (len == 0)
+	{
+		return;
+	}
+
+	sleep_until_us(start);
+
+	while (sent < len)
+	{
+		int64_t due = (now_us() - start) * bytes_per_s / USEC_PER_SEC + 1;
+		size_t count = MIN((size_t)MAX(due - (int64_t)sent, 0), len - sent);
+		uint32_t put;
+
+		if (count == 0)
+		{
+			k_sleep(K_TICKS(1));
+			continue;
+		}
+
+		put = uart_emul_put_rx_data(dev, (uint8_t *)&data[sent], count);
+		bytes_overrun += count - put;
+		sent += count;
+	}
+
+	wire_free_us = start + len * USEC_PER_SEC / bytes_per_s;
+	bytes_replayed += len;
+}
+
+/* Random offset of up to +-replay_jitter percent of the line period */
+static int64_t jitter_us(int64_t period)
+{
+	int64_t range = period * replay_jitter / 100;
+
+	if (range == 0)
+	{
+		return 0;
+	}
+
+	return (int64_t)(sys_rand32_get() % (2 * range + 1)) - range;
+}
+
+/* Replays one pass over the capture. Returns false if the file cannot be read. */
+static bool replay_pass(void)
+{
+	static uint8_t buf[256];
+	int64_t period = USEC_PER_SEC / replay_rate;
+	int64_t next_due = now_us();
+	uint32_t paced = 0;
+	uint32_t burst_left = 0;
+	bool line_start = true;
+	size_t len;
+	FILE *file;
+
+	file = fopen(replay_file, "rb");
+	if (file == NULL)
+	{
+		LOG_ERR("Cannot open capture %s", replay_file);
+		return false;
+	}
+
+	/* Lines are written as soon as the first chunk has been read, a line longer than the
+	 * buffer continues in the next chunk without a pause.
+	 */
+	while ((len = fread(buf, 1, sizeof(buf), file)) > 0)
+	{
+		size_t start = 0;
+
+		for (size_t i = 0; i < len; i++)
+		{
+			if (line_start)
+			{
+				/* Flush the previous line before pacing this one */
+				wire_write(&buf[start], i - start);
+				start = i;
+
+				if (burst_left > 0)
+				{
+					burst_left--;
+				}
+				else
+				{
+					sleep_until_us(next_due + jitter_us(period));
+					next_due += period;
+
+					if ((++paced % replay_burst_interval) == 0)
+					{
+						burst_left = replay_burst_size;
+					}
+				}
+
+				line_start = false;
+			}
+
+			if (buf[i] == '\n')
+			{
+				line_start = true;
+				lines_replayed++;
+			}
+		}
+
+		wire_write(&buf[start], len - start);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+static void replay_report(int64_t elapsed_us, int64_t cpu_us)
+{
+	struct velopera_trigger_stats stats;
+	uint32_t dropped;
+	uint32_t accounted;
+	int err;
+
+	err = zbus_chan_read(&TRIGGER_STATS_CHAN, &stats, K_SECONDS(1));
+	if (err)
+	{
+		LOG_ERR("zbus_chan_read, error: %d", err);
+		return;
+	}
+
+	dropped = stats.rx_dropped + stats.payload_buf_drops + stats.json_rejects;
+	accounted = stats.published + stats.typed + dropped;
+
+	LOG_INF("Replayed %d lines, %d bytes in %d ms, %d lines/s", lines_replayed, bytes_replayed,
+			(int)(elapsed_us / USEC_PER_MSEC),
+			(int)(elapsed_us ? (int64_t)lines_replayed * USEC_PER_SEC / elapsed_us : 0));
+	LOG_INF("Published %d lines on MQTT_CHAN, %d typed lines on NINA_DATA_CHAN alone, "
+			"%d truncated",
+			stats.published, stats.typed, stats.truncated);
+	LOG_INF("%d messages on MQTT_CHAN, %d on NINA_DATA_CHAN, peak transport queue %d B",
+			(int)atomic_get(&mqtt_messages), (int)atomic_get(&typed_messages),
+			(int)atomic_get(&queue_peak));
+	LOG_INF("Dropped %d lines: %d line ring full (%d partly received), %d payload buffers full, "
+			"%d invalid JSON",
+			dropped, stats.rx_dropped, stats.incomplete, stats.payload_buf_drops,
+			stats.json_rejects);
+	/* Lines merged or lost by an overrun, or still on their way */
+	LOG_INF("%d lines not seen by the trigger, %d bytes overrun in the UART FIFO",
+			(accounted < lines_replayed) ? lines_replayed - accounted : 0, bytes_overrun);
+	LOG_INF("CPU time %d ms, %d us per line", (int)(cpu_us / USEC_PER_MSEC),
+			(int)(lines_replayed ? cpu_us / lines_replayed : 0));
+}
+
+static void replay_task(void)
+{
+	int64_t start;
+	int64_t cpu_start;
+
+	if (!device_is_ready(dev))
+	{
+		LOG_ERR("uart0 is not ready");
+		SEND_FATAL_ERROR();
+		return;
+	}
+
+	if ((replay_rate == 0) || (replay_burst_interval == 0) || (replay_baudrate < 10))
+	{
+		LOG_ERR("Invalid replay parameters");
+		SEND_FATAL_ERROR();
+		return;
+	}
+
+	LOG_INF("Replaying %s %d times at %d lines/s, jitter %d%%, bursts of %d every %d lines",
+			replay_file, replay_loops, replay_rate, replay_jitter, replay_burst_size,
+			replay_burst_interval);
+
+	start = now_us();
+	cpu_start = cpu_time_us();
+
+	for (uint32_t i = 0; i < replay_loops; i++)
+	{
+		if (!replay_pass())
+		{
+			SEND_FATAL_ERROR();
+			return;
+		}
+	}
+
+	/* Give the firmware time to publish the last lines */
+	k_sleep(K_MSEC(CONFIG_MQTT_SAMPLE_REPLAY_DRAIN_MS));
+
+	replay_report(now_us() - start, cpu_time_us() - cpu_start);
+
+	if (IS_ENABLED(CONFIG_MQTT_SAMPLE_REPLAY_EXIT))
+	{
+		LOG_PANIC();
+		posix_exit(0);
+	}
+}
+
+K_THREAD_DEFINE(replay_task_id,
+				CONFIG_MQTT_SAMPLE_REPLAY_THREAD_STACK_SIZE,
+				replay_task, NULL, NULL, NULL, 3, 0, 0);
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include "gps_track.h"
+
+static uint64_t zigzag_encode(int64_t value)
+{
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value)
+{
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static size_t varint_put(uint8_t *buf, uint64_t value)
+{
+	size_t len = 0;
+
+	while (value >= 0x80)
+	{
+		buf[len++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	buf[len++] = value;
+
+	return len;
+}
+
+/* Returns false if the varint is truncated or longer than 64 bits */
+static bool varint_get(struct gps_track_decoder *dec, uint64_t *value)
+{
+	*value = 0;
+
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		uint8_t byte;
+
+		if (dec->pos == dec->len)
+		{
+			return false;
+		}
+
+		byte = dec->buf[dec->pos++];
+		*value |= (uint64_t)(byte & 0x7f) << shift;
+
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static int64_t days_from_civil(int32_t year, uint32_t month, uint32_t day)
+{
+	int32_t era;
+	uint32_t yoe;
+	uint32_t doy;
+	uint32_t doe;
+
+	year -= (month <= 2);
+	era = ((year >= 0) ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return (int64_t)era * 146097 + doe - 719468;
+}
+
+/* Rounds half away from zero */
+static int32_t scale(double value, int32_t factor)
+{
+	value *= factor;
+
+	return (int32_t)((value < 0) ? value - 0.5 : value + 0.5);
+}
+
+void gps_track_fix_from_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt,
+							struct gps_track_fix *fix)
+{
+	const struct nrf_modem_gnss_datetime *dt = &pvt->datetime;
+	int64_t seconds = days_from_civil(dt->year, dt->month, dt->day) * 86400 +
+					  dt->hour * 3600 + dt->minute * 60 + dt->seconds;
+
+	fix->time = seconds * MSEC_PER_SEC + dt->ms;
+	fix->latitude = scale(pvt->latitude, 10000000);
+	fix->longitude = scale(pvt->longitude, 10000000);
+	fix->altitude = scale(pvt->altitude, 10);
+	fix->speed = scale(pvt->speed, 10);
+}
+
+void gps_track_encoder_init(struct gps_track_encoder *enc, uint8_t *buf, size_t size)
+{
+	__ASSERT_NO_MSG(size >= 1 + GPS_TRACK_RECORD_MAX_SIZE);
+
+	enc->buf = buf;
+	enc->size = size;
+	enc->count = 0;
+	memset(&enc->prev, 0, sizeof(enc->prev));
+
+	enc->buf[0] = GPS_TRACK_VERSION;
+	enc->len = 1;
+}
+
+int gps_track_encoder_add(struct gps_track_encoder *enc, const struct gps_track_fix *fix)
+{
+	uint8_t record[GPS_TRACK_RECORD_MAX_SIZE];
+	size_t len = 0;
+
+	/* Differences of 32 bit fields are computed in 64 bits and cannot overflow */
+	len += varint_put(&record[len], zigzag_encode(fix->time - enc->prev.time));
+	len += varint_put(&record[len],
+					  zigzag_encode((int64_t)fix->latitude - enc->prev.latitude));
+	len += varint_put(&record[len],
+					  zigzag_encode((int64_t)fix->longitude - enc->prev.longitude));
+	len += varint_put(&record[len],
+					  zigzag_encode((int64_t)fix->altitude - enc->prev.altitude));
+	len += varint_put(&record[len], zigzag_encode((int64_t)fix->speed - enc->prev.speed));
+
+	if (len > enc->size - enc->len)
+	{
+		return -ENOMEM;
+	}
+
+	memcpy(&enc->buf[enc->len], record, len);
+	enc->len += len;
+	enc->count++;
+	enc->prev = *fix;
+
+	return 0;
+}
+
+int gps_track_decoder_init(struct gps_track_decoder *dec, const uint8_t *buf, size_t len)
+{
+	if ((len == 0) || (buf[0] != GPS_TRACK_VERSION))
+	{
+		return -EBADMSG;
+	}
+
+	dec->buf = buf;
+	dec->len = len;
+	dec->pos = 1;
+	memset(&dec->prev, 0, sizeof(dec->prev));
+
+	return 0;
+}
+
+int gps_track_decoder_next(struct gps_track_decoder *dec, struct gps_track_fix *fix)
+{
+	uint64_t delta[5];
+
+	if (dec->pos == dec->len)
+	{
+		return -ENODATA;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(delta); i++)
+	{
+		if (!varint_get(dec, &delta[i]))
+		{
+			return -EBADMSG;
+		}
+	}
+
+	fix->time = dec->prev.time + zigzag_decode(delta[0]);
+	fix->latitude = dec->prev.latitude + zigzag_decode(delta[1]);
+	fix->longitude = dec->prev.longitude + zigzag_decode(delta[2]);
+	fix->altitude = dec->prev.altitude + zigzag_decode(delta[3]);
+	fix->speed = dec->prev.speed + zigzag_decode(delta[4]);
+
+	dec->prev = *fix;
+
+	return 0;
+}
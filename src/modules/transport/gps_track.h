@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Compact binary encoding of a track of GPS fixes.
+ *
+ * A track starts with the format version byte GPS_TRACK_VERSION, followed by one record per fix.
+ * A record holds the fields of struct gps_track_fix in declaration order, each as the difference
+ * to the same field of the previous fix, zig-zag mapped to an unsigned integer and written as
+ * LEB128 varint (7 bits per byte, least significant group first, high bit set on all but the
+ * last byte). The first fix is the difference to an all-zero fix, so it is absolute.
+ *
+ * During continuous tracking consecutive fixes differ only slightly, so most fields fit into one
+ * or two bytes.
+ */
+
+#ifndef GPS_TRACK_H__
+#define GPS_TRACK_H__
+
+#include <zephyr/kernel.h>
+#include <nrf_modem_gnss.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Format version, first byte of every track */
+#define GPS_TRACK_VERSION 1
+
+/** Maximum size of one record, 10 bytes for the time and 5 for each 32 bit field */
+#define GPS_TRACK_RECORD_MAX_SIZE (10 + 4 * 5)
+
+	/** Fields of one fix, in encoding order */
+	struct gps_track_fix
+	{
+		/** UTC time, ms since 1970-01-01 */
+		int64_t time;
+		/** Latitude, degrees * 10^7 */
+		int32_t latitude;
+		/** Longitude, degrees * 10^7 */
+		int32_t longitude;
+		/** Altitude, m * 10 */
+		int32_t altitude;
+		/** Speed, m/s * 10 */
+		int32_t speed;
+	};
+
+	struct gps_track_encoder
+	{
+		uint8_t *buf;
+		size_t size;
+		/** Length of the track written so far */
+		size_t len;
+		/** Number of fixes in the track */
+		uint32_t count;
+		struct gps_track_fix prev;
+	};
+
+	struct gps_track_decoder
+	{
+		const uint8_t *buf;
+		size_t len;
+		size_t pos;
+		struct gps_track_fix prev;
+	};
+
+	/**
+	 * @brief Converts a PVT frame of the GNSS interface into track fields.
+	 *
+	 * @param pvt PVT frame
+	 * @param fix track fields
+	 */
+	void gps_track_fix_from_pvt(const struct nrf_modem_gnss_pvt_data_frame *pvt,
+								struct gps_track_fix *fix);
+
+	/**
+	 * @brief Starts a new track in a buffer.
+	 *
+	 * @param enc encoder
+	 * @param buf output buffer, at least 1 + GPS_TRACK_RECORD_MAX_SIZE bytes
+	 * @param size size of the output buffer
+	 */
+	void gps_track_encoder_init(struct gps_track_encoder *enc, uint8_t *buf, size_t size);
+
+	/**
+	 * @brief Appends a fix to the track.
+	 *
+	 * @param enc encoder
+	 * @param fix fix to append
+	 *
+	 * @retval 0 on success.
+	 * @retval -ENOMEM if the record does not fit, the track is left unchanged.
+	 */
+	int gps_track_encoder_add(struct gps_track_encoder *enc, const struct gps_track_fix *fix);
+
+	/**
+	 * @brief Reference decoder, starts reading a track.
+	 *
+	 * @param dec decoder
+	 * @param buf track
+	 * @param len length of the track
+	 *
+	 * @retval 0 on success.
+	 * @retval -EBADMSG if the track is empty or has an unknown version.
+	 */
+	int gps_track_decoder_init(struct gps_track_decoder *dec, const uint8_t *buf, size_t len);
+
+	/**
+	 * @brief Reference decoder, reads the next fix of the track.
+	 *
+	 * @param dec decoder
+	 * @param fix decoded fix
+	 *
+	 * @retval 0 on success.
+	 * @retval -ENODATA at the end of the track.
+	 * @retval -EBADMSG if the track is truncated or malformed.
+	 */
+	int gps_track_decoder_next(struct gps_track_decoder *dec, struct gps_track_fix *fix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPS_TRACK_H__ */
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "inflight.h"
+
+LOG_MODULE_REGISTER(inflight, CONFIG_MQTT_SAMPLE_TRANSPORT_LOG_LEVEL);
+
+#define INFLIGHT_WINDOW CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_WINDOW
+#define INFLIGHT_TIMEOUT_MS (CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_TIMEOUT_S * MSEC_PER_SEC)
+
+/* Slot states, a slot is only freed by the thread that fills it */
+enum slot_state
+{
+	SLOT_FREE,
+	SLOT_USED,
+	SLOT_ACKED,
+};
+
+struct inflight_slot
+{
+	atomic_t state;
+	uint16_t message_id;
+	/* Topic, NUL terminated, followed by the payload */
+	uint8_t *buf;
+	size_t topic_len;
+	size_t len;
+	/* Sent at least once, sent again with the DUP flag */
+	bool sent;
+	/* Time in ms of uptime the message was published and last sent */
+	int64_t published;
+	int64_t last_sent;
+	/* Written by inflight_puback() before the state changes */
+	int64_t acked;
+};
+
+K_HEAP_DEFINE(inflight_heap, CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_HEAP_SIZE);
+
+static struct inflight_slot slots[INFLIGHT_WINDOW];
+static inflight_send_t inflight_send;
+static atomic_t next_message_id;
+static atomic_t restart;
+/* Set when inflight_publish() fails for lack of room */
+static atomic_t waiting;
+
+/* Statistics */
+static uint32_t inflight_acks;
+static uint32_t inflight_retransmits;
+static uint64_t inflight_ack_ms;
+
+/* Releases the slots of acknowledged messages */
+static void slots_release(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+	{
+		struct inflight_slot *slot = &slots[i];
+
+		if (atomic_get(&slot->state) != SLOT_ACKED)
+		{
+			continue;
+		}
+
+		inflight_acks++;
+		inflight_ack_ms += slot->acked - slot->published;
+
+		LOG_DBG("Message %d acknowledged after %d ms, on average %d ms, %d retransmits",
+				slot->message_id, (int)(slot->acked - slot->published),
+				(int)(inflight_ack_ms / inflight_acks), inflight_retransmits);
+
+		k_heap_free(&inflight_heap, slot->buf);
+		slot->buf = NULL;
+		atomic_set(&slot->state, SLOT_FREE);
+	}
+}
+
+static void slot_send(struct inflight_slot *slot)
+{
+	int err;
+
+	err = inflight_send(slot->buf, &slot->buf[slot->topic_len], slot->len, slot->message_id,
+						slot->sent);
+	if (err)
+	{
+		/* Sent again once the timeout expires */
+		slot->last_sent = k_uptime_get();
+		return;
+	}
+
+	if (slot->sent)
+	{
+		inflight_retransmits++;
+	}
+
+	slot->sent = true;
+	slot->last_sent = k_uptime_get();
+}
+
+void inflight_init(inflight_send_t send)
+{
+	inflight_send = send;
+}
+
+uint16_t inflight_message_id(void)
+{
+	while (true)
+	{
+		uint16_t message_id = atomic_inc(&next_message_id) + 1;
+		bool used = false;
+
+		if (message_id == 0)
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+		{
+			if ((atomic_get(&slots[i].state) != SLOT_FREE) &&
+				(slots[i].message_id == message_id))
+			{
+				used = true;
+				break;
+			}
+		}
+
+		if (!used)
+		{
+			return message_id;
+		}
+	}
+}
+
+bool inflight_full(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+	{
+		if (atomic_get(&slots[i].state) != SLOT_USED)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int inflight_publish(const uint8_t *topic, const void *data, size_t len)
+{
+	struct inflight_slot *slot = NULL;
+	size_t topic_len = strlen((const char *)topic) + 1;
+
+	slots_release();
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+	{
+		if (atomic_get(&slots[i].state) == SLOT_FREE)
+		{
+			slot = &slots[i];
+			break;
+		}
+	}
+
+	if (slot == NULL)
+	{
+		atomic_set(&waiting, 1);
+		return -EBUSY;
+	}
+
+	slot->buf = k_heap_alloc(&inflight_heap, topic_len + len, K_NO_WAIT);
+	if (slot->buf == NULL)
+	{
+		atomic_set(&waiting, 1);
+		return -ENOMEM;
+	}
+
+	memcpy(slot->buf, topic, topic_len);
+	memcpy(&slot->buf[topic_len], data, len);
+	slot->topic_len = topic_len;
+	slot->len = len;
+	slot->sent = false;
+	slot->published = k_uptime_get();
+	slot->message_id = inflight_message_id();
+	atomic_set(&slot->state, SLOT_USED);
+
+	slot_send(slot);
+
+	return 0;
+}
+
+int64_t inflight_process(bool connected)
+{
+	bool resend = connected && atomic_clear(&restart);
+	int64_t remaining = -1;
+
+	slots_release();
+
+	if (!connected)
+	{
+		return -1;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+	{
+		struct inflight_slot *slot = &slots[i];
+		int64_t due;
+
+		if (atomic_get(&slot->state) != SLOT_USED)
+		{
+			continue;
+		}
+
+		due = slot->last_sent + INFLIGHT_TIMEOUT_MS - k_uptime_get();
+		if (resend || (due <= 0))
+		{
+			slot_send(slot);
+			due = INFLIGHT_TIMEOUT_MS;
+		}
+
+		remaining = (remaining < 0) ? due : MIN(remaining, due);
+	}
+
+	return remaining;
+}
+
+bool inflight_puback(uint16_t message_id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+	{
+		struct inflight_slot *slot = &slots[i];
+
+		if ((atomic_get(&slot->state) != SLOT_USED) || (slot->message_id != message_id))
+		{
+			continue;
+		}
+
+		slot->acked = k_uptime_get();
+		atomic_set(&slot->state, SLOT_ACKED);
+
+		return atomic_clear(&waiting);
+	}
+
+	return false;
+}
+
+void inflight_restart(void)
+{
+	atomic_set(&restart, 1);
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Window of QoS 1 messages in flight.
+ *
+ * Up to a window of messages are sent without waiting for the PUBACK of the previous ones. Each
+ * message is copied into the in-flight heap together with its topic and kept until its PUBACK
+ * has been received. Messages without a PUBACK within the timeout, and all of them after a
+ * reconnect, are sent again with the same message ID and the DUP flag set.
+ *
+ * Message IDs are assigned sequentially, skipping 0 and the IDs of messages still in flight.
+ */
+
+#ifndef INFLIGHT_H__
+#define INFLIGHT_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/**
+	 * @brief Sends one message as MQTT PUBLISH with QoS 1.
+	 *
+	 * @param topic NUL terminated topic
+	 * @param data payload
+	 * @param len length of the payload
+	 * @param message_id message ID of the PUBLISH
+	 * @param dup true if the message has been sent before with the same message ID
+	 *
+	 * @return 0 on success, a negative error code if the message has to be sent again later.
+	 */
+	typedef int (*inflight_send_t)(const uint8_t *topic, const uint8_t *data, size_t len,
+								   uint16_t message_id, bool dup);
+
+	/**
+	 * @brief Sets the function that sends messages.
+	 *
+	 * @param send sends messages
+	 */
+	void inflight_init(inflight_send_t send);
+
+	/**
+	 * @brief Copies a message into the window and sends it.
+	 *
+	 * A message that cannot be sent right away stays in the window and is sent by
+	 * inflight_process().
+	 *
+	 * @param topic NUL terminated topic
+	 * @param data payload
+	 * @param len length of the payload
+	 *
+	 * @retval 0 if the message is in the window.
+	 * @retval -EBUSY if the window is full, inflight_puback() reports when it is not anymore.
+	 * @retval -ENOMEM if the in-flight heap is full, like -EBUSY.
+	 */
+	int inflight_publish(const uint8_t *topic, const void *data, size_t len);
+
+	/**
+	 * @brief Returns true if the window is full.
+	 */
+	bool inflight_full(void);
+
+	/**
+	 * @brief Sends messages that are due again and releases acknowledged ones.
+	 *
+	 * Has to be called from the same thread as inflight_publish().
+	 *
+	 * @param connected true while messages can be sent
+	 *
+	 * @return Time in ms until the next message times out, or -1 if none is in flight.
+	 */
+	int64_t inflight_process(bool connected);
+
+	/**
+	 * @brief Marks a message as acknowledged, can be called from any thread.
+	 *
+	 * @param message_id message ID of the PUBACK
+	 *
+	 * @return true if the message was in the window and inflight_publish() has failed since
+	 *         the previous call, publishing can continue.
+	 */
+	bool inflight_puback(uint16_t message_id);
+
+	/**
+	 * @brief Sends all messages in the window again, to be called after reconnecting.
+	 *
+	 * Can be called from any thread.
+	 */
+	void inflight_restart(void);
+
+	/**
+	 * @brief Returns the next message ID, can be called from any thread.
+	 *
+	 * Messages sent outside the window, like the stored ones, take their IDs from the same
+	 * sequence.
+	 */
+	uint16_t inflight_message_id(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INFLIGHT_H__ */
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include "lzss.h"
+
+BUILD_ASSERT(LZSS_WINDOW_BITS + LZSS_LENGTH_BITS + 1 > 7, "Padding has to be shorter than a token");
+BUILD_ASSERT(LZSS_WINDOW_BITS < 16 && LZSS_LENGTH_BITS < 16, "Bits are stored in one nibble");
+
+/* Appends count bits of value to the output, at most 24 at a time */
+static void bits_put(struct lzss_encoder *enc, uint32_t value, uint8_t count)
+{
+	enc->bits = (enc->bits << count) | value;
+	enc->bit_count += count;
+
+	while (enc->bit_count >= 8)
+	{
+		enc->bit_count -= 8;
+
+		if (enc->out_len == enc->out_size)
+		{
+			enc->overflow = true;
+			continue;
+		}
+
+		enc->out[enc->out_len++] = enc->bits >> enc->bit_count;
+	}
+}
+
+/* Encodes the longest match at pos, or a literal if there is none */
+static void token_put(struct lzss_encoder *enc)
+{
+	const uint8_t *next = &enc->buf[enc->pos];
+	size_t avail = MIN(enc->fill - enc->pos, LZSS_MAX_MATCH);
+	size_t start = (enc->pos > LZSS_WINDOW_SIZE) ? enc->pos - LZSS_WINDOW_SIZE : 0;
+	size_t best_len = 0;
+	size_t best_distance = 0;
+
+	/* Nearest candidates first, stop at the first match of full length */
+	for (size_t i = enc->pos; (i-- > start) && (best_len < avail);)
+	{
+		const uint8_t *candidate = &enc->buf[i];
+		size_t len = 0;
+
+		if (candidate[0] != next[0])
+		{
+			continue;
+		}
+
+		while ((len < avail) && (candidate[len] == next[len]))
+		{
+			len++;
+		}
+
+		if (len > best_len)
+		{
+			best_len = len;
+			best_distance = enc->pos - i;
+		}
+	}
+
+	if (best_len >= LZSS_MIN_MATCH)
+	{
+		bits_put(enc, 0, 1);
+		bits_put(enc, best_distance - 1, LZSS_WINDOW_BITS);
+		bits_put(enc, best_len - LZSS_MIN_MATCH, LZSS_LENGTH_BITS);
+		enc->pos += best_len;
+	}
+	else
+	{
+		bits_put(enc, BIT(8) | next[0], 9);
+		enc->pos++;
+	}
+}
+
+/* Moves the window of encoded bytes before pos to the start of the buffer */
+static void window_slide(struct lzss_encoder *enc)
+{
+	size_t shift;
+
+	if (enc->pos <= LZSS_WINDOW_SIZE)
+	{
+		return;
+	}
+
+	shift = enc->pos - LZSS_WINDOW_SIZE;
+	memmove(enc->buf, &enc->buf[shift], enc->fill - shift);
+	enc->pos -= shift;
+	enc->fill -= shift;
+}
+
+void lzss_encoder_init(struct lzss_encoder *enc, uint8_t *out, size_t size)
+{
+	__ASSERT_NO_MSG(size >= LZSS_HEADER_SIZE);
+
+	enc->pos = 0;
+	enc->fill = 0;
+	enc->out = out;
+	enc->out_size = size;
+	enc->out_len = 0;
+	enc->bits = 0;
+	enc->bit_count = 0;
+	enc->overflow = false;
+
+	out[enc->out_len++] = LZSS_MAGIC;
+	out[enc->out_len++] = (LZSS_WINDOW_BITS << 4) | LZSS_LENGTH_BITS;
+}
+
+int lzss_encoder_write(struct lzss_encoder *enc, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len > 0)
+	{
+		size_t count = MIN(len, sizeof(enc->buf) - enc->fill);
+
+		memcpy(&enc->buf[enc->fill], p, count);
+		enc->fill += count;
+		p += count;
+		len -= count;
+
+		/* Encode while a match of maximum length can be found */
+		while (enc->fill - enc->pos >= LZSS_MAX_MATCH)
+		{
+			token_put(enc);
+		}
+
+		if (enc->fill == sizeof(enc->buf))
+		{
+			window_slide(enc);
+		}
+	}
+
+	return enc->overflow ? -ENOMEM : 0;
+}
+
+int lzss_encoder_finish(struct lzss_encoder *enc)
+{
+	while (enc->pos < enc->fill)
+	{
+		token_put(enc);
+	}
+
+	if (enc->bit_count > 0)
+	{
+		bits_put(enc, 0, 8 - enc->bit_count);
+	}
+
+	return enc->overflow ? -ENOMEM : enc->out_len;
+}
+
+size_t lzss_encoder_bound(const struct lzss_encoder *enc, size_t len)
+{
+	size_t bits = enc->bit_count + (enc->fill - enc->pos + len) * 9;
+
+	return enc->out_len + DIV_ROUND_UP(bits, 8);
+}
+
+/* Reads count bits from in, returns false if there are not enough left */
+static bool bits_get(const uint8_t *in, size_t len, size_t *bit_pos, uint8_t count,
+					 uint32_t *value)
+{
+	if (*bit_pos + count > len * 8)
+	{
+		return false;
+	}
+
+	*value = 0;
+
+	for (uint8_t i = 0; i < count; i++, (*bit_pos)++)
+	{
+		*value = (*value << 1) | ((in[*bit_pos / 8] >> (7 - *bit_pos % 8)) & 1);
+	}
+
+	return true;
+}
+
+int lzss_decode(const uint8_t *in, size_t len, uint8_t *out, size_t size)
+{
+	uint8_t window_bits;
+	uint8_t length_bits;
+	uint8_t min_match;
+	size_t bit_pos = LZSS_HEADER_SIZE * 8;
+	size_t out_len = 0;
+
+	if ((len < LZSS_HEADER_SIZE) || (in[0] != LZSS_MAGIC))
+	{
+		return -EBADMSG;
+	}
+
+	window_bits = in[1] >> 4;
+	length_bits = in[1] & 0x0f;
+	min_match = lzss_min_match(window_bits, length_bits);
+
+	if (window_bits + length_bits + 1 <= 7)
+	{
+		return -EBADMSG;
+	}
+
+	while (true)
+	{
+		uint32_t flag;
+		uint32_t distance;
+		uint32_t count;
+
+		/* The remaining bits are padding if they do not hold a token */
+		if (!bits_get(in, len, &bit_pos, 1, &flag))
+		{
+			break;
+		}
+
+		if (flag)
+		{
+			if (!bits_get(in, len, &bit_pos, 8, &count))
+			{
+				break;
+			}
+
+			if (out_len == size)
+			{
+				return -ENOMEM;
+			}
+
+			out[out_len++] = count;
+			continue;
+		}
+
+		if (!bits_get(in, len, &bit_pos, window_bits, &distance) ||
+			!bits_get(in, len, &bit_pos, length_bits, &count))
+		{
+			break;
+		}
+
+		distance += 1;
+		count += min_match;
+
+		if (distance > out_len)
+		{
+			return -EBADMSG;
+		}
+
+		if (count > size - out_len)
+		{
+			return -ENOMEM;
+		}
+
+		for (; count > 0; count--, out_len++)
+		{
+			out[out_len] = out[out_len - distance];
+		}
+	}
+
+	return out_len;
+}
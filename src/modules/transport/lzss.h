@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Streaming LZSS compression of uplink payloads, in the class of heatshrink.
+ *
+ * Compressed data starts with the two byte header LZSS_MAGIC, (window bits << 4) | length bits,
+ * followed by a bit stream, most significant bit first. Every token starts with a flag bit:
+ * - 1: literal, followed by the 8 bit byte.
+ * - 0: back-reference, followed by the distance - 1 in window bits and the length - minimum
+ *   length in length bits. The bytes are copied one by one starting at the given distance back
+ *   in the output, so a reference may overlap the bytes it produces.
+ *
+ * The minimum length is the shortest match for which a back-reference is smaller than the
+ * literals, see lzss_min_match(). The stream is padded with zero bits to a whole byte, padding
+ * is always shorter than a token.
+ *
+ * LZSS_MAGIC is neither valid JSON nor a valid first byte of CBOR, so compressed and plain
+ * payloads can share a topic.
+ */
+
+#ifndef LZSS_H__
+#define LZSS_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** First byte of compressed data */
+#define LZSS_MAGIC 0x1f
+
+/** Size of the header */
+#define LZSS_HEADER_SIZE 2
+
+/** Window and length bits of the encoder */
+#define LZSS_WINDOW_BITS CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS_WINDOW_BITS
+#define LZSS_LENGTH_BITS CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS_LENGTH_BITS
+
+#define LZSS_WINDOW_SIZE BIT(LZSS_WINDOW_BITS)
+#define LZSS_MIN_MATCH lzss_min_match(LZSS_WINDOW_BITS, LZSS_LENGTH_BITS)
+#define LZSS_MAX_MATCH (BIT(LZSS_LENGTH_BITS) + LZSS_MIN_MATCH - 1)
+
+/** Shortest match worth a back-reference */
+#define lzss_min_match(window_bits, length_bits) ((1 + (window_bits) + (length_bits)) / 9 + 1)
+
+	struct lzss_encoder
+	{
+		/**
+		 * Up to a window of bytes already encoded, followed by the bytes still to encode.
+		 * The window is moved to the start once the buffer is full.
+		 */
+		uint8_t buf[2 * LZSS_WINDOW_SIZE + LZSS_MAX_MATCH];
+		/** Index of the next byte to encode */
+		size_t pos;
+		/** Number of bytes in buf */
+		size_t fill;
+
+		uint8_t *out;
+		size_t out_size;
+		/** Length of the output written so far, whole bytes */
+		size_t out_len;
+		/** Bits not yet written to the output */
+		uint32_t bits;
+		uint8_t bit_count;
+		/** Set once the output buffer was too small */
+		bool overflow;
+	};
+
+	/**
+	 * @brief Starts compressed data in the output buffer.
+	 *
+	 * @param enc encoder
+	 * @param out output buffer, has to hold at least the header
+	 * @param size size of the output buffer
+	 */
+	void lzss_encoder_init(struct lzss_encoder *enc, uint8_t *out, size_t size);
+
+	/**
+	 * @brief Compresses data into the output buffer.
+	 *
+	 * The last bytes, less than a match of maximum length, are kept until more data follows or
+	 * lzss_encoder_finish() is called.
+	 *
+	 * @param enc encoder
+	 * @param data data
+	 * @param len length of the data
+	 *
+	 * @retval 0 on success.
+	 * @retval -ENOMEM if the output buffer is full, the compressed data is incomplete.
+	 */
+	int lzss_encoder_write(struct lzss_encoder *enc, const void *data, size_t len);
+
+	/**
+	 * @brief Compresses the remaining data and pads the output to a whole byte.
+	 *
+	 * @param enc encoder
+	 *
+	 * @return Length of the compressed data, including the header.
+	 * @retval -ENOMEM if the output buffer is full, the compressed data is incomplete.
+	 */
+	int lzss_encoder_finish(struct lzss_encoder *enc);
+
+	/**
+	 * @brief Returns the largest output length after writing more data and finishing.
+	 *
+	 * Data that does not compress takes 9 bits per byte.
+	 *
+	 * @param enc encoder
+	 * @param len length of the data still to be written
+	 */
+	size_t lzss_encoder_bound(const struct lzss_encoder *enc, size_t len);
+
+	/**
+	 * @brief Reference decoder, decompresses data produced with any window and length bits.
+	 *
+	 * @param in compressed data, including the header
+	 * @param len length of the compressed data
+	 * @param out output buffer
+	 * @param size size of the output buffer
+	 *
+	 * @return Length of the decompressed data.
+	 * @retval -EBADMSG if the header is invalid or a back-reference points before the start.
+	 * @retval -ENOMEM if the output buffer is too small.
+	 */
+	int lzss_decode(const uint8_t *in, size_t len, uint8_t *out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LZSS_H__ */
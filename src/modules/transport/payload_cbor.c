@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "payload_cbor.h"
+
+/* CBOR major types, RFC 8949 */
+#define CBOR_UINT 0x00
+#define CBOR_NINT 0x20
+#define CBOR_TSTR 0x60
+#define CBOR_MAP 0xa0
+
+/* Additional information values announcing the size of the argument */
+#define CBOR_ARG_1 24
+#define CBOR_ARG_2 25
+#define CBOR_ARG_4 26
+#define CBOR_ARG_8 27
+
+struct cbor_writer
+{
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	bool overflow;
+};
+
+static void put_bytes(struct cbor_writer *w, const void *data, size_t len)
+{
+	if (len == 0)
+	{
+		return;
+	}
+
+	if (w->overflow || (len > w->size - w->len))
+	{
+		w->overflow = true;
+		return;
+	}
+
+	memcpy(&w->buf[w->len], data, len);
+	w->len += len;
+}
+
+/* Writes the initial byte of a data item with its argument in the shortest form */
+static void put_head(struct cbor_writer *w, uint8_t major, uint64_t arg)
+{
+	uint8_t head[9];
+	size_t len;
+
+	if (arg < CBOR_ARG_1)
+	{
+		head[0] = major | arg;
+		len = 1;
+	}
+	else if (arg <= UINT8_MAX)
+	{
+		head[0] = major | CBOR_ARG_1;
+		len = 2;
+	}
+	else if (arg <= UINT16_MAX)
+	{
+		head[0] = major | CBOR_ARG_2;
+		len = 3;
+	}
+	else if (arg <= UINT32_MAX)
+	{
+		head[0] = major | CBOR_ARG_4;
+		len = 5;
+	}
+	else
+	{
+		head[0] = major | CBOR_ARG_8;
+		len = 9;
+	}
+
+	/* Big endian argument */
+	for (size_t i = len - 1; i > 0; i--)
+	{
+		head[i] = arg & 0xff;
+		arg >>= 8;
+	}
+
+	put_bytes(w, head, len);
+}
+
+static void put_int(struct cbor_writer *w, int64_t value)
+{
+	if (value < 0)
+	{
+		/* -1 - n, without overflowing for INT64_MIN */
+		put_head(w, CBOR_NINT, (uint64_t)(-1 - value));
+	}
+	else
+	{
+		put_head(w, CBOR_UINT, value);
+	}
+}
+
+static void put_tstr(struct cbor_writer *w, const char *str)
+{
+	size_t len = (str != NULL) ? strlen(str) : 0;
+
+	put_head(w, CBOR_TSTR, len);
+	put_bytes(w, str, len);
+}
+
+static void put_key_int(struct cbor_writer *w, uint32_t key, int64_t value)
+{
+	put_head(w, CBOR_UINT, key);
+	put_int(w, value);
+}
+
+static void put_key_tstr(struct cbor_writer *w, uint32_t key, const char *str)
+{
+	put_head(w, CBOR_UINT, key);
+	put_tstr(w, str);
+}
+
+static int writer_finish(const struct cbor_writer *w)
+{
+	return w->overflow ? -ENOMEM : (int)w->len;
+}
+
+/* Converts a reading to a fixed-point value, rounding half away from zero */
+static int64_t fixed(double value, int32_t scale)
+{
+	value *= scale;
+
+	return (int64_t)((value < 0) ? value - 0.5 : value + 0.5);
+}
+
+int cbor_gps_encode(const struct velopera_gps_data *gps, uint8_t *buf, size_t size)
+{
+	const struct nrf_modem_gnss_pvt_data_frame *pvt = &gps->pvt;
+	const struct nrf_modem_gnss_datetime *dt = &pvt->datetime;
+	struct cbor_writer w = {.buf = buf, .size = size};
+
+	put_head(&w, CBOR_MAP, CBOR_GPS_KEY_COUNT);
+	put_key_int(&w, CBOR_GPS_LATITUDE, fixed(pvt->latitude, 1000000));
+	put_key_int(&w, CBOR_GPS_LONGITUDE, fixed(pvt->longitude, 1000000));
+	put_key_int(&w, CBOR_GPS_ALTITUDE, fixed(pvt->altitude, 10));
+	put_key_int(&w, CBOR_GPS_ACCURACY, fixed(pvt->accuracy, 10));
+	put_key_int(&w, CBOR_GPS_SPEED, fixed(pvt->speed, 10));
+	put_key_int(&w, CBOR_GPS_SPEED_ACCURACY, fixed(pvt->speed_accuracy, 10));
+	put_key_int(&w, CBOR_GPS_HEADING, fixed(pvt->heading, 10));
+	put_key_int(&w, CBOR_GPS_DATE, dt->year * 10000 + dt->month * 100 + dt->day);
+	put_key_int(&w, CBOR_GPS_TIME,
+				((dt->hour * 100 + dt->minute) * 100 + dt->seconds) * 1000 + dt->ms);
+	put_key_int(&w, CBOR_GPS_PDOP, fixed(pvt->pdop, 10));
+	put_key_int(&w, CBOR_GPS_HDOP, fixed(pvt->hdop, 10));
+	put_key_int(&w, CBOR_GPS_VDOP, fixed(pvt->vdop, 10));
+	put_key_int(&w, CBOR_GPS_TDOP, fixed(pvt->tdop, 10));
+	put_key_int(&w, CBOR_GPS_MEAS_ID, gps->meas_id);
+	put_key_int(&w, CBOR_GPS_UPTIME, k_cyc_to_us_floor64(gps->timestamp));
+
+	return writer_finish(&w);
+}
+
+int cbor_login_encode(const struct cbor_login_info *login, uint8_t *buf, size_t size)
+{
+	struct cbor_writer w = {.buf = buf, .size = size};
+
+	put_head(&w, CBOR_MAP, CBOR_LOGIN_KEY_COUNT);
+	put_key_tstr(&w, CBOR_LOGIN_NETWORK_STATUS, login->network_status);
+	put_key_int(&w, CBOR_LOGIN_RSRP, login->rsrp);
+	put_key_tstr(&w, CBOR_LOGIN_ICCID, login->iccid);
+	put_key_int(&w, CBOR_LOGIN_MCC, login->mcc);
+	put_key_tstr(&w, CBOR_LOGIN_MNC, login->mnc);
+	put_key_tstr(&w, CBOR_LOGIN_CELL_ID, login->cell_id);
+	put_key_int(&w, CBOR_LOGIN_BAND, login->band);
+	put_key_tstr(&w, CBOR_LOGIN_AREA_CODE, login->area_code);
+	put_key_tstr(&w, CBOR_LOGIN_OPERATOR, login->op);
+	put_key_tstr(&w, CBOR_LOGIN_MODEM, login->modem);
+	put_key_tstr(&w, CBOR_LOGIN_FIRMWARE, login->firmware);
+
+	return writer_finish(&w);
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Compact CBOR encoding of the GPS and login messages.
+ *
+ * Both messages are encoded as one CBOR map with small integer keys instead of the JSON member
+ * names. Measurements are sent as fixed-point integers, value = reading * scale, with the scale
+ * given next to each key. The key maps must match the decoder of the backend.
+ */
+
+#ifndef PAYLOAD_CBOR_H__
+#define PAYLOAD_CBOR_H__
+
+#include <zephyr/kernel.h>
+
+#include "message_channel.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** Keys of the GPS map */
+	enum cbor_gps_key
+	{
+		/** Latitude, degrees * 10^6 */
+		CBOR_GPS_LATITUDE,
+		/** Longitude, degrees * 10^6 */
+		CBOR_GPS_LONGITUDE,
+		/** Altitude, m * 10 */
+		CBOR_GPS_ALTITUDE,
+		/** Accuracy, m * 10 */
+		CBOR_GPS_ACCURACY,
+		/** Speed, m/s * 10 */
+		CBOR_GPS_SPEED,
+		/** Speed accuracy, m/s * 10 */
+		CBOR_GPS_SPEED_ACCURACY,
+		/** Heading, degrees * 10 */
+		CBOR_GPS_HEADING,
+		/** UTC date, YYYYMMDD */
+		CBOR_GPS_DATE,
+		/** UTC time, HHMMSSmmm */
+		CBOR_GPS_TIME,
+		/** Dilutions of precision, * 10 */
+		CBOR_GPS_PDOP,
+		CBOR_GPS_HDOP,
+		CBOR_GPS_VDOP,
+		CBOR_GPS_TDOP,
+		/** Measurement ID */
+		CBOR_GPS_MEAS_ID,
+		/** Uptime of the fix, us */
+		CBOR_GPS_UPTIME,
+
+		CBOR_GPS_KEY_COUNT,
+	};
+
+	/** Keys of the login map */
+	enum cbor_login_key
+	{
+		/** Network status, text */
+		CBOR_LOGIN_NETWORK_STATUS,
+		/** RSRP, integer */
+		CBOR_LOGIN_RSRP,
+		/** ICCID, text */
+		CBOR_LOGIN_ICCID,
+		/** Mobile country code, integer */
+		CBOR_LOGIN_MCC,
+		/** Mobile network code, text */
+		CBOR_LOGIN_MNC,
+		/** Cell ID in hex, text */
+		CBOR_LOGIN_CELL_ID,
+		/** LTE band, integer */
+		CBOR_LOGIN_BAND,
+		/** Tracking area code, text */
+		CBOR_LOGIN_AREA_CODE,
+		/** Operator, text */
+		CBOR_LOGIN_OPERATOR,
+		/** Modem firmware version, text */
+		CBOR_LOGIN_MODEM,
+		/** Application firmware version, text */
+		CBOR_LOGIN_FIRMWARE,
+
+		CBOR_LOGIN_KEY_COUNT,
+	};
+
+	/** Content of the login message */
+	struct cbor_login_info
+	{
+		const char *network_status;
+		int32_t rsrp;
+		const char *iccid;
+		uint32_t mcc;
+		const char *mnc;
+		const char *cell_id;
+		uint32_t band;
+		const char *area_code;
+		const char *op;
+		const char *modem;
+		const char *firmware;
+	};
+
+	/**
+	 * @brief Encodes a GPS fix as CBOR map.
+	 *
+	 * @param gps GPS fix
+	 * @param buf output buffer
+	 * @param size size of the output buffer
+	 *
+	 * @return Length of the encoded map.
+	 * @retval -ENOMEM if the buffer is too small.
+	 */
+	int cbor_gps_encode(const struct velopera_gps_data *gps, uint8_t *buf, size_t size);
+
+	/**
+	 * @brief Encodes the login message as CBOR map.
+	 *
+	 * @param login content of the login message, NULL strings are encoded as empty strings
+	 * @param buf output buffer
+	 * @param size size of the output buffer
+	 *
+	 * @return Length of the encoded map.
+	 * @retval -ENOMEM if the buffer is too small.
+	 */
+	int cbor_login_encode(const struct cbor_login_info *login, uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PAYLOAD_CBOR_H__ */
@@ -0,0 +1,515 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "inflight.h"
+#include "store.h"
+
+LOG_MODULE_REGISTER(store, CONFIG_MQTT_SAMPLE_TRANSPORT_LOG_LEVEL);
+
+#define STORE_PARTITION_ID FIXED_PARTITION_ID(storage_partition)
+#define STORE_SECTOR_SIZE CONFIG_MQTT_SAMPLE_TRANSPORT_STORE_SECTOR_SIZE
+#define STORE_SECTOR_COUNT (FIXED_PARTITION_SIZE(storage_partition) / STORE_SECTOR_SIZE)
+#define STORE_WRITE_BUFFER_SIZE CONFIG_MQTT_SAMPLE_TRANSPORT_STORE_WRITE_BUFFER_SIZE
+
+BUILD_ASSERT(STORE_SECTOR_COUNT >= 2, "The FCB needs at least two sectors");
+BUILD_ASSERT(STORE_SECTOR_COUNT <= UINT8_MAX, "The FCB holds at most 255 sectors");
+BUILD_ASSERT(STORE_WRITE_BUFFER_SIZE % 8 == 0, "Chunks are padded to the flash write size");
+BUILD_ASSERT(STORE_WRITE_BUFFER_SIZE < STORE_SECTOR_SIZE / 2, "A sector holds several chunks");
+
+/* Magic number of the FCB sector headers, "VQUE" */
+#define STORE_FCB_MAGIC 0x56515545
+
+/* Topic length and payload length */
+#define RECORD_HEADER_SIZE 3
+
+/* One acknowledgement bit per record */
+#define CHUNK_MAX_RECORDS 32
+
+/* Delay before sending a chunk again that could not be sent completely */
+#define SEND_RETRY_MS 1000
+
+/* Records without PUBACK are sent again after this timeout */
+#define PUBACK_TIMEOUT_MS (CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_TIMEOUT_S * MSEC_PER_SEC)
+
+static struct flash_sector sectors[STORE_SECTOR_COUNT];
+static struct fcb fcb = {
+	.f_magic = STORE_FCB_MAGIC,
+	.f_sectors = sectors,
+	.f_sector_cnt = STORE_SECTOR_COUNT,
+};
+static inflight_send_t store_send;
+static bool initialized;
+
+/* Records not yet written to flash */
+static uint8_t write_buf[STORE_WRITE_BUFFER_SIZE];
+static size_t write_len;
+static uint8_t write_count;
+/* Time in ms of uptime at which the write buffer is written */
+static int64_t write_deadline;
+
+/* Chunks follow acked_loc in flash, all chunks up to it have been acknowledged. A NULL sector
+ * means the chunks start at the oldest sector.
+ */
+static struct fcb_entry acked_loc;
+static bool backlog;
+
+/* Chunk being sent */
+static uint8_t read_buf[STORE_WRITE_BUFFER_SIZE];
+static struct fcb_entry inflight_loc;
+static uint16_t inflight_off[CHUNK_MAX_RECORDS];
+static uint8_t inflight_count;
+/* Records up to inflight_sent have been sent since the chunk was read or sent again */
+static uint8_t inflight_sent;
+static uint16_t inflight_ids[CHUNK_MAX_RECORDS];
+/* One bit per record sent at least once, sent again with the DUP flag */
+static uint32_t inflight_dup;
+static atomic_t inflight_acked;
+/* Time in ms of uptime at which the chunk was sent completely */
+static int64_t inflight_sent_at;
+static atomic_t restart;
+
+/* Statistics */
+static uint32_t store_chunks;
+static uint32_t store_bytes;
+static uint32_t store_erases;
+static uint32_t store_dropped_sectors;
+static uint32_t store_retransmits;
+
+/* Erases the oldest sector, it has either been sent or is dropped for lack of space */
+static int sector_rotate(void)
+{
+	int err;
+
+	err = fcb_rotate(&fcb);
+	if (err)
+	{
+		LOG_ERR("fcb_rotate, error: %d", err);
+		return err;
+	}
+
+	store_erases++;
+
+	LOG_DBG("Sector erased, %d erases, on average %d.%02d per sector", store_erases,
+			store_erases / STORE_SECTOR_COUNT,
+			store_erases * 100 / STORE_SECTOR_COUNT % 100);
+
+	return 0;
+}
+
+/* Makes room by dropping the oldest sector, including chunks not sent yet */
+static int sector_drop_oldest(void)
+{
+	if (acked_loc.fe_sector == fcb.f_oldest)
+	{
+		acked_loc.fe_sector = NULL;
+	}
+
+	if ((inflight_count > 0) && (inflight_loc.fe_sector == fcb.f_oldest))
+	{
+		inflight_count = 0;
+	}
+
+	store_dropped_sectors++;
+
+	LOG_WRN("Store full, dropping the oldest sector, %d dropped", store_dropped_sectors);
+
+	return sector_rotate();
+}
+
+/* Writes the write buffer as one chunk */
+static int write_flush(void)
+{
+	struct fcb_entry loc;
+	size_t len = ROUND_UP(write_len, fcb.f_align);
+	int err;
+
+	if (write_count == 0)
+	{
+		return 0;
+	}
+
+	/* Zero padding reads as the end of the chunk */
+	memset(&write_buf[write_len], 0, len - write_len);
+
+	err = fcb_append(&fcb, len, &loc);
+	if (err == -ENOSPC)
+	{
+		err = sector_drop_oldest();
+		if (!err)
+		{
+			err = fcb_append(&fcb, len, &loc);
+		}
+	}
+
+	if (!err)
+	{
+		err = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), write_buf, len);
+	}
+
+	if (!err)
+	{
+		err = fcb_append_finish(&fcb, &loc);
+	}
+
+	if (err)
+	{
+		LOG_ERR("Failed to write %d messages, error: %d", write_count, err);
+	}
+	else
+	{
+		store_chunks++;
+		store_bytes += len;
+		backlog = true;
+
+		LOG_DBG("Stored %d messages in %d bytes, on average %d bytes per chunk", write_count,
+				(int)len, store_bytes / store_chunks);
+	}
+
+	write_len = 0;
+	write_count = 0;
+
+	return err;
+}
+
+/* Reads the chunk after acked_loc and splits it into records */
+static int chunk_read(void)
+{
+	struct fcb_entry loc = acked_loc;
+	size_t off = 0;
+	int err;
+
+	err = fcb_getnext(&fcb, &loc);
+	if (err)
+	{
+		backlog = false;
+		return -ENODATA;
+	}
+
+	inflight_loc = loc;
+	inflight_count = 0;
+	inflight_sent = 0;
+	inflight_dup = 0;
+	atomic_clear(&inflight_acked);
+
+	if (loc.fe_data_len <= sizeof(read_buf))
+	{
+		err = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), read_buf, loc.fe_data_len);
+		if (err)
+		{
+			LOG_ERR("flash_area_read, error: %d", err);
+			return err;
+		}
+	}
+
+	while ((loc.fe_data_len <= sizeof(read_buf)) && (off + RECORD_HEADER_SIZE <= loc.fe_data_len) &&
+		   (inflight_count < CHUNK_MAX_RECORDS))
+	{
+		uint8_t topic_len = read_buf[off];
+		uint16_t len = sys_get_le16(&read_buf[off + 1]);
+
+		if (topic_len == 0)
+		{
+			break;
+		}
+
+		if ((off + RECORD_HEADER_SIZE + topic_len + len > loc.fe_data_len) ||
+			(read_buf[off + RECORD_HEADER_SIZE + topic_len - 1] != '\0'))
+		{
+			LOG_WRN("Corrupt record at offset %d, dropping the rest of the chunk", (int)off);
+			break;
+		}
+
+		inflight_ids[inflight_count] = inflight_message_id();
+		inflight_off[inflight_count++] = off;
+		off += RECORD_HEADER_SIZE + topic_len + len;
+	}
+
+	return 0;
+}
+
+/* Sends the records of the chunk not sent or acknowledged yet */
+static int chunk_send(void)
+{
+	if (inflight_sent == inflight_count)
+	{
+		return 0;
+	}
+
+	for (; inflight_sent < inflight_count; inflight_sent++)
+	{
+		const uint8_t *record = &read_buf[inflight_off[inflight_sent]];
+		const uint8_t *topic = &record[RECORD_HEADER_SIZE];
+		bool dup = inflight_dup & BIT(inflight_sent);
+		int err;
+
+		if (atomic_get(&inflight_acked) & BIT(inflight_sent))
+		{
+			continue;
+		}
+
+		err = store_send(topic, &topic[record[0]], sys_get_le16(&record[1]),
+						 inflight_ids[inflight_sent], dup);
+		if (err)
+		{
+			return err;
+		}
+
+		if (dup)
+		{
+			store_retransmits++;
+		}
+
+		inflight_dup |= BIT(inflight_sent);
+	}
+
+	inflight_sent_at = k_uptime_get();
+
+	return 0;
+}
+
+static bool chunk_acked(void)
+{
+	if (inflight_sent < inflight_count)
+	{
+		return false;
+	}
+
+	return (inflight_count == 0) ||
+		   (atomic_get(&inflight_acked) == (atomic_val_t)GENMASK(inflight_count - 1, 0));
+}
+
+/* Moves acked_loc past the chunk, erasing its sector after the last chunk in it */
+static void chunk_done(void)
+{
+	struct fcb_entry next = inflight_loc;
+	bool sector_done;
+
+	acked_loc = inflight_loc;
+	inflight_count = 0;
+
+	/* Sectors before the chunk only hold acknowledged chunks */
+	for (int i = 0; (i < STORE_SECTOR_COUNT) && (fcb.f_oldest != acked_loc.fe_sector); i++)
+	{
+		if (sector_rotate())
+		{
+			break;
+		}
+	}
+
+	if (fcb_getnext(&fcb, &next) == 0)
+	{
+		sector_done = (next.fe_sector != acked_loc.fe_sector);
+	}
+	else
+	{
+		/* Later chunks are appended to the same sector while it is active */
+		sector_done = (fcb.f_active.fe_sector != acked_loc.fe_sector);
+	}
+
+	if (sector_done && (fcb.f_oldest == acked_loc.fe_sector) && (sector_rotate() == 0))
+	{
+		acked_loc.fe_sector = NULL;
+	}
+}
+
+int store_init(inflight_send_t send)
+{
+	const struct flash_area *fa;
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(sectors); i++)
+	{
+		sectors[i].fs_off = i * STORE_SECTOR_SIZE;
+		sectors[i].fs_size = STORE_SECTOR_SIZE;
+	}
+
+	err = fcb_init(STORE_PARTITION_ID, &fcb);
+	if (err)
+	{
+		LOG_WRN("No FCB on the storage partition, erasing it, fcb_init error: %d", err);
+
+		err = flash_area_open(STORE_PARTITION_ID, &fa);
+		if (err)
+		{
+			LOG_ERR("flash_area_open, error: %d", err);
+			return err;
+		}
+
+		err = flash_area_erase(fa, 0, fa->fa_size);
+		flash_area_close(fa);
+		if (err)
+		{
+			LOG_ERR("flash_area_erase, error: %d", err);
+			return err;
+		}
+
+		store_erases += STORE_SECTOR_COUNT;
+
+		err = fcb_init(STORE_PARTITION_ID, &fcb);
+		if (err)
+		{
+			LOG_ERR("fcb_init, error: %d", err);
+			return err;
+		}
+	}
+
+	if (fcb.f_align > 8)
+	{
+		LOG_ERR("Flash write size %d not supported", fcb.f_align);
+		return -ENOTSUP;
+	}
+
+	store_send = send;
+	backlog = !fcb_is_empty(&fcb);
+	initialized = true;
+
+	LOG_INF("Store of %d sectors of %d bytes, %s", STORE_SECTOR_COUNT, STORE_SECTOR_SIZE,
+			backlog ? "holding messages from before the restart" : "empty");
+
+	return 0;
+}
+
+int store_append(const uint8_t *topic, const void *data, size_t len)
+{
+	size_t topic_len = strlen((const char *)topic) + 1;
+	size_t record_len = RECORD_HEADER_SIZE + topic_len + len;
+	uint8_t *record;
+
+	if (!initialized)
+	{
+		return -ENODEV;
+	}
+
+	if ((topic_len > UINT8_MAX) || (record_len > sizeof(write_buf)))
+	{
+		return -EMSGSIZE;
+	}
+
+	if ((write_len + record_len > sizeof(write_buf)) || (write_count == CHUNK_MAX_RECORDS))
+	{
+		(void)write_flush();
+	}
+
+	if (write_count == 0)
+	{
+		write_deadline = k_uptime_get() + CONFIG_MQTT_SAMPLE_TRANSPORT_STORE_WRITE_DELAY_MS;
+	}
+
+	record = &write_buf[write_len];
+	record[0] = topic_len;
+	sys_put_le16(len, &record[1]);
+	memcpy(&record[RECORD_HEADER_SIZE], topic, topic_len);
+	memcpy(&record[RECORD_HEADER_SIZE + topic_len], data, len);
+
+	write_len += record_len;
+	write_count++;
+
+	return 0;
+}
+
+bool store_pending(void)
+{
+	return initialized && ((write_count > 0) || (inflight_count > 0) || backlog);
+}
+
+int64_t store_process(bool connected)
+{
+	int64_t remaining = -1;
+
+	if (!initialized)
+	{
+		return -1;
+	}
+
+	if (atomic_clear(&restart))
+	{
+		inflight_sent = 0;
+	}
+
+	while (connected)
+	{
+		if (inflight_count == 0)
+		{
+			/* The write buffer follows once the stored chunks have been sent */
+			if (!backlog)
+			{
+				(void)write_flush();
+			}
+
+			if (!backlog || (chunk_read() == -ENODATA))
+			{
+				break;
+			}
+		}
+
+		if (chunk_send())
+		{
+			return SEND_RETRY_MS;
+		}
+
+		if (!chunk_acked())
+		{
+			/* Called again by the PUBACK of the last record or once the timeout expires */
+			remaining = inflight_sent_at + PUBACK_TIMEOUT_MS - k_uptime_get();
+			if (remaining > 0)
+			{
+				break;
+			}
+
+			LOG_WRN("No PUBACK within %d s, sending the chunk again, %d retransmits",
+					CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_TIMEOUT_S, store_retransmits);
+			inflight_sent = 0;
+			continue;
+		}
+
+		remaining = -1;
+		chunk_done();
+	}
+
+	if (write_count > 0)
+	{
+		int64_t write_remaining = write_deadline - k_uptime_get();
+
+		if (write_remaining <= 0)
+		{
+			(void)write_flush();
+		}
+		else
+		{
+			remaining = (remaining < 0) ? write_remaining : MIN(remaining, write_remaining);
+		}
+	}
+
+	return remaining;
+}
+
+bool store_puback(uint16_t message_id)
+{
+	uint8_t count = inflight_count;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		if (inflight_ids[i] == message_id)
+		{
+			atomic_val_t all = (atomic_val_t)GENMASK(count - 1, 0);
+
+			return (atomic_or(&inflight_acked, BIT(i)) | BIT(i)) == all;
+		}
+	}
+
+	return false;
+}
+
+void store_restart(void)
+{
+	atomic_set(&restart, 1);
+}
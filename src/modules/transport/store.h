@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Flash backed store-and-forward queue of uplink messages.
+ *
+ * Messages published while the MQTT connection is down are kept in a flash circular buffer (FCB)
+ * on the storage partition and sent in order once it is up again. A message is only removed
+ * after its PUBACK has been received.
+ *
+ * Messages are collected in a RAM write buffer and written as one FCB entry, a chunk, once the
+ * buffer is full or its oldest message has waited for the write delay. A chunk holds records of
+ * [topic length incl. NUL, u8][payload length, le16][topic][payload], a topic length of 0 ends
+ * the chunk. One chunk at a time is read back and sent, each record with its own message ID from
+ * inflight_message_id(). Records without PUBACK within the in-flight timeout are sent again. Once
+ * all of them are acknowledged the next chunk follows, a sector is erased after its last chunk.
+ *
+ * If the partition is full, the oldest sector is dropped. Delivery is at least once, after a
+ * restart the chunks of the oldest sector that were acknowledged already are sent again.
+ */
+
+#ifndef STORE_H__
+#define STORE_H__
+
+#include <zephyr/kernel.h>
+
+#include "inflight.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/**
+	 * @brief Mounts the FCB on the storage partition. A partition that holds no FCB is erased.
+	 *
+	 * @param send sends stored messages
+	 *
+	 * @return 0 on success, a negative error code otherwise.
+	 */
+	int store_init(inflight_send_t send);
+
+	/**
+	 * @brief Appends a message to the write buffer, writing the buffer first if it is full.
+	 *
+	 * @param topic NUL terminated topic
+	 * @param data payload
+	 * @param len length of the payload
+	 *
+	 * @retval 0 on success.
+	 * @retval -EMSGSIZE if the message does not fit into the write buffer.
+	 * @retval -ENODEV if the store is not initialized.
+	 */
+	int store_append(const uint8_t *topic, const void *data, size_t len);
+
+	/**
+	 * @brief Returns true while messages are waiting in the store.
+	 *
+	 * New messages have to be appended to the store as well to keep them in order.
+	 */
+	bool store_pending(void);
+
+	/**
+	 * @brief Writes the write buffer when it is due and sends stored messages.
+	 *
+	 * Has to be called from the same thread as store_append(), again once a chunk has been
+	 * acknowledged, see store_puback().
+	 *
+	 * @param connected true while messages can be sent
+	 *
+	 * @return Time in ms until the next call is due, or -1 if nothing is due.
+	 */
+	int64_t store_process(bool connected);
+
+	/**
+	 * @brief Marks a message as acknowledged, can be called from any thread.
+	 *
+	 * @param message_id message ID of the PUBACK
+	 *
+	 * @return true if all messages of the chunk are acknowledged now.
+	 */
+	bool store_puback(uint16_t message_id);
+
+	/**
+	 * @brief Sends the messages of the current chunk again, to be called after reconnecting.
+	 *
+	 * Can be called from any thread.
+	 */
+	void store_restart(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORE_H__ */
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "timeseries.h"
+
+/* Leading zeros before the first window, no XOR matches it */
+#define NO_WINDOW UINT8_MAX
+
+/* Delta-of-delta buckets after the first: prefix, prefix bits, value bits and offset */
+static const struct
+{
+	uint8_t prefix;
+	uint8_t prefix_bits;
+	uint8_t bits;
+	int32_t offset;
+} dod_bucket[] = {
+	{0x2, 2, 7, 63},
+	{0x6, 3, 9, 255},
+	{0xe, 4, 12, 2047},
+};
+
+/* Writes count bits of value, returns false if they do not fit */
+static bool bits_put(struct ts_block *block, uint32_t value, uint8_t count)
+{
+	if (block->bit_len + count > block->size * 8)
+	{
+		return false;
+	}
+
+	while (count-- > 0)
+	{
+		uint8_t *byte = &block->buf[block->bit_len / 8];
+		uint8_t mask = BIT(7 - block->bit_len % 8);
+
+		/* Bits of a failed append may be left behind the end */
+		*byte = ((value >> count) & 1) ? (*byte | mask) : (*byte & ~mask);
+		block->bit_len++;
+	}
+
+	return true;
+}
+
+static bool bits_get(struct ts_block_decoder *dec, uint8_t count, uint32_t *value)
+{
+	if (dec->bit_pos + count > dec->len * 8)
+	{
+		return false;
+	}
+
+	*value = 0;
+
+	for (; count > 0; count--, dec->bit_pos++)
+	{
+		*value = (*value << 1) | ((dec->buf[dec->bit_pos / 8] >> (7 - dec->bit_pos % 8)) & 1);
+	}
+
+	return true;
+}
+
+/* Returns the number of leading one bits of the next up to max bits */
+static bool prefix_get(struct ts_block_decoder *dec, uint8_t max, uint8_t *ones)
+{
+	uint32_t bit = 1;
+
+	for (*ones = 0; (*ones < max) && bit; (*ones)++)
+	{
+		if (!bits_get(dec, 1, &bit))
+		{
+			return false;
+		}
+
+		if (!bit)
+		{
+			return true;
+		}
+	}
+
+	return true;
+}
+
+static bool time_put(struct ts_block *block, int64_t time)
+{
+	int64_t delta = time - block->prev_time;
+	int64_t dod = delta - block->prev_delta;
+
+	block->prev_time = time;
+	block->prev_delta = delta;
+
+	if (dod == 0)
+	{
+		return bits_put(block, 0, 1);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(dod_bucket); i++)
+	{
+		if ((dod >= -dod_bucket[i].offset) && (dod <= dod_bucket[i].offset + 1))
+		{
+			return bits_put(block, dod_bucket[i].prefix, dod_bucket[i].prefix_bits) &&
+				   bits_put(block, dod + dod_bucket[i].offset, dod_bucket[i].bits);
+		}
+	}
+
+	return bits_put(block, 0xf, 4) && bits_put(block, (uint32_t)dod, 32);
+}
+
+static bool value_put(struct ts_block *block, uint32_t value)
+{
+	uint32_t xor = value ^ block->prev_value;
+	uint8_t leading;
+	uint8_t trailing;
+
+	block->prev_value = value;
+
+	if (xor == 0)
+	{
+		return bits_put(block, 0, 1);
+	}
+
+	leading = __builtin_clz(xor);
+	trailing = __builtin_ctz(xor);
+
+	if ((leading >= block->prev_leading) && (trailing >= block->prev_trailing))
+	{
+		return bits_put(block, 0x2, 2) &&
+			   bits_put(block, xor >> block->prev_trailing,
+						32 - block->prev_leading - block->prev_trailing);
+	}
+
+	block->prev_leading = leading;
+	block->prev_trailing = trailing;
+
+	return bits_put(block, 0x3, 2) && bits_put(block, leading, 5) &&
+		   bits_put(block, 32 - leading - trailing - 1, 5) &&
+		   bits_put(block, xor >> trailing, 32 - leading - trailing);
+}
+
+void ts_block_init(struct ts_block *block, uint8_t id, uint8_t *buf, size_t size)
+{
+	__ASSERT_NO_MSG(size >= TS_BLOCK_HEADER_SIZE + 12);
+
+	memset(block, 0, sizeof(*block));
+	block->buf = buf;
+	block->size = size;
+	block->bit_len = TS_BLOCK_HEADER_SIZE * 8;
+	block->prev_leading = NO_WINDOW;
+
+	buf[0] = id;
+	sys_put_le16(0, &buf[1]);
+}
+
+int ts_block_append(struct ts_block *block, int64_t time, int32_t value)
+{
+	struct ts_block saved = *block;
+	bool fits;
+
+	if (block->count == UINT16_MAX)
+	{
+		return -ENOMEM;
+	}
+
+	if (block->count == 0)
+	{
+		block->prev_time = time;
+		block->prev_value = value;
+		fits = bits_put(block, (uint64_t)time >> 32, 32) && bits_put(block, time, 32) &&
+			   bits_put(block, value, 32);
+	}
+	else
+	{
+		int64_t dod = (time - block->prev_time) - block->prev_delta;
+
+		if ((dod < INT32_MIN) || (dod > INT32_MAX))
+		{
+			return -ERANGE;
+		}
+
+		fits = time_put(block, time) && value_put(block, value);
+	}
+
+	if (!fits)
+	{
+		*block = saved;
+		return -ENOMEM;
+	}
+
+	block->count++;
+
+	return 0;
+}
+
+size_t ts_block_flush(struct ts_block *block)
+{
+	size_t len = DIV_ROUND_UP(block->bit_len, 8);
+	uint8_t pad = len * 8 - block->bit_len;
+
+	sys_put_le16(block->count, &block->buf[1]);
+
+	if (pad > 0)
+	{
+		block->buf[len - 1] &= ~BIT_MASK(pad);
+	}
+
+	return len;
+}
+
+int ts_block_decoder_init(struct ts_block_decoder *dec, const uint8_t *buf, size_t len,
+						  uint8_t *id)
+{
+	if (len < TS_BLOCK_HEADER_SIZE)
+	{
+		return -EBADMSG;
+	}
+
+	memset(dec, 0, sizeof(*dec));
+	dec->buf = buf;
+	dec->len = len;
+	dec->bit_pos = TS_BLOCK_HEADER_SIZE * 8;
+	dec->count = sys_get_le16(&buf[1]);
+	dec->prev_leading = NO_WINDOW;
+
+	*id = buf[0];
+
+	return 0;
+}
+
+static bool time_get(struct ts_block_decoder *dec, int64_t *time)
+{
+	uint8_t ones;
+	uint32_t bits;
+	int64_t dod;
+
+	if (!prefix_get(dec, 4, &ones))
+	{
+		return false;
+	}
+
+	if (ones == 0)
+	{
+		dod = 0;
+	}
+	else if (ones <= ARRAY_SIZE(dod_bucket))
+	{
+		if (!bits_get(dec, dod_bucket[ones - 1].bits, &bits))
+		{
+			return false;
+		}
+		dod = (int64_t)bits - dod_bucket[ones - 1].offset;
+	}
+	else
+	{
+		if (!bits_get(dec, 32, &bits))
+		{
+			return false;
+		}
+		dod = (int32_t)bits;
+	}
+
+	dec->prev_delta += dod;
+	dec->prev_time += dec->prev_delta;
+	*time = dec->prev_time;
+
+	return true;
+}
+
+static bool value_get(struct ts_block_decoder *dec, int32_t *value)
+{
+	uint8_t ones;
+	uint32_t leading;
+	uint32_t length;
+	uint32_t xor;
+
+	if (!prefix_get(dec, 2, &ones))
+	{
+		return false;
+	}
+
+	if (ones == 1)
+	{
+		if (dec->prev_leading == NO_WINDOW)
+		{
+			return false;
+		}
+
+		length = 32 - dec->prev_leading - dec->prev_trailing;
+		if (!bits_get(dec, length, &xor))
+		{
+			return false;
+		}
+		dec->prev_value ^= xor << dec->prev_trailing;
+	}
+	else if (ones == 2)
+	{
+		if (!bits_get(dec, 5, &leading) || !bits_get(dec, 5, &length))
+		{
+			return false;
+		}
+
+		length += 1;
+		if (leading + length > 32)
+		{
+			return false;
+		}
+
+		dec->prev_leading = leading;
+		dec->prev_trailing = 32 - leading - length;
+
+		if (!bits_get(dec, length, &xor))
+		{
+			return false;
+		}
+		dec->prev_value ^= (uint64_t)xor << dec->prev_trailing;
+	}
+
+	*value = dec->prev_value;
+
+	return true;
+}
+
+int ts_block_decoder_next(struct ts_block_decoder *dec, int64_t *time, int32_t *value)
+{
+	if (dec->index == dec->count)
+	{
+		return -ENODATA;
+	}
+
+	if (dec->index == 0)
+	{
+		uint32_t high;
+		uint32_t low;
+
+		if (!bits_get(dec, 32, &high) || !bits_get(dec, 32, &low) ||
+			!bits_get(dec, 32, &dec->prev_value))
+		{
+			return -EBADMSG;
+		}
+
+		dec->prev_time = (int64_t)(((uint64_t)high << 32) | low);
+		*time = dec->prev_time;
+		*value = dec->prev_value;
+	}
+	else if (!time_get(dec, time) || !value_get(dec, value))
+	{
+		return -EBADMSG;
+	}
+
+	dec->index++;
+
+	return 0;
+}
+
+size_t ts_block_decoder_size(const struct ts_block_decoder *dec)
+{
+	return DIV_ROUND_UP(dec->bit_pos, 8);
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Gorilla style compression of the time series of one fixed-point signal.
+ *
+ * A block starts with a three byte header, the series id and the number of samples, little
+ * endian, followed by a bit stream, most significant bit first, padded with zero bits to a whole
+ * byte. Blocks are self-delimiting and can be concatenated.
+ *
+ * The first sample holds the time in 64 bits and the value in 32 bits. Every following sample
+ * holds the delta-of-delta of the time, the first delta being relative to 0:
+ * - '0': same interval as before
+ * - '10' + 7 bits, '110' + 9 bits, '1110' + 12 bits: delta-of-delta + 63, 255 or 2047
+ * - '1111' + 32 bits: delta-of-delta, two's complement
+ *
+ * and the XOR of the value with the previous value:
+ * - '0': same value
+ * - '10' + meaningful bits: the set bits lie within the window of the previous value, only the
+ *   bits of that window are stored
+ * - '11' + 5 bits leading zeros + 5 bits window length - 1 + window bits: new window
+ *
+ * Signals sampled at a steady rate that change slowly take 2 to a few bits per sample.
+ */
+
+#ifndef TIMESERIES_H__
+#define TIMESERIES_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Size of the block header */
+#define TS_BLOCK_HEADER_SIZE 3
+
+	/** Encoder state, appended samples are kept in the block buffer */
+	struct ts_block
+	{
+		uint8_t *buf;
+		size_t size;
+		/** Bits written including the header */
+		size_t bit_len;
+		/** Number of samples in the block */
+		uint16_t count;
+
+		int64_t prev_time;
+		int64_t prev_delta;
+		uint32_t prev_value;
+		/** Window of the previous XOR, leading and trailing zeros */
+		uint8_t prev_leading;
+		uint8_t prev_trailing;
+	};
+
+	struct ts_block_decoder
+	{
+		const uint8_t *buf;
+		size_t len;
+		size_t bit_pos;
+		uint16_t count;
+		uint16_t index;
+
+		int64_t prev_time;
+		int64_t prev_delta;
+		uint32_t prev_value;
+		uint8_t prev_leading;
+		uint8_t prev_trailing;
+	};
+
+	/**
+	 * @brief Starts an empty block.
+	 *
+	 * @param block encoder
+	 * @param id series id written to the header
+	 * @param buf block buffer
+	 * @param size size of the block buffer, at least TS_BLOCK_HEADER_SIZE + 12
+	 */
+	void ts_block_init(struct ts_block *block, uint8_t id, uint8_t *buf, size_t size);
+
+	/**
+	 * @brief Appends a sample to the block.
+	 *
+	 * @param block encoder
+	 * @param time sample time in ms, not earlier than the previous sample
+	 * @param value sample value
+	 *
+	 * @retval 0 on success.
+	 * @retval -ENOMEM if the sample does not fit into the block, the block is unchanged.
+	 * @retval -ERANGE if the delta-of-delta of the time does not fit into 32 bits, the block
+	 *         is unchanged.
+	 */
+	int ts_block_append(struct ts_block *block, int64_t time, int32_t value);
+
+	/**
+	 * @brief Completes the header and pads the bit stream.
+	 *
+	 * The block can be appended to afterwards, flushing again returns the longer block.
+	 *
+	 * @param block encoder
+	 *
+	 * @return Length of the block in bytes.
+	 */
+	size_t ts_block_flush(struct ts_block *block);
+
+	/**
+	 * @brief Reads the header of a block.
+	 *
+	 * @param dec decoder
+	 * @param buf block, may be followed by more blocks
+	 * @param len length of the buffer
+	 * @param id series id of the block
+	 *
+	 * @retval 0 on success.
+	 * @retval -EBADMSG if the header is truncated.
+	 */
+	int ts_block_decoder_init(struct ts_block_decoder *dec, const uint8_t *buf, size_t len,
+							  uint8_t *id);
+
+	/**
+	 * @brief Decodes the next sample.
+	 *
+	 * @param dec decoder
+	 * @param time sample time in ms
+	 * @param value sample value
+	 *
+	 * @retval 0 on success.
+	 * @retval -ENODATA after the last sample, see ts_block_decoder_size().
+	 * @retval -EBADMSG if the block is truncated.
+	 */
+	int ts_block_decoder_next(struct ts_block_decoder *dec, int64_t *time, int32_t *value);
+
+	/**
+	 * @brief Returns the length of the block in bytes once all samples have been decoded.
+	 *
+	 * @param dec decoder
+	 */
+	size_t ts_block_decoder_size(const struct ts_block_decoder *dec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMESERIES_H__ */
@@ -9,21 +9,71 @@
 #include <zephyr/zbus/zbus.h>
 #include <zephyr/smf.h>
 #include <zephyr/net/tls_credentials.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif /* CONFIG_SHELL */
 #include "dynsec_mqtt_helper.h"
 #include "message_channel.h"
 #include <modem/modem_info.h>
 
 #include "firmware_version.h"
+#include "fixed_format.h"
+#include "inflight.h"
+#include "payload_buf.h"
+#include "txqueue.h"
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_CBOR)
+#include "payload_cbor.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_CBOR */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK)
+#include "gps_track.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+#include "lzss.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+#include "nina_data.h"
+#include "timeseries.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+#include "store.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
 extern char imei[16];
 
 uint8_t login_topic[50] = "";
 
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR)
+/* The last will keeps the JSON login topic */
+static uint8_t login_cbor_topic[sizeof(login_topic) + sizeof("/cbor")];
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR */
+
 /* Register log module */
 LOG_MODULE_REGISTER(transport, 4);
 
 /* Register subscriber */
 ZBUS_SUBSCRIBER_DEFINE(transport, CONFIG_MQTT_SAMPLE_TRANSPORT_MESSAGE_QUEUE_SIZE);
 
+/* Payload buffers of the lines published on MQTT_CHAN, until transport_task() queues them */
+K_FIFO_DEFINE(payload_fifo);
+
+/* Takes a reference to the payload buffer, the notifications of transport may be merged while
+ * the channel only ever holds the latest buffer.
+ */
+static void payload_callback(const struct zbus_channel *chan)
+{
+	struct net_buf *buf;
+
+	if (&MQTT_CHAN != chan)
+	{
+		return;
+	}
+
+	buf = *(struct net_buf *const *)zbus_chan_const_msg(chan);
+	net_buf_put(&payload_fifo, net_buf_ref(buf));
+}
+
+/* Register listener - payload_callback is called before transport is notified of a line */
+ZBUS_LISTENER_DEFINE(transport_payload, payload_callback);
+
 /* ID for subscribe topic - Used to verify that a subscription succeeded in on_mqtt_suback(). */
 #define SUBSCRIBE_TOPIC_ID 2469
 
@@ -31,13 +81,69 @@ ZBUS_SUBSCRIBER_DEFINE(transport, CONFIG_MQTT_SAMPLE_TRANSPORT_MESSAGE_QUEUE_SIZ
 static const struct smf_state state[];
 static void connect_work_fn(struct k_work *work);
 static void mqtt_pub_work_fn(struct k_work *work);
+static size_t sensor_merge(const void *older, size_t older_len, bool older_aggregate,
+						   const void *newer, size_t newer_len, bool newer_aggregate,
+						   const void **merged);
 
 /* Define connection work - Used to handle reconnection attempts to the MQTT broker */
 static K_WORK_DELAYABLE_DEFINE(connect_work, connect_work_fn);
 static K_WORK_DELAYABLE_DEFINE(mqtt_pub_work, mqtt_pub_work_fn);
 
-K_MSGQ_DEFINE(gps_data_queue, sizeof(struct velopera_gps_data), 20, 4);
-K_MSGQ_DEFINE(sensor_data_queue, sizeof(struct velopera_payload), 20, 4);
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_OVERFLOW_DROP_NEWEST)
+#define GPS_OVERFLOW TXQUEUE_DROP_NEWEST
+#elif defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_OVERFLOW_DROP_OLDEST)
+#define GPS_OVERFLOW TXQUEUE_DROP_OLDEST
+#else
+#define GPS_OVERFLOW TXQUEUE_DECIMATE
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_OVERFLOW_DROP_NEWEST */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_OVERFLOW_DROP_NEWEST)
+#define SENSOR_OVERFLOW TXQUEUE_DROP_NEWEST
+#elif defined(CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_OVERFLOW_DECIMATE)
+#define SENSOR_OVERFLOW TXQUEUE_DECIMATE
+#elif defined(CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_OVERFLOW_MERGE)
+#define SENSOR_OVERFLOW TXQUEUE_MERGE
+#else
+#define SENSOR_OVERFLOW TXQUEUE_DROP_OLDEST
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_OVERFLOW_DROP_NEWEST */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+#define CONTROL_MIN_BYTES CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_CONTROL_MIN_BYTES
+#else
+#define CONTROL_MIN_BYTES 0
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+
+BUILD_ASSERT(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_MIN_BYTES + CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_MIN_BYTES +
+					 CONTROL_MIN_BYTES <=
+				 CONFIG_MQTT_SAMPLE_TRANSPORT_POOL_SIZE,
+			 "The minimum queue quotas exceed the transport pool");
+
+/* All queues take their records from one pool, a sensor record is the NUL terminated line
+ * followed by its reception timestamp, see sensor_put().
+ */
+TXQUEUE_POOL_DEFINE(queue_pool, CONFIG_MQTT_SAMPLE_TRANSPORT_POOL_SIZE);
+
+/* RAM of the fixed queues the pool replaced, 20 GPS fixes and 20 payloads */
+#define FIXED_QUEUES_SIZE (20 * (sizeof(struct velopera_gps_data) + sizeof(struct velopera_payload)))
+
+/* GPS fixes cannot be merged, TXQUEUE_MERGE drops the oldest one */
+TXQUEUE_DEFINE(gps_data_queue, queue_pool, CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_MIN_BYTES,
+			   CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_MAX_BYTES, CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TTL_S,
+			   IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_NEWEST_FIRST), GPS_OVERFLOW, NULL);
+TXQUEUE_DEFINE(sensor_data_queue, queue_pool, CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_MIN_BYTES,
+			   CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_MAX_BYTES,
+			   CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_TTL_S,
+			   IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_SENSOR_NEWEST_FIRST), SENSOR_OVERFLOW,
+			   sensor_merge);
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+/* Nina lines matching CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_CONTROL_MATCH, they never expire */
+TXQUEUE_DEFINE(control_data_queue, queue_pool, CONTROL_MIN_BYTES,
+			   CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_CONTROL_MAX_BYTES, 0, false, TXQUEUE_DROP_NEWEST,
+			   NULL);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+K_MSGQ_DEFINE(nina_data_queue, sizeof(struct velopera_nina_data), 20, 4);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
 
 /* Define stack_area of application workqueue */
 K_THREAD_STACK_DEFINE(stack_area, CONFIG_MQTT_SAMPLE_TRANSPORT_WORKQUEUE_STACK_SIZE);
@@ -48,8 +154,20 @@ K_THREAD_STACK_DEFINE(stack_area, CONFIG_MQTT_SAMPLE_TRANSPORT_WORKQUEUE_STACK_S
 static struct k_work_q transport_queue;
 
 struct velopera_payload login_msg;
+static int login_msg_len;
 struct velopera_gps_data gps_data;
 
+/* Set between CONNACK and disconnect */
+static atomic_t mqtt_connected;
+
+/* Messages that could neither be tracked, stored nor sent */
+static uint32_t publish_dropped;
+
+/* GPS encoding statistics, JSON, CBOR or track */
+static uint32_t gps_encoded;
+static uint32_t gps_encode_bytes;
+static uint32_t gps_encode_cycles;
+
 /* Internal states */
 enum module_state
 {
@@ -59,6 +177,9 @@ enum module_state
 
 static uint8_t pub_topic[CONFIG_MQTT_SAMPLE_TRANSPORT_CLIENT_ID_BUFFER_SIZE + sizeof(CONFIG_MQTT_SAMPLE_TRANSPORT_PUBLISH_TOPIC)];
 static uint8_t gps_pub_topic[CONFIG_MQTT_SAMPLE_TRANSPORT_CLIENT_ID_BUFFER_SIZE + sizeof(CONFIG_MQTT_SAMPLE_TRANSPORT_SUBSCRIBE_TOPIC)];
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+static uint8_t ts_pub_topic[CONFIG_MQTT_SAMPLE_TRANSPORT_CLIENT_ID_BUFFER_SIZE + sizeof("ts")];
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
 
 static uint8_t fota_sub_topic[CONFIG_MQTT_SAMPLE_TRANSPORT_CLIENT_ID_BUFFER_SIZE + sizeof(CONFIG_MQTT_SAMPLE_TRANSPORT_SUBSCRIBE_TOPIC)];
 static uint8_t psk_sub_topic[CONFIG_MQTT_SAMPLE_TRANSPORT_CLIENT_ID_BUFFER_SIZE + sizeof(CONFIG_MQTT_SAMPLE_TRANSPORT_SUBSCRIBE_TOPIC)];
@@ -77,29 +198,32 @@ static struct s_object
 	/* Network status */
 	enum network_status status;
 
-	/* Payload */
-	struct velopera_payload payload;
-
 	/* Topic */
 	uint8_t *topic;
 } s_obj;
 
 /**
- * @brief This helper function publishes an MQTT message to the broker
+ * @brief This helper function sends raw data as MQTT message to the broker
  *
- * @param payload  message that wanted to publish
  * @param topic topic of the published message
- * @param topic_size size of the topic
+ * @param data message that wanted to publish
+ * @param len length of the message
+ * @param message_id message ID of the PUBLISH
+ * @param dup true if the message has been sent before with the same message ID
+ *
+ * @return 0 on success, a negative error code otherwise.
  */
-static void publish(struct velopera_payload *payload, uint8_t *topic, size_t topic_size)
+static int publish_message(const uint8_t *topic, const uint8_t *data, size_t len,
+						   uint16_t message_id, bool dup)
 {
 	int err;
 
 	struct mqtt_publish_param param = {
-		.message.payload.data = payload->string,
-		.message.payload.len = strlen(payload->string),
+		.message.payload.data = (uint8_t *)data,
+		.message.payload.len = len,
 		.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE,
-		.message_id = k_uptime_get_32(),
+		.message_id = message_id,
+		.dup_flag = dup,
 		.message.topic.topic.utf8 = topic,
 		.message.topic.topic.size = strlen(topic),
 	};
@@ -108,283 +232,1422 @@ static void publish(struct velopera_payload *payload, uint8_t *topic, size_t top
 	if (err)
 	{
 		LOG_WRN("Failed to send payload, err: %d", err);
-		return;
+		return err;
 	}
 
 	LOG_DBG("Published message: \"%.*s\" on topic: \"%.*s\"", param.message.payload.len,
 			param.message.payload.data,
 			param.message.topic.topic.size,
 			param.message.topic.topic.utf8);
+
+	return 0;
+}
+
+/**
+ * @brief This helper function publishes raw data as MQTT message to the broker through the
+ * in-flight window, or stores it while offline
+ *
+ * @param data message that wanted to publish
+ * @param len length of the message
+ * @param topic topic of the published message
+ */
+static void publish_data(const char *data, size_t len, uint8_t *topic)
+{
+	int err;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+	/* Messages queue up behind stored ones to keep their order */
+	if (!atomic_get(&mqtt_connected) || store_pending())
+	{
+		err = store_append(topic, data, len);
+		if (!err)
+		{
+			return;
+		}
+
+		LOG_WRN("store_append, error: %d", err);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+
+	err = inflight_publish(topic, data, len);
+	if (!err)
+	{
+		return;
+	}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+	/* Sent once the window has room again */
+	if (store_append(topic, data, len) == 0)
+	{
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+
+	/* Without a connection the message cannot be sent at all */
+	if (!atomic_get(&mqtt_connected))
+	{
+		publish_dropped++;
+		LOG_WRN("inflight_publish, error: %d, offline, message dropped, %d in total", err,
+				publish_dropped);
+		return;
+	}
+
+	LOG_WRN("inflight_publish, error: %d, sending without PUBACK tracking", err);
+	(void)publish_message(topic, (const uint8_t *)data, len, inflight_message_id(), false);
+}
+
+/**
+ * @brief This helper function sends an MQTT message to the broker
+ *
+ * @param payload  message that wanted to publish
+ * @param topic topic of the published message
+ * @param topic_size size of the topic
+ */
+static void publish(struct velopera_payload *payload, uint8_t *topic, size_t topic_size)
+{
+	(void)publish_message(topic, payload->string, strlen(payload->string), inflight_message_id(),
+						  false);
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH)
+
+/* Messages of one topic collected into a JSON array */
+struct batch
+{
+	uint8_t *topic;
+	/* CBOR indefinite-length array instead of a JSON array */
+	bool cbor;
+	char buf[CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_MAX_BYTES];
+	/* Uncompressed length */
+	size_t len;
+	uint32_t count;
+	/* Reception time of the oldest message in ms of uptime */
+	int64_t oldest;
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+	/* Compresses the messages into buf while they are added */
+	struct lzss_encoder lzss;
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+};
+
+/* Start and end of a CBOR indefinite-length array */
+#define CBOR_ARRAY_INDEFINITE 0x9f
+#define CBOR_BREAK 0xff
+
+static struct batch sensor_batch = {.topic = pub_topic};
+static struct batch gps_batch = {
+	.topic = gps_pub_topic,
+	.cbor = IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_CBOR),
+};
+
+static uint32_t batch_publishes;
+static uint32_t batch_records;
+static uint32_t batch_bytes;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+static uint32_t batch_raw_bytes;
+static uint64_t batch_compress_cycles;
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+
+static void batch_reset(struct batch *batch)
+{
+	batch->len = 0;
+	batch->count = 0;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+	lzss_encoder_init(&batch->lzss, (uint8_t *)batch->buf, sizeof(batch->buf));
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+}
+
+/* Returns true if len more bytes and the closing bracket fit into the batch */
+static bool batch_fits(struct batch *batch, size_t len)
+{
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+	return lzss_encoder_bound(&batch->lzss, len + 1) <= sizeof(batch->buf);
+#else
+	return batch->len + len + 1 <= sizeof(batch->buf);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+}
+
+/* Appends data to the batch, the caller checks that it fits */
+static void batch_write(struct batch *batch, const void *data, size_t len)
+{
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+	uint32_t start = k_cycle_get_32();
+
+	lzss_encoder_write(&batch->lzss, data, len);
+	batch_compress_cycles += k_cycle_get_32() - start;
+#else
+	memcpy(&batch->buf[batch->len], data, len);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+	batch->len += len;
+}
+
+static void batch_flush(struct batch *batch)
+{
+	char close = batch->cbor ? CBOR_BREAK : ']';
+	int len;
+
+	if (batch->count == 0)
+	{
+		return;
+	}
+
+	batch_write(batch, &close, 1);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+	uint32_t start = k_cycle_get_32();
+
+	len = lzss_encoder_finish(&batch->lzss);
+	batch_compress_cycles += k_cycle_get_32() - start;
+	if (len < 0)
+	{
+		LOG_WRN("lzss_encoder_finish, error: %d", len);
+		batch_reset(batch);
+		return;
+	}
+
+	batch_raw_bytes += batch->len;
+#else
+	len = batch->len;
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+
+	publish_data(batch->buf, len, batch->topic);
+
+	batch_publishes++;
+	batch_records += batch->count;
+	batch_bytes += len;
+
+	LOG_DBG("Published batch of %d messages, %d bytes, on average %d messages per publish, "
+			"%d bytes per message",
+			batch->count, len, batch_records / batch_publishes,
+			batch_bytes / batch_records);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS)
+	LOG_DBG("Compressed %d to %d bytes, on average to %d%% in %d cycles per KB", (int)batch->len,
+			len, (int)((uint64_t)batch_bytes * 100 / batch_raw_bytes),
+			(int)(batch_compress_cycles * 1024 / batch_raw_bytes));
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_COMPRESS */
+
+	batch_reset(batch);
+}
+
+/* Adds one JSON or CBOR message received at timestamp, in hardware cycles, to the batch */
+static void batch_add(struct batch *batch, const char *record, size_t len, uint64_t timestamp)
+{
+	int64_t received = k_cyc_to_ms_floor64(timestamp);
+
+	/* Room for the separator or opening bracket */
+	if (!batch_fits(batch, 1 + len))
+	{
+		batch_flush(batch);
+	}
+
+	if (!batch_fits(batch, 1 + len))
+	{
+		LOG_WRN("Message of %d bytes does not fit into a batch", len);
+		publish_data(record, len, batch->topic);
+		return;
+	}
+
+	if (batch->cbor)
+	{
+		/* Items of an indefinite-length array need no separator */
+		if (batch->count == 0)
+		{
+			char open = CBOR_ARRAY_INDEFINITE;
+
+			batch_write(batch, &open, 1);
+		}
+	}
+	else
+	{
+		batch_write(batch, (batch->count == 0) ? "[" : ",", 1);
+	}
+	batch_write(batch, record, len);
+
+	if ((batch->count == 0) || (received < batch->oldest))
+	{
+		batch->oldest = received;
+	}
+	batch->count++;
+
+	if (batch->count >= CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_MAX_COUNT)
+	{
+		batch_flush(batch);
+	}
+}
+
+/* Publishes the batch if its oldest message has reached the maximum age. Returns the time in ms
+ * until it does, or -1 if the batch is empty.
+ */
+static int64_t batch_age_check(struct batch *batch)
+{
+	int64_t remaining;
+
+	if (batch->count == 0)
+	{
+		return -1;
+	}
+
+	remaining = batch->oldest + CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_MAX_AGE_MS - k_uptime_get();
+	if (remaining <= 0)
+	{
+		batch_flush(batch);
+		return -1;
+	}
+
+	return remaining;
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK)
+
+/* GPS fixes collected into a delta encoded track, see gps_track.h */
+static uint8_t track_buf[CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK_MAX_BYTES];
+static struct gps_track_encoder track;
+/* Reception time of the first fix in ms of uptime */
+static int64_t track_started;
+
+static uint32_t track_publishes;
+static uint32_t track_fixes;
+static uint32_t track_bytes;
+
+static void track_flush(void)
+{
+	if (track.count == 0)
+	{
+		return;
+	}
+
+	publish_data((const char *)track.buf, track.len, gps_pub_topic);
+
+	track_publishes++;
+	track_fixes += track.count;
+	track_bytes += track.len;
+
+	LOG_DBG("Published track of %d fixes, %d bytes, on average %d fixes per publish, "
+			"%d bytes per fix",
+			track.count, (int)track.len, track_fixes / track_publishes,
+			track_bytes / track_fixes);
+
+	gps_track_encoder_init(&track, track_buf, sizeof(track_buf));
+}
+
+/* Appends a fix to the track, publishing the track first if the fix does not fit. Returns the
+ * number of bytes the fix takes in the track or a negative error code.
+ */
+static int track_add(const struct velopera_gps_data *gps_data)
+{
+	struct gps_track_fix fix;
+	size_t len = track.len;
+	int err;
+
+	gps_track_fix_from_pvt(&gps_data->pvt, &fix);
+
+	err = gps_track_encoder_add(&track, &fix);
+	if (err == -ENOMEM)
+	{
+		track_flush();
+		len = track.len;
+		err = gps_track_encoder_add(&track, &fix);
+	}
+
+	if (err)
+	{
+		return err;
+	}
+
+	if (track.count == 1)
+	{
+		track_started = k_cyc_to_ms_floor64(gps_data->timestamp);
+	}
+
+	return track.len - len;
+}
+
+/* Publishes the track if its first fix has reached the maximum age. Returns the time in ms until
+ * it does, or -1 if the track is empty.
+ */
+static int64_t track_age_check(void)
+{
+	int64_t remaining;
+
+	if (track.count == 0)
+	{
+		return -1;
+	}
+
+	remaining = track_started + CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK_MAX_AGE_S * MSEC_PER_SEC -
+				k_uptime_get();
+	if (remaining <= 0)
+	{
+		track_flush();
+		return -1;
+	}
+
+	return remaining;
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+
+/* One block per signal, compacted into one message when published */
+static uint8_t series_buf[NINA_SIGNAL_COUNT][CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES_BLOCK_BYTES];
+static struct ts_block series[NINA_SIGNAL_COUNT];
+/* Reception time of the first sample in ms of uptime */
+static int64_t series_started;
+static uint32_t series_pending;
+
+static uint32_t series_publishes;
+static uint32_t series_samples;
+static uint32_t series_bytes;
+
+static void series_reset(void)
+{
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		ts_block_init(&series[i], i, series_buf[i], sizeof(series_buf[i]));
+	}
+
+	series_pending = 0;
+}
+
+static void series_flush(void)
+{
+	uint8_t *msg = &series_buf[0][0];
+	size_t len = 0;
+
+	if (series_pending == 0)
+	{
+		return;
+	}
+
+	/* Blocks are moved to the front, a block never starts before its position in msg */
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		size_t block_len;
+
+		if (series[i].count == 0)
+		{
+			continue;
+		}
+
+		block_len = ts_block_flush(&series[i]);
+		memmove(&msg[len], series_buf[i], block_len);
+		len += block_len;
+	}
+
+	publish_data((const char *)msg, len, ts_pub_topic);
+
+	series_publishes++;
+	series_samples += series_pending;
+	series_bytes += len;
+
+	LOG_DBG("Published %d samples in %d bytes, on average %d samples per publish, "
+			"%d.%02d bits per sample",
+			series_pending, (int)len, series_samples / series_publishes,
+			(int)((uint64_t)series_bytes * 8 / series_samples),
+			(int)((uint64_t)series_bytes * 800 / series_samples % 100));
+
+	series_reset();
+}
+
+/* Appends every signal of a Nina message to its series. All blocks are published once one of
+ * them is full, so that they cover the same time span.
+ */
+static void series_add(const struct velopera_nina_data *data)
+{
+	int64_t time = k_cyc_to_ms_floor64(data->timestamp);
+
+	for (int i = 0; i < NINA_SIGNAL_COUNT; i++)
+	{
+		int err;
+
+		if (!(data->present & BIT(i)))
+		{
+			continue;
+		}
+
+		err = ts_block_append(&series[i], time, data->value[i]);
+		if (err)
+		{
+			/* Full, or too far from the previous sample */
+			series_flush();
+			err = ts_block_append(&series[i], time, data->value[i]);
+		}
+
+		if (err)
+		{
+			LOG_WRN("ts_block_append, error: %d", err);
+			continue;
+		}
+
+		if (series_pending++ == 0)
+		{
+			series_started = time;
+		}
+	}
+}
+
+/* Publishes the series if the first sample has reached the maximum age. Returns the time in ms
+ * until it does, or -1 if there are no samples.
+ */
+static int64_t series_age_check(void)
+{
+	int64_t remaining;
+
+	if (series_pending == 0)
+	{
+		return -1;
+	}
+
+	remaining = series_started + CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES_MAX_AGE_S * MSEC_PER_SEC -
+				k_uptime_get();
+	if (remaining <= 0)
+	{
+		series_flush();
+		return -1;
+	}
+
+	return remaining;
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
+
+/* Returns the earlier of two times in ms, -1 meaning never */
+static int64_t remaining_min(int64_t a, int64_t b)
+{
+	if ((a < 0) || (b < 0))
+	{
+		return MAX(a, b);
+	}
+
+	return MIN(a, b);
+}
+
+/* Sends messages without PUBACK again, publishes expired batches, tracks and series, sends
+ * stored messages and schedules mqtt_pub_work for the next one to expire.
+ */
+static void pub_age_check(void)
+{
+	int64_t remaining = -1;
+
+	remaining = remaining_min(remaining, inflight_process(atomic_get(&mqtt_connected)));
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH)
+	remaining = remaining_min(remaining, batch_age_check(&sensor_batch));
+	remaining = remaining_min(remaining, batch_age_check(&gps_batch));
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK)
+	remaining = remaining_min(remaining, track_age_check());
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+	remaining = remaining_min(remaining, series_age_check());
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+	/* Last, expired batches, tracks and series are stored while offline */
+	remaining = remaining_min(remaining, store_process(atomic_get(&mqtt_connected)));
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+
+	if (remaining >= 0)
+	{
+		k_work_reschedule_for_queue(&transport_queue, &mqtt_pub_work, K_MSEC(remaining));
+	}
+}
+
+/* Leaves messages in the queues while the window is full, the queue status throttles the
+ * trigger module. Without the store they also stay there while offline, mqtt_pub_work runs
+ * again once connected.
+ */
+static bool pub_blocked(void)
+{
+	if (!atomic_get(&mqtt_connected))
+	{
+		return !IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE);
+	}
+
+	return inflight_full();
+}
+
+static int modify_login_info_msg(char *msg, size_t msg_size)
+{
+
+	struct modem_param_info modem_param;
+
+	int err = modem_info_init();
+	if (err)
+	{
+		LOG_ERR("Failed to initialize modem info: %d", err);
+	}
+
+	err = modem_info_params_init(&modem_param);
+	if (err)
+	{
+		LOG_ERR("Failed to initialize modem info: %d", err);
+	}
+
+	err = modem_info_params_get(&modem_param);
+	if (err)
+	{
+		LOG_ERR("Failed to initialize modem info: %d", err);
+	}
+
+	LOG_DBG("====== modify_login_info_msg ======");
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR)
+	struct cbor_login_info login = {
+		.network_status = "online",
+		.rsrp = modem_param.network.rsrp.value,
+		.iccid = modem_param.sim.iccid.value_string,
+		.mcc = modem_param.network.mcc.value,
+		.mnc = modem_param.network.mnc.value_string,
+		.cell_id = modem_param.network.cellid_hex.value_string,
+		.band = modem_param.network.current_band.value,
+		.area_code = modem_param.network.area_code.value_string,
+		.op = modem_param.network.current_operator.value_string,
+		.modem = modem_param.device.modem_fw.value_string,
+		.firmware = getFirmwareVersion()->full,
+	};
+
+	err = cbor_login_encode(&login, (uint8_t *)msg, msg_size);
+	if (err < 0)
+	{
+		LOG_ERR("cbor_login_encode %d", err);
+	}
+
+	LOG_DBG("msg (CBOR): %d bytes", err);
+#else
+	err = snprintf(msg, msg_size, "{\"networkStatus\":\"online\",\"rsrp\":%d,\"iccid\":\"%s\",\"mcc\":\"%x\",\"mnc\":\"%s\",\"cid\":\"%s\",\"band\":\"%d\",\"areaCode\":\"%s\",\"op\":\"%s\",\"modem\":\"%s\",\"fw\":\"%s\"}",
+				   modem_param.network.rsrp.value, modem_param.sim.iccid.value_string,
+				   modem_param.network.mcc.value, modem_param.network.mnc.value_string,
+				   modem_param.network.cellid_hex.value_string, modem_param.network.current_band.value,
+				   modem_param.network.area_code.value_string, modem_param.network.current_operator.value_string,
+				   modem_param.device.modem_fw.value_string, getFirmwareVersion()->full);
+
+	if (err < 0)
+	{
+		LOG_ERR("snprintf %d", err);
+	}
+
+	// LOG_INF("IP Address: %s", modem_param.network.ip_address.value_string);
+
+	LOG_DBG("msg (JSON): %s, size %d", msg, err);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR */
+	LOG_DBG("===============================");
+	return err;
+}
+
+/* Callback handlers from MQTT helper library.
+ * The functions are called whenever specific MQTT packets are received from the broker, or
+ * some library state has changed.
+ */
+static void on_mqtt_connack(enum mqtt_conn_return_code return_code)
+{
+	ARG_UNUSED(return_code);
+
+	smf_set_state(SMF_CTX(&s_obj), &state[MQTT_CONNECTED]);
+}
+
+static void on_mqtt_disconnect(int result)
+{
+	ARG_UNUSED(result);
+
+	smf_set_state(SMF_CTX(&s_obj), &state[MQTT_DISCONNECTED]);
+}
+
+static void on_mqtt_publish(struct dynsec_mqtt_helper_buf topic, struct dynsec_mqtt_helper_buf payload)
+{
+	LOG_INF("Received payload: %.*s on topic: %.*s", payload.size,
+			payload.ptr,
+			topic.size,
+			topic.ptr);
+
+	if (strncmp(topic.ptr, fota_sub_topic, sizeof(fota_sub_topic)) == 0)
+	{
+		LOG_DBG("FOTA request received for firmware %s", payload.ptr);
+
+		int err = zbus_chan_pub(&FOTA_CHAN, &payload, K_SECONDS(1));
+		if (err)
+		{
+			LOG_ERR("zbus_chan_pub, error: %d", err);
+			SEND_FATAL_ERROR();
+		}
+
+		LOG_DBG("FOTA request redirected to FOTA_CHAN");
+	}
+}
+
+static void on_mqtt_puback(uint16_t message_id, int result)
+{
+	if (result)
+	{
+		LOG_WRN("Publish failed, id: %d, error: %d", message_id, result);
+		return;
+	}
+
+	if (inflight_puback(message_id))
+	{
+		/* The window has room again */
+		k_work_reschedule_for_queue(&transport_queue, &mqtt_pub_work, K_NO_WAIT);
+	}
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+	else if (store_puback(message_id))
+	{
+		/* Send the next stored chunk */
+		k_work_reschedule_for_queue(&transport_queue, &mqtt_pub_work, K_NO_WAIT);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+}
+
+static void on_mqtt_suback(uint16_t message_id, int result)
+{
+	if ((message_id == SUBSCRIBE_TOPIC_ID) && (result == 0))
+	{
+		LOG_INF("Subscribed to topic %s and topic %s", fota_sub_topic, psk_sub_topic);
+	}
+	else if (result)
+	{
+		LOG_ERR("Topic subscription failed, error: %d", result);
+	}
+	else
+	{
+		LOG_WRN("Subscribed to unknown topic, id: %d", message_id);
+	}
+}
+
+/* Local convenience functions */
+
+/* Function that prefixes topics with the Client ID. */
+static int topics_prefix(void)
+{
+	int len;
+
+	len = snprintk(pub_topic, sizeof(pub_topic), "ind/%s/%s", imei,
+				   CONFIG_MQTT_SAMPLE_TRANSPORT_PUBLISH_TOPIC);
+	if ((len < 0) || (len >= sizeof(pub_topic)))
+	{
+		LOG_ERR("Publish topic buffer too small");
+		return -EMSGSIZE;
+	}
+
+	len = snprintk(gps_pub_topic, sizeof(gps_pub_topic), "ind/%s/gps%s", imei,
+				   IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_CBOR)	? "/cbor"
+				   : IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK) ? "/track"
+																		: "");
+	if ((len < 0) || (len >= sizeof(pub_topic)))
+	{
+		LOG_ERR("Publish topic buffer too small");
+		return -EMSGSIZE;
+	}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+	len = snprintk(ts_pub_topic, sizeof(ts_pub_topic), "ind/%s/ts", imei);
+	if ((len < 0) || (len >= sizeof(ts_pub_topic)))
+	{
+		LOG_ERR("Publish topic buffer too small");
+		return -EMSGSIZE;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
+
+	len = snprintk(fota_sub_topic, sizeof(fota_sub_topic), "cmd/%s/%s", imei,
+				   "fota");
+
+	if ((len < 0) || (len >= sizeof(fota_sub_topic)))
+	{
+		LOG_ERR("Subscribe topic buffer too small %d", __LINE__);
+		return -EMSGSIZE;
+	}
+	len = snprintk(psk_sub_topic, sizeof(psk_sub_topic), "cmd/%s/%s", imei,
+				   "psk");
+
+	if ((len < 0) || (len >= sizeof(psk_sub_topic)))
+	{
+		LOG_ERR("Subscribe topic buffer too small %d", __LINE__);
+		return -EMSGSIZE;
+	}
+
+	return 0;
+}
+
+static void subscribe(void)
+{
+	int err;
+	struct mqtt_topic topics[] = {
+		{
+			.topic.utf8 = fota_sub_topic,
+			.topic.size = strlen(fota_sub_topic),
+		},
+		{
+			.topic.utf8 = psk_sub_topic,
+			.topic.size = strlen(psk_sub_topic),
+		},
+	};
+	struct mqtt_subscription_list list = {
+		.list = topics,
+		.list_count = ARRAY_SIZE(topics),
+		.message_id = SUBSCRIBE_TOPIC_ID,
+	};
+
+	for (size_t i = 0; i < list.list_count; i++)
+	{
+		LOG_INF("Subscribing to: %s", (char *)list.list[i].topic.utf8);
+	}
+
+	err = dynsec_mqtt_helper_subscribe(&list);
+	if (err)
+	{
+		LOG_ERR("Failed to subscribe to topics, error: %d", err);
+		return;
+	}
+}
+
+/* Connect work - Used to establish a connection to the MQTT broker and schedule reconnection
+ * attempts.
+ */
+static void connect_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	int err;
+	struct dynsec_mqtt_helper_conn_params conn_params = {
+		.hostname.ptr = CONFIG_MQTT_SAMPLE_TRANSPORT_BROKER_HOSTNAME,
+		.hostname.size = strlen(CONFIG_MQTT_SAMPLE_TRANSPORT_BROKER_HOSTNAME),
+		.user_name.ptr = imei,
+		.user_name.size = strlen(imei),
+		.device_id.ptr = imei,
+		.device_id.size = strlen(imei),
+		.password.ptr = imei, // TODO: for now!
+		.password.size = strlen(imei),
+		.last_will_message.ptr = "{\"networkStatus\":\"offline\"}",
+		.last_will_message.size = strlen("{\"networkStatus\":\"offline\"}"),
+	};
+	err = snprintf(login_topic, sizeof(login_topic), "ind/%s/login", imei);
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR)
+	err = snprintf(login_cbor_topic, sizeof(login_cbor_topic), "%s/cbor", login_topic);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR */
+	err = topics_prefix();
+	if (err)
+	{
+		LOG_ERR("topics_prefix, error: %d", err);
+		SEND_FATAL_ERROR();
+		return;
+	}
+	conn_params.last_will_topic.ptr = login_topic;
+	conn_params.last_will_topic.size = strlen(login_topic);
+	err = dynsec_mqtt_helper_connect(&conn_params);
+	if (err)
+	{
+		LOG_ERR("Failed connecting to MQTT, error code: %d", err);
+	}
+
+	k_work_reschedule_for_queue(&transport_queue, &connect_work,
+								K_SECONDS(CONFIG_MQTT_SAMPLE_TRANSPORT_RECONNECTION_TIMEOUT_SECONDS));
+}
+/* Publishes the fill level of the sensor data queue, the trigger module throttles the Nina link
+ * based on it.
+ */
+static void queue_status_publish(void)
+{
+	struct velopera_queue_status status = {
+		.used = txqueue_bytes_get(&sensor_data_queue),
+		.capacity = txqueue_capacity_get(&sensor_data_queue),
+	};
+	int err;
+
+	err = zbus_chan_pub(&QUEUE_STATUS_CHAN, &status, K_NO_WAIT);
+	if (err)
+	{
+		LOG_WRN("zbus_chan_pub, error: %d", err);
+	}
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+/* Moves messages received while offline into the store before the queues overflow */
+static void store_schedule(void)
+{
+	if (!atomic_get(&mqtt_connected))
+	{
+		k_work_reschedule_for_queue(&transport_queue, &mqtt_pub_work, K_NO_WAIT);
+	}
+}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+
+/* Splits a k_cycle_get_64() timestamp into seconds and microseconds of uptime */
+#define TIMESTAMP_SECONDS(cyc) ((uint32_t)(k_cyc_to_us_floor64(cyc) / USEC_PER_SEC))
+#define TIMESTAMP_MICROSECONDS(cyc) ((uint32_t)(k_cyc_to_us_floor64(cyc) % USEC_PER_SEC))
+
+/* Adds the reception timestamp of a Nina line as "uptime" member to its JSON object. Lines that
+ * are not an object or have no room left are published unchanged.
+ */
+static void payload_timestamp_add(struct net_buf *buf, uint64_t timestamp)
+{
+	char member[32];
+
+	snprintf(member, sizeof(member), "\"uptime\":%u.%06u", TIMESTAMP_SECONDS(timestamp),
+			 TIMESTAMP_MICROSECONDS(timestamp));
+
+	if (payload_buf_member_add(buf, member) == -ENOMEM)
+	{
+		LOG_WRN("No room for the timestamp in payload");
+	}
+}
+
+/* Timestamps a Nina line and queues it as sensor record, the NUL terminated line followed by its
+ * reception timestamp
+ */
+static int sensor_put(struct txqueue *queue, struct net_buf *buf)
+{
+	uint64_t timestamp = payload_buf_timestamp(buf);
+	uint8_t *record;
+
+	payload_timestamp_add(buf, timestamp);
+
+	record = txqueue_alloc(queue, buf->len + 1 + sizeof(timestamp));
+	if (record == NULL)
+	{
+		return -ENOMSG;
+	}
+
+	memcpy(record, buf->data, buf->len + 1);
+	memcpy(&record[buf->len + 1], &timestamp, sizeof(timestamp));
+	txqueue_commit(queue, record);
+
+	return 0;
+}
+
+/* Takes a sensor record without copying it, to be returned by txqueue_free() once published.
+ * Returns the line, or NULL if the queue is empty.
+ */
+static const char *sensor_take(struct txqueue *queue, uint64_t *timestamp)
+{
+	size_t len;
+	uint8_t *record = txqueue_take(queue, &len);
+
+	if (record == NULL)
+	{
+		return NULL;
+	}
+
+	memcpy(timestamp, &record[len - sizeof(*timestamp)], sizeof(*timestamp));
+
+	return (const char *)record;
+}
+
+/* Merges two sensor records into one with a JSON array of both lines, each keeping its "uptime"
+ * member, and the timestamp of the newer one. Lines may start with '[' themselves, aggregates are
+ * told apart by the flag of their record.
+ */
+static size_t sensor_merge(const void *older, size_t older_len, bool older_aggregate,
+						   const void *newer, size_t newer_len, bool newer_aggregate,
+						   const void **merged)
+{
+	static char buf[sizeof(struct velopera_payload)];
+	const char *a = older;
+	const char *b = newer;
+	size_t a_len = older_len - sizeof(uint64_t) - 1;
+	size_t b_len = newer_len - sizeof(uint64_t) - 1;
+	size_t len = 0;
+
+	/* At most the brackets and the separator are added */
+	if (a_len + b_len + 3 >= sizeof(((struct velopera_payload *)0)->string))
+	{
+		return 0;
+	}
+
+	/* "[a" of a line, "[a,...,x" of a merged one without its closing bracket */
+	if (older_aggregate)
+	{
+		memcpy(buf, a, a_len - 1);
+		len = a_len - 1;
+	}
+	else
+	{
+		buf[len++] = '[';
+		memcpy(&buf[len], a, a_len);
+		len += a_len;
+	}
+
+	buf[len++] = ',';
+
+	/* "b]" of a line, "y,...,b]" of a merged one */
+	if (newer_aggregate)
+	{
+		memcpy(&buf[len], &b[1], b_len - 1);
+		len += b_len - 1;
+	}
+	else
+	{
+		memcpy(&buf[len], b, b_len);
+		len += b_len;
+		buf[len++] = ']';
+	}
+
+	buf[len++] = '\0';
+	memcpy(&buf[len], &b[newer_len - sizeof(uint64_t)], sizeof(uint64_t));
+	len += sizeof(uint64_t);
+
+	*merged = buf;
+
+	return len;
+}
+
+static void gps_encoded_add(int len, uint32_t start)
+{
+	gps_encode_cycles += k_cycle_get_32() - start;
+	gps_encode_bytes += len;
+	gps_encoded++;
+
+	LOG_DBG("GPS fix encoded in %d bytes, on average %d bytes and %d cycles",
+			len, gps_encode_bytes / gps_encoded, gps_encode_cycles / gps_encoded);
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK)
+
+/* Adds a GPS fix to the track, publishing the track once it is full */
+static void gps_publish(const struct velopera_gps_data *gps_data)
+{
+	uint32_t start = k_cycle_get_32();
+	int len = track_add(gps_data);
+
+	if (len < 0)
+	{
+		LOG_WRN("track_add, error: %d", len);
+		return;
+	}
+
+	gps_encoded_add(len, start);
+
+	if (track.count >= CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK_MAX_FIXES)
+	{
+		track_flush();
+	}
+}
+
+#else
+
+/* Encoded GPS fix, only used by the transport work queue. The fix is already taken from its
+ * queue, so it is not encoded into a buffer of the payload pool that could be full.
+ */
+static char gps_payload[PAYLOAD_BUF_LINE_MAX + 1];
+
+/* Encodes a GPS fix and adds it to the batch, or publishes it */
+static void gps_publish(const struct velopera_gps_data *gps_data)
+{
+	uint32_t start = k_cycle_get_32();
+	int len;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_CBOR)
+	len = cbor_gps_encode(gps_data, (uint8_t *)gps_payload, sizeof(gps_payload));
+	if (len < 0)
+	{
+		LOG_WRN("cbor_gps_encode, error: %d", len);
+		return;
+	}
+#else
+	len = gnss_json_format(gps_data, gps_payload, sizeof(gps_payload));
+	if (len < 0)
+	{
+		LOG_WRN("gnss_json_format, error: %d", len);
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_CBOR */
+
+	gps_encoded_add(len, start);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_JSON)
+	LOG_DBG("GPS fix: %.*s", len, gps_payload);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_JSON */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH)
+	batch_add(&gps_batch, gps_payload, len, gps_data->timestamp);
+#else
+	publish_data(gps_payload, len, gps_pub_topic);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH */
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK */
+
+/* Adds a timestamped Nina line to the batch, or publishes it. Urgent lines skip the batch. */
+static void sensor_publish(const char *line, uint64_t timestamp, bool urgent)
+{
+	LOG_DBG("Line: %s", line);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH)
+	if (!urgent)
+	{
+		batch_add(&sensor_batch, line, strlen(line), timestamp);
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH */
+
+	publish_data(line, strlen(line), pub_topic);
+}
+
+/* Reports the records of a queue that expired before they could be sent */
+static void expired_report(struct txqueue *queue, const char *stream)
+{
+	int64_t oldest;
+	int64_t newest;
+	uint32_t expired = txqueue_expired_take(queue, &oldest, &newest);
+
+	if (expired == 0)
+	{
+		return;
+	}
+
+	LOG_DBG("%d %s records expired, enqueued from %d to %d ms", expired, stream, (int)oldest,
+			(int)newest);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_EXPIRED_SUMMARY)
+	char summary[96];
+	int len;
+
+	len = snprintf(summary, sizeof(summary),
+				   "{\"stream\":\"%s\",\"expired\":%u,\"oldest\":%u.%03u,\"newest\":%u.%03u}",
+				   stream, expired, (uint32_t)(oldest / MSEC_PER_SEC),
+				   (uint32_t)(oldest % MSEC_PER_SEC), (uint32_t)(newest / MSEC_PER_SEC),
+				   (uint32_t)(newest % MSEC_PER_SEC));
+
+	publish_data(summary, len, pub_topic);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_EXPIRED_SUMMARY */
 }
 
-static int modify_login_info_msg(char *msg, size_t msg_size)
+#if defined(CONFIG_SHELL)
+static void shell_overflow_print(const struct shell *shell, const char *stream,
+								 const struct txqueue *queue)
 {
+	shell_print(shell, "%-6s %-11s: %d drop-newest, %d drop-oldest, %d decimate, %d merge",
+				stream, txqueue_overflow_name(queue->overflow),
+				queue->overflows[TXQUEUE_DROP_NEWEST], queue->overflows[TXQUEUE_DROP_OLDEST],
+				queue->overflows[TXQUEUE_DECIMATE], queue->overflows[TXQUEUE_MERGE]);
+}
 
-	struct modem_param_info modem_param;
+/**
+ * @brief This callback function prints the overflow policies and counters of the queues, or
+ *        sets the policy of one queue
+ *
+ * @param shell
+ * @param argc
+ * @param argv
+ * @return int
+ */
+static int shell_overflow(const struct shell *shell, size_t argc, char **argv)
+{
+	struct txqueue *queue;
+	int overflow;
 
-	int err = modem_info_init();
-	if (err)
+	if (argc == 1)
 	{
-		LOG_ERR("Failed to initialize modem info: %d", err);
+		shell_overflow_print(shell, "gps", &gps_data_queue);
+		shell_overflow_print(shell, "sensor", &sensor_data_queue);
+		return 0;
 	}
 
-	err = modem_info_params_init(&modem_param);
-	if (err)
+	if (argc != 3)
 	{
-		LOG_ERR("Failed to initialize modem info: %d", err);
+		shell_print(shell, "Usage: overflow [gps|sensor drop-newest|drop-oldest|decimate|merge]");
+		return -EINVAL;
 	}
 
-	err = modem_info_params_get(&modem_param);
-	if (err)
+	if (strcmp(argv[1], "gps") == 0)
 	{
-		LOG_ERR("Failed to initialize modem info: %d", err);
+		queue = &gps_data_queue;
+	}
+	else if (strcmp(argv[1], "sensor") == 0)
+	{
+		queue = &sensor_data_queue;
+	}
+	else
+	{
+		shell_print(shell, "Unknown queue %s", argv[1]);
+		return -EINVAL;
 	}
 
-	LOG_DBG("====== modify_login_info_msg ======");
-	err = snprintf(msg, msg_size, "{\"networkStatus\":\"online\",\"rsrp\":%d,\"iccid\":\"%s\",\"mcc\":\"%x\",\"mnc\":\"%s\",\"cid\":\"%s\",\"band\":\"%d\",\"areaCode\":\"%s\",\"op\":\"%s\",\"modem\":\"%s\",\"fw\":\"%s\"}",
-				   modem_param.network.rsrp.value, modem_param.sim.iccid.value_string,
-				   modem_param.network.mcc.value, modem_param.network.mnc.value_string,
-				   modem_param.network.cellid_hex.value_string, modem_param.network.current_band.value,
-				   modem_param.network.area_code.value_string, modem_param.network.current_operator.value_string,
-				   modem_param.device.modem_fw.value_string, getFirmwareVersion()->full);
-
-	if (err < 0)
+	overflow = txqueue_overflow_parse(argv[2]);
+	if (overflow < 0)
 	{
-		LOG_ERR("snprintf %d", err);
+		shell_print(shell, "Unknown overflow policy %s", argv[2]);
+		return overflow;
 	}
 
-	// LOG_INF("IP Address: %s", modem_param.network.ip_address.value_string);
+	txqueue_overflow_set(queue, overflow);
 
-	LOG_DBG("msg (JSON): %s, size %d", msg, err);
-	LOG_DBG("===============================");
-	return err;
+	return 0;
 }
 
-/* Callback handlers from MQTT helper library.
- * The functions are called whenever specific MQTT packets are received from the broker, or
- * some library state has changed.
- */
-static void on_mqtt_connack(enum mqtt_conn_return_code return_code)
-{
-	ARG_UNUSED(return_code);
+/* Register shell_overflow callback function as root command */
+SHELL_CMD_REGISTER(overflow, NULL, "Transport queue overflow policies", shell_overflow);
 
-	smf_set_state(SMF_CTX(&s_obj), &state[MQTT_CONNECTED]);
+static void shell_queue_print(const struct shell *shell, const char *stream,
+							  struct txqueue *queue)
+{
+	shell_print(shell, "%-7s %3d records %5zu bytes, high water %3d records %5zu bytes, "
+					   "quota %zu-%zu",
+				stream, txqueue_num_used_get(queue), txqueue_bytes_get(queue),
+				queue->used_high_water, queue->bytes_high_water, queue->min_bytes,
+				queue->max_bytes);
 }
 
-static void on_mqtt_disconnect(int result)
+/**
+ * @brief This callback function prints the depth and high water marks of the queues and their
+ *        pool
+ *
+ * @param shell
+ * @param argc
+ * @param argv
+ * @return int
+ */
+static int shell_queues(const struct shell *shell, size_t argc, char **argv)
 {
-	ARG_UNUSED(result);
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_queue_print(shell, "gps", &gps_data_queue);
+	shell_queue_print(shell, "sensor", &sensor_data_queue);
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+	shell_queue_print(shell, "control", &control_data_queue);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+	shell_print(shell, "pool    %zu of %zu bytes used, high water %zu bytes, %d fragmented",
+				queue_pool.used, queue_pool.size, queue_pool.high_water, queue_pool.fragmented);
+	shell_print(shell, "RAM     %zu bytes, the fixed queues took %zu bytes",
+				(size_t)TXQUEUE_HEAP_SIZE(CONFIG_MQTT_SAMPLE_TRANSPORT_POOL_SIZE),
+				(size_t)FIXED_QUEUES_SIZE);
 
-	smf_set_state(SMF_CTX(&s_obj), &state[MQTT_DISCONNECTED]);
+	return 0;
 }
 
-static void on_mqtt_publish(struct dynsec_mqtt_helper_buf topic, struct dynsec_mqtt_helper_buf payload)
+/* Register shell_queues callback function as root command */
+SHELL_CMD_REGISTER(queues, NULL, "Transport queue depth and high water marks", shell_queues);
+#endif /* CONFIG_SHELL */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+
+/* Lanes in the order of their default priority */
+enum lane_id
 {
-	LOG_INF("Received payload: %.*s on topic: %.*s", payload.size,
-			payload.ptr,
-			topic.size,
-			topic.ptr);
+	LANE_CONTROL,
+	LANE_GPS,
+	LANE_BULK,
+	LANE_COUNT,
+};
 
-	if (strncmp(topic.ptr, fota_sub_topic, sizeof(fota_sub_topic)) == 0)
+struct lane
+{
+	const char *name;
+	struct txqueue *queue;
+	/* Lower priorities are served first within a round */
+	uint8_t priority;
+	/* Messages per round */
+	uint8_t weight;
+	/* Messages left in the current round */
+	uint8_t credit;
+
+	/* Time from reception to publishing, or to adding to a batch, track or series */
+	uint32_t sent;
+	uint64_t latency_ms;
+	uint32_t latency_max_ms;
+};
+
+static struct lane lanes[LANE_COUNT] = {
+	[LANE_CONTROL] = {
+		.name = "control",
+		.queue = &control_data_queue,
+		.priority = CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_CONTROL_PRIORITY,
+		.weight = CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_CONTROL_WEIGHT,
+	},
+	[LANE_GPS] = {
+		.name = "gps",
+		.queue = &gps_data_queue,
+		.priority = CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_GPS_PRIORITY,
+		.weight = CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_GPS_WEIGHT,
+	},
+	[LANE_BULK] = {
+		.name = "bulk",
+		.queue = &sensor_data_queue,
+		.priority = CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_BULK_PRIORITY,
+		.weight = CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_BULK_WEIGHT,
+	},
+};
+
+/* Lane ids sorted by priority */
+static uint8_t lane_order[LANE_COUNT];
+
+static void lanes_init(void)
+{
+	for (int i = 0; i < LANE_COUNT; i++)
 	{
-		LOG_DBG("FOTA request received for firmware %s", payload.ptr);
+		int j = i;
 
-		int err = zbus_chan_pub(&FOTA_CHAN, &payload, K_SECONDS(1));
-		if (err)
+		/* Insertion sort, equal priorities keep the order of enum lane_id */
+		for (; (j > 0) && (lanes[lane_order[j - 1]].priority > lanes[i].priority); j--)
 		{
-			LOG_ERR("zbus_chan_pub, error: %d", err);
-			SEND_FATAL_ERROR();
+			lane_order[j] = lane_order[j - 1];
 		}
 
-		LOG_DBG("FOTA request redirected to FOTA_CHAN");
+		lane_order[j] = i;
+		lanes[i].credit = lanes[i].weight;
 	}
 }
 
-static void on_mqtt_suback(uint16_t message_id, int result)
+/* Weighted round robin: every lane with messages sends up to its weight per round, in the order
+ * of priority. A round ends once no lane with messages has credit left, so every lane is served
+ * in every round and none starves.
+ */
+static struct lane *lane_next(void)
 {
-	if ((message_id == SUBSCRIBE_TOPIC_ID) && (result == 0))
-	{
-		LOG_INF("Subscribed to topic %s and topic %s", fota_sub_topic, psk_sub_topic);
-	}
-	else if (result)
-	{
-		LOG_ERR("Topic subscription failed, error: %d", result);
-	}
-	else
+	for (int round = 0; round < 2; round++)
 	{
-		LOG_WRN("Subscribed to unknown topic, id: %d", message_id);
+		for (int i = 0; i < LANE_COUNT; i++)
+		{
+			struct lane *lane = &lanes[lane_order[i]];
+
+			if ((lane->credit > 0) && (txqueue_num_used_get(lane->queue) > 0))
+			{
+				lane->credit--;
+				return lane;
+			}
+		}
+
+		for (int i = 0; i < LANE_COUNT; i++)
+		{
+			lanes[i].credit = lanes[i].weight;
+		}
 	}
+
+	return NULL;
 }
 
-/* Local convenience functions */
+static void lane_latency_add(struct lane *lane, uint64_t timestamp)
+{
+	uint32_t latency = k_cyc_to_ms_floor64(k_cycle_get_64() - timestamp);
 
-/* Function that prefixes topics with the Client ID. */
-static int topics_prefix(void)
+	lane->sent++;
+	lane->latency_ms += latency;
+	lane->latency_max_ms = MAX(lane->latency_max_ms, latency);
+}
+
+/* Publishes the queued messages of all lanes in the order of lane_next() */
+static void lanes_drain(void)
 {
-	int len;
+	struct velopera_gps_data gps;
+	const char *line;
+	uint64_t timestamp;
+	uint32_t sent[LANE_COUNT] = {0};
+	struct lane *lane;
 
-	len = snprintk(pub_topic, sizeof(pub_topic), "ind/%s/%s", imei,
-				   CONFIG_MQTT_SAMPLE_TRANSPORT_PUBLISH_TOPIC);
-	if ((len < 0) || (len >= sizeof(pub_topic)))
+	while (!pub_blocked() && ((lane = lane_next()) != NULL))
 	{
-		LOG_ERR("Publish topic buffer too small");
-		return -EMSGSIZE;
+		if (lane == &lanes[LANE_GPS])
+		{
+			if (txqueue_get(lane->queue, &gps, sizeof(gps)) < 0)
+			{
+				continue;
+			}
+
+			lane_latency_add(lane, gps.timestamp);
+			gps_publish(&gps);
+		}
+		else
+		{
+			line = sensor_take(lane->queue, &timestamp);
+			if (line == NULL)
+			{
+				continue;
+			}
+
+			lane_latency_add(lane, timestamp);
+			sensor_publish(line, timestamp, lane == &lanes[LANE_CONTROL]);
+			txqueue_free(lane->queue, (void *)line);
+		}
+
+		sent[lane - lanes]++;
 	}
 
-	len = snprintk(gps_pub_topic, sizeof(gps_pub_topic), "ind/%s/gps", imei);
-	if ((len < 0) || (len >= sizeof(pub_topic)))
+	for (int i = 0; i < LANE_COUNT; i++)
 	{
-		LOG_ERR("Publish topic buffer too small");
-		return -EMSGSIZE;
+		if (sent[i] == 0)
+		{
+			continue;
+		}
+
+		LOG_DBG("Lane %s: %d sent, %d in total, latency on average %d ms, max %d ms, %d queued",
+				lanes[i].name, sent[i], lanes[i].sent,
+				(int)(lanes[i].latency_ms / lanes[i].sent), lanes[i].latency_max_ms,
+				txqueue_num_used_get(lanes[i].queue));
 	}
+}
 
-	len = snprintk(fota_sub_topic, sizeof(fota_sub_topic), "cmd/%s/%s", imei,
-				   "fota");
+#if defined(CONFIG_SHELL)
+/**
+ * @brief This callback function prints the statistics of the transport lanes
+ *
+ * @param shell
+ * @param argc
+ * @param argv
+ * @return int
+ */
+static int shell_lanes(const struct shell *shell, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
 
-	if ((len < 0) || (len >= sizeof(fota_sub_topic)))
+	for (int i = 0; i < LANE_COUNT; i++)
 	{
-		LOG_ERR("Subscribe topic buffer too small %d", __LINE__);
-		return -EMSGSIZE;
-	}
-	len = snprintk(psk_sub_topic, sizeof(psk_sub_topic), "cmd/%s/%s", imei,
-				   "psk");
+		const struct lane *lane = &lanes[lane_order[i]];
 
-	if ((len < 0) || (len >= sizeof(psk_sub_topic)))
-	{
-		LOG_ERR("Subscribe topic buffer too small %d", __LINE__);
-		return -EMSGSIZE;
+		shell_print(shell, "%-8s priority %d weight %d: %d sent, latency avg %d ms max %d ms, "
+						   "%d queued",
+					lane->name, lane->priority, lane->weight, lane->sent,
+					lane->sent ? (int)(lane->latency_ms / lane->sent) : 0,
+					lane->latency_max_ms, txqueue_num_used_get(lane->queue));
 	}
 
 	return 0;
 }
 
-static void subscribe(void)
+/* Register shell_lanes callback function as root command */
+SHELL_CMD_REGISTER(lanes, NULL, "Transport lane statistics", shell_lanes);
+#endif /* CONFIG_SHELL */
+
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+
+void mqtt_pub_work_fn(struct k_work *work)
 {
-	int err;
-	struct mqtt_topic topics[] = {
-		{
-			.topic.utf8 = fota_sub_topic,
-			.topic.size = strlen(fota_sub_topic),
-		},
-		{
-			.topic.utf8 = psk_sub_topic,
-			.topic.size = strlen(psk_sub_topic),
-		},
-	};
-	struct mqtt_subscription_list list = {
-		.list = topics,
-		.list_count = ARRAY_SIZE(topics),
-		.message_id = SUBSCRIBE_TOPIC_ID,
-	};
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+	lanes_drain();
+#else
+	struct velopera_gps_data gps_data;
+	const char *line;
+	uint64_t timestamp;
 
-	for (size_t i = 0; i < list.list_count; i++)
+	while (!pub_blocked() && (txqueue_get(&gps_data_queue, &gps_data, sizeof(gps_data)) >= 0))
 	{
-		LOG_INF("Subscribing to: %s", (char *)list.list[i].topic.utf8);
+		gps_publish(&gps_data);
 	}
 
-	err = dynsec_mqtt_helper_subscribe(&list);
-	if (err)
+	while (!pub_blocked() && ((line = sensor_take(&sensor_data_queue, &timestamp)) != NULL))
 	{
-		LOG_ERR("Failed to subscribe to topics, error: %d", err);
-		return;
+		sensor_publish(line, timestamp, false);
+		txqueue_free(&sensor_data_queue, (void *)line);
 	}
-}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
 
-/* Connect work - Used to establish a connection to the MQTT broker and schedule reconnection
- * attempts.
- */
-static void connect_work_fn(struct k_work *work)
-{
-	ARG_UNUSED(work);
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+	struct velopera_nina_data nina_data;
 
-	int err;
-	struct dynsec_mqtt_helper_conn_params conn_params = {
-		.hostname.ptr = CONFIG_MQTT_SAMPLE_TRANSPORT_BROKER_HOSTNAME,
-		.hostname.size = strlen(CONFIG_MQTT_SAMPLE_TRANSPORT_BROKER_HOSTNAME),
-		.user_name.ptr = imei,
-		.user_name.size = strlen(imei),
-		.device_id.ptr = imei,
-		.device_id.size = strlen(imei),
-		.password.ptr = imei, // TODO: for now!
-		.password.size = strlen(imei),
-		.last_will_message.ptr = "{\"networkStatus\":\"offline\"}",
-		.last_will_message.size = strlen("{\"networkStatus\":\"offline\"}"),
-	};
-	err = snprintf(login_topic, sizeof(login_topic), "ind/%s/login", imei);
-	err = topics_prefix();
-	if (err)
+	while (k_msgq_get(&nina_data_queue, &nina_data, K_NO_WAIT) == 0)
 	{
-		LOG_ERR("topics_prefix, error: %d", err);
-		SEND_FATAL_ERROR();
-		return;
-	}
-	conn_params.last_will_topic.ptr = login_topic;
-	conn_params.last_will_topic.size = strlen(login_topic);
-	err = dynsec_mqtt_helper_connect(&conn_params);
-	if (err)
-	{
-		LOG_ERR("Failed connecting to MQTT, error code: %d", err);
+		series_add(&nina_data);
 	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
 
-	k_work_reschedule_for_queue(&transport_queue, &connect_work,
-								K_SECONDS(CONFIG_MQTT_SAMPLE_TRANSPORT_RECONNECTION_TIMEOUT_SECONDS));
-}
-void mqtt_pub_work_fn(struct k_work *work)
-{
-	struct velopera_gps_data gps_data;
-	struct velopera_payload payload;
-	int err;
-	printf("%d \r\n", __LINE__);
-	while (k_msgq_get(&gps_data_queue, &gps_data, K_NO_WAIT) == 0)
-	{
-		sprintf(payload.string, GNSS_DATA_JSON,
-				gps_data.pvt.latitude,
-				gps_data.pvt.longitude,
-				gps_data.pvt.altitude,
-				gps_data.pvt.accuracy,
-				gps_data.pvt.speed,
-				gps_data.pvt.speed_accuracy,
-				gps_data.pvt.heading,
-				gps_data.pvt.datetime.year,
-				gps_data.pvt.datetime.month,
-				gps_data.pvt.datetime.day,
-				gps_data.pvt.datetime.hour,
-				gps_data.pvt.datetime.minute,
-				gps_data.pvt.datetime.seconds,
-				gps_data.pvt.datetime.ms,
-				gps_data.pvt.pdop,
-				gps_data.pvt.hdop,
-				gps_data.pvt.vdop,
-				gps_data.pvt.tdop,
-				gps_data.meas_id);
-
-		printf("%s\n", payload.string);
-
-		publish(&payload, gps_pub_topic, sizeof(gps_pub_topic));
-		// int err = smf_run_state(SMF_CTX(&s_obj));
-		// if (err)
-		// {
-		// 	LOG_ERR("smf_run_state, error: %d", err);
-		// 	SEND_FATAL_ERROR();
-		// 	return;
-		// }
-	}
-	while (k_msgq_get(&sensor_data_queue, &payload, K_NO_WAIT) == 0)
-	{
-
-		printf("%s\n", payload.string);
-
-		s_obj.payload = payload;
-		s_obj.topic = pub_topic;
-		publish(&payload, pub_topic, sizeof(pub_topic));
-		// err = smf_run_state(SMF_CTX(&s_obj));
-		// if (err)
-		// {
-		// 	LOG_ERR("smf_run_state, error: %d", err);
-		// 	SEND_FATAL_ERROR();
-		// 	return;
-		// }
-	}
+	expired_report(&gps_data_queue, "gps");
+	expired_report(&sensor_data_queue, "sensor");
+
+	pub_age_check();
+
+	queue_status_publish();
 }
 /* Zephyr State Machine framework handlers */
 
@@ -413,7 +1676,12 @@ static void disconnected_run(void *o)
 		 * we cancel the connect work if it is onging.
 		 */
 		k_work_cancel_delayable(&connect_work);
-		k_work_cancel_delayable(&mqtt_pub_work);
+
+		/* Messages received while offline are moved into the store */
+		if (!IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE))
+		{
+			k_work_cancel_delayable(&mqtt_pub_work);
+		}
 	}
 
 	if ((user_object->status == NETWORK_CONNECTED) && (user_object->chan == &NETWORK_CHAN))
@@ -441,13 +1709,26 @@ static void connected_entry(void *o)
 	/* Cancel any ongoing connect work when we enter connected state */
 	k_work_cancel_delayable(&connect_work);
 
+	/* Messages not acknowledged on the previous connection are sent again */
+	inflight_restart();
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+	store_restart();
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+	atomic_set(&mqtt_connected, 1);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR)
+	if (login_msg_len > 0)
+	{
+		(void)publish_message(login_cbor_topic, login_msg.string, login_msg_len,
+							  inflight_message_id(), false);
+	}
+#else
 	publish(&login_msg, login_topic, 50);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LOGIN_CBOR */
 
 	subscribe();
-	printf("LINE %d\r\n", __LINE__);
 
 	k_work_submit_to_queue(&transport_queue, &mqtt_pub_work);
-	printf("LINE %d\r\n", __LINE__);
 }
 
 /* Function executed when the module is in the connected state. */
@@ -465,13 +1746,6 @@ static void connected_run(void *o)
 		return;
 	}
 	k_work_submit_to_queue(&transport_queue, &mqtt_pub_work);
-
-	if (user_object->chan != &MQTT_CHAN)
-	{
-		return;
-	}
-
-	publish(&user_object->payload, user_object->topic, sizeof(user_object->topic));
 }
 
 /* Function executed when the module exits the connected state. */
@@ -479,6 +1753,8 @@ static void connected_exit(void *o)
 {
 	ARG_UNUSED(o);
 
+	atomic_set(&mqtt_connected, 0);
+
 	LOG_INF("Disconnected from MQTT broker");
 }
 
@@ -488,6 +1764,33 @@ static const struct smf_state state[] = {
 	[MQTT_CONNECTED] = SMF_CREATE_STATE(connected_entry, connected_run, connected_exit),
 };
 
+/* Queues a line received on MQTT_CHAN, lines matching the control pattern on their own lane */
+static void line_queue(struct net_buf *buf)
+{
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+	if (strstr((const char *)buf->data, CONFIG_MQTT_SAMPLE_TRANSPORT_LANES_CONTROL_MATCH) != NULL)
+	{
+		if (sensor_put(&control_data_queue, buf) != 0)
+		{
+			LOG_WRN("Queue is full, could not add control data.\n");
+		}
+
+		/* Publish right away instead of waiting for the next event */
+		if (atomic_get(&mqtt_connected))
+		{
+			k_work_reschedule_for_queue(&transport_queue, &mqtt_pub_work, K_NO_WAIT);
+		}
+
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+
+	if (sensor_put(&sensor_data_queue, buf) != 0)
+	{
+		LOG_WRN("Queue is full, could not add sensor data.\n");
+	}
+}
+
 static void transport_task(void)
 {
 	int err;
@@ -496,18 +1799,59 @@ static void transport_task(void)
 
 	const struct zbus_channel *chan;
 	enum network_status status;
-	struct velopera_payload payload;
+	struct net_buf *buf;
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+	struct velopera_nina_data nina_data;
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
 	struct dynsec_mqtt_helper_cfg cfg = {
 		.cb = {
 			.on_connack = on_mqtt_connack,
 			.on_disconnect = on_mqtt_disconnect,
 			.on_publish = on_mqtt_publish,
+			.on_puback = on_mqtt_puback,
 			.on_suback = on_mqtt_suback,
 		},
 	};
 
 	s_obj.topic = pub_topic;
 
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH)
+	batch_reset(&sensor_batch);
+	batch_reset(&gps_batch);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK)
+	gps_track_encoder_init(&track, track_buf, sizeof(track_buf));
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_GPS_TRACK */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+	series_reset();
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
+
+	inflight_init(publish_message);
+
+	txqueue_init(&gps_data_queue);
+	txqueue_init(&sensor_data_queue);
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+	txqueue_init(&control_data_queue);
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+
+	LOG_INF("Transport queue pool takes %d bytes of RAM, the fixed queues took %d bytes",
+			(int)TXQUEUE_HEAP_SIZE(CONFIG_MQTT_SAMPLE_TRANSPORT_POOL_SIZE), (int)FIXED_QUEUES_SIZE);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_LANES)
+	lanes_init();
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_LANES */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+	/* Messages are sent directly without the store */
+	err = store_init(publish_message);
+	if (err)
+	{
+		LOG_ERR("store_init, error: %d", err);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+
 	/* Initialize and start application workqueue.
 	 * This workqueue can be used to offload tasks and/or as a timer when wanting to
 	 * schedule functionality using the 'k_work' API.
@@ -545,7 +1889,7 @@ static void transport_task(void)
 				return;
 			}
 
-			err = modify_login_info_msg(login_msg.string, sizeof(login_msg.string));
+			login_msg_len = modify_login_info_msg(login_msg.string, sizeof(login_msg.string));
 
 			s_obj.status = status;
 
@@ -560,8 +1904,22 @@ static void transport_task(void)
 
 		if (&MQTT_CHAN == chan)
 		{
+			/* All lines published since the last notification */
+			while ((buf = net_buf_get(&payload_fifo, K_NO_WAIT)) != NULL)
+			{
+				line_queue(buf);
+				net_buf_unref(buf);
+			}
 
-			err = zbus_chan_read(&MQTT_CHAN, &payload, K_SECONDS(1));
+			queue_status_publish();
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+			store_schedule();
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
+		}
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)
+		if (&NINA_DATA_CHAN == chan)
+		{
+			err = zbus_chan_read(&NINA_DATA_CHAN, &nina_data, K_SECONDS(1));
 			if (err)
 			{
 				LOG_ERR("zbus_chan_read, error: %d", err);
@@ -569,25 +1927,17 @@ static void transport_task(void)
 				return;
 			}
 
-			if (k_msgq_put(&sensor_data_queue, &payload, K_NO_WAIT) != 0)
+			if (k_msgq_put(&nina_data_queue, &nina_data, K_NO_WAIT) != 0)
 			{
-				LOG_WRN("Queue is full, could not add sensor data.\n");
+				LOG_WRN("Queue is full, could not add Nina data.\n");
 			}
-
-			// s_obj.payload = payload;
-			// s_obj.topic = pub_topic;
-
-			// err = smf_run_state(SMF_CTX(&s_obj));
-			// if (err)
-			// {
-			// 	LOG_ERR("smf_run_state, error: %d", err);
-			// 	SEND_FATAL_ERROR();
-			// 	return;
-			// }
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+			store_schedule();
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
 		}
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES */
 		if (&GPS_CHAN == chan)
 		{
-			printf("LINE %d\r\n", __LINE__);
 			err = zbus_chan_read(&GPS_CHAN, &gps_data, K_SECONDS(1));
 			if (err)
 			{
@@ -595,21 +1945,14 @@ static void transport_task(void)
 				SEND_FATAL_ERROR();
 				return;
 			}
-			printf("gps_data %d\r\n", gps_data.meas_id);
-			if (k_msgq_put(&gps_data_queue, &gps_data, K_NO_WAIT) != 0)
+			LOG_DBG("GPS fix %d received", gps_data.meas_id);
+			if (txqueue_put(&gps_data_queue, &gps_data, sizeof(gps_data)) != 0)
 			{
 				LOG_WRN("Queue is full, could not add GPS data.\n");
 			}
-			printf("LINE %d\r\n", __LINE__); // s_obj.payload = payload;
-											 // s_obj.topic = gps_pub_topic;
-
-			// err = smf_run_state(SMF_CTX(&s_obj));
-			// if (err)
-			// {
-			// 	LOG_ERR("smf_run_state, error: %d", err);
-			// 	SEND_FATAL_ERROR();
-			// 	return;
-			// }
+#if defined(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE)
+			store_schedule();
+#endif /* CONFIG_MQTT_SAMPLE_TRANSPORT_STORE */
 		}
 	}
 }
@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+
+#include "txqueue.h"
+
+#define TXQUEUE_DECIMATE_FACTOR CONFIG_MQTT_SAMPLE_TRANSPORT_OVERFLOW_DECIMATE_FACTOR
+
+struct txqueue_record
+{
+	sys_dnode_t node;
+	/* Uptime in ms the record was enqueued at, see k_uptime_get() */
+	int64_t enqueued;
+	size_t len;
+	/* Set by merge(), the record is the aggregate of several ones */
+	bool aggregate;
+	uint8_t data[];
+};
+
+static const char *const overflow_names[TXQUEUE_OVERFLOW_COUNT] = {
+	[TXQUEUE_DROP_NEWEST] = "drop-newest",
+	[TXQUEUE_DROP_OLDEST] = "drop-oldest",
+	[TXQUEUE_DECIMATE] = "decimate",
+	[TXQUEUE_MERGE] = "merge",
+};
+
+/* The functions up to txqueue_init() have to be called with the mutex of the pool held */
+
+static struct txqueue_record *record_get(sys_dnode_t *node)
+{
+	return (node != NULL) ? CONTAINER_OF(node, struct txqueue_record, node) : NULL;
+}
+
+/* Bytes a record takes in the heap, its header and data in whole chunks */
+static size_t record_size(size_t len)
+{
+	return TXQUEUE_CHUNK_SIZE(sizeof(struct txqueue_record) + len);
+}
+
+/* Bytes of the minimum quota the queue does not use */
+static size_t reserve(const struct txqueue *queue)
+{
+	return (queue->bytes < queue->min_bytes) ? queue->min_bytes - queue->bytes : 0;
+}
+
+static void bytes_add(struct txqueue *queue, size_t size)
+{
+	struct txqueue_pool *pool = queue->pool;
+
+	pool->reserved -= reserve(queue);
+	queue->bytes += size;
+	pool->reserved += reserve(queue);
+	pool->used += size;
+
+	queue->bytes_high_water = MAX(queue->bytes_high_water, queue->bytes);
+	pool->high_water = MAX(pool->high_water, pool->used);
+}
+
+static void bytes_sub(struct txqueue *queue, size_t size)
+{
+	struct txqueue_pool *pool = queue->pool;
+
+	pool->reserved -= reserve(queue);
+	queue->bytes -= size;
+	pool->reserved += reserve(queue);
+	pool->used -= size;
+}
+
+/* Bytes the queue can allocate without exceeding its maximum quota or taking the minimum quota
+ * of another queue
+ */
+static size_t available(const struct txqueue *queue)
+{
+	const struct txqueue_pool *pool = queue->pool;
+	size_t taken = pool->used + pool->reserved - reserve(queue);
+	size_t quota = queue->max_bytes - MIN(queue->bytes, queue->max_bytes);
+
+	return MIN(quota, pool->size - MIN(taken, pool->size));
+}
+
+/* Returns the room of a record removed from its queue to the pool */
+static void record_release(struct txqueue *queue, struct txqueue_record *record)
+{
+	bytes_sub(queue, record_size(record->len));
+	k_heap_free(queue->pool->heap, record);
+}
+
+static void record_free(struct txqueue *queue, struct txqueue_record *record)
+{
+	sys_dlist_remove(&record->node);
+	queue->used--;
+	record_release(queue, record);
+}
+
+static bool drop_oldest(struct txqueue *queue)
+{
+	struct txqueue_record *oldest = record_get(sys_dlist_peek_head(&queue->records));
+
+	if (oldest == NULL)
+	{
+		return false;
+	}
+
+	record_free(queue, oldest);
+
+	return true;
+}
+
+/* Removes the records older than the time to live, they are always the oldest ones */
+static void expire(struct txqueue *queue, int64_t now)
+{
+	struct txqueue_record *oldest;
+
+	if (queue->ttl_ms == 0)
+	{
+		return;
+	}
+
+	while (((oldest = record_get(sys_dlist_peek_head(&queue->records))) != NULL) &&
+		   (now - oldest->enqueued > queue->ttl_ms))
+	{
+		if (queue->expired == 0)
+		{
+			queue->expired_oldest = oldest->enqueued;
+		}
+
+		queue->expired++;
+		queue->expired_newest = oldest->enqueued;
+		record_free(queue, oldest);
+	}
+}
+
+/* Keeps every TXQUEUE_DECIMATE_FACTOR-th record, counting back from the newest one. Returns false
+ * if no record could be removed.
+ */
+static bool decimate(struct txqueue *queue)
+{
+	sys_dnode_t *node = sys_dlist_peek_tail(&queue->records);
+	uint32_t index = 0;
+	bool removed = false;
+
+	while (node != NULL)
+	{
+		sys_dnode_t *prev = sys_dlist_peek_prev(&queue->records, node);
+
+		if ((index++ % TXQUEUE_DECIMATE_FACTOR) != 0)
+		{
+			record_free(queue, record_get(node));
+			removed = true;
+		}
+
+		node = prev;
+	}
+
+	return removed;
+}
+
+/* Replaces the two oldest adjacent records that can be merged by their aggregate. Returns false
+ * if no records can be merged, or the aggregate cannot be allocated.
+ */
+static bool merge(struct txqueue *queue)
+{
+	struct txqueue_record *older = record_get(sys_dlist_peek_head(&queue->records));
+	struct txqueue_record *newer;
+	struct txqueue_record *merged;
+	const void *data;
+	size_t len = 0;
+
+	if (queue->merge == NULL)
+	{
+		return false;
+	}
+
+	/* An aggregate that is full already is skipped */
+	for (; older != NULL; older = newer)
+	{
+		newer = record_get(sys_dlist_peek_next(&queue->records, &older->node));
+		if (newer == NULL)
+		{
+			return false;
+		}
+
+		len = queue->merge(older->data, older->len, older->aggregate, newer->data, newer->len,
+						   newer->aggregate, &data);
+		if ((len > 0) && (len <= older->len + newer->len))
+		{
+			break;
+		}
+	}
+
+	if (older == NULL)
+	{
+		return false;
+	}
+
+	/* Both records are kept unless the aggregate can be allocated, without room in the heap
+	 * the caller drops the oldest record instead
+	 */
+	merged = k_heap_alloc(queue->pool->heap, sizeof(*merged) + len, K_NO_WAIT);
+	if (merged == NULL)
+	{
+		return false;
+	}
+
+	/* The aggregate is as old as its oldest record */
+	merged->enqueued = older->enqueued;
+	merged->len = len;
+	merged->aggregate = true;
+	memcpy(merged->data, data, len);
+
+	sys_dlist_insert(&older->node, &merged->node);
+	bytes_add(queue, record_size(len));
+	queue->used++;
+
+	record_free(queue, older);
+	record_free(queue, newer);
+
+	return true;
+}
+
+/* Makes room according to the overflow policy. Returns false if the new record has to be
+ * dropped.
+ */
+static bool overflow_handle(struct txqueue *queue)
+{
+	enum txqueue_overflow policy = queue->overflow;
+
+	if ((policy == TXQUEUE_DECIMATE) && !decimate(queue))
+	{
+		policy = TXQUEUE_DROP_OLDEST;
+	}
+
+	if ((policy == TXQUEUE_MERGE) && !merge(queue))
+	{
+		policy = TXQUEUE_DROP_OLDEST;
+	}
+
+	if ((policy == TXQUEUE_DROP_OLDEST) && !drop_oldest(queue))
+	{
+		policy = TXQUEUE_DROP_NEWEST;
+	}
+
+	queue->overflows[policy]++;
+
+	return policy != TXQUEUE_DROP_NEWEST;
+}
+
+void txqueue_init(struct txqueue *queue)
+{
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+
+	queue->pool->reserved += reserve(queue);
+
+	k_mutex_unlock(&queue->pool->lock);
+}
+
+void *txqueue_alloc(struct txqueue *queue, size_t len)
+{
+	struct txqueue_pool *pool = queue->pool;
+	size_t size = record_size(len);
+	struct txqueue_record *record = NULL;
+
+	k_mutex_lock(&pool->lock, K_FOREVER);
+
+	expire(queue, k_uptime_get());
+
+	/* A record beyond the maximum quota would only empty the queue */
+	if (size > queue->max_bytes)
+	{
+		queue->overflows[TXQUEUE_DROP_NEWEST]++;
+		k_mutex_unlock(&pool->lock);
+		return NULL;
+	}
+
+	while (true)
+	{
+		if (available(queue) >= size)
+		{
+			record = k_heap_alloc(pool->heap, sizeof(*record) + len, K_NO_WAIT);
+			if (record != NULL)
+			{
+				break;
+			}
+
+			/* The quotas are in heap chunks and the heap holds the whole budget, only
+			 * fragmentation is left to make room for
+			 */
+			pool->fragmented++;
+		}
+
+		if (!overflow_handle(queue))
+		{
+			break;
+		}
+	}
+
+	if (record != NULL)
+	{
+		record->len = len;
+		record->aggregate = false;
+		bytes_add(queue, size);
+	}
+
+	k_mutex_unlock(&pool->lock);
+
+	return (record != NULL) ? record->data : NULL;
+}
+
+void txqueue_commit(struct txqueue *queue, void *data)
+{
+	struct txqueue_record *record = CONTAINER_OF(data, struct txqueue_record, data);
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+
+	record->enqueued = k_uptime_get();
+	sys_dlist_append(&queue->records, &record->node);
+	queue->used++;
+	queue->used_high_water = MAX(queue->used_high_water, queue->used);
+
+	k_mutex_unlock(&queue->pool->lock);
+}
+
+int txqueue_put(struct txqueue *queue, const void *data, size_t len)
+{
+	void *record = txqueue_alloc(queue, len);
+
+	if (record == NULL)
+	{
+		return -ENOMSG;
+	}
+
+	memcpy(record, data, len);
+	txqueue_commit(queue, record);
+
+	return 0;
+}
+
+void *txqueue_take(struct txqueue *queue, size_t *len)
+{
+	struct txqueue_record *record;
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+
+	expire(queue, k_uptime_get());
+
+	record = record_get(queue->newest_first ? sys_dlist_peek_tail(&queue->records)
+											: sys_dlist_peek_head(&queue->records));
+	if (record != NULL)
+	{
+		sys_dlist_remove(&record->node);
+		queue->used--;
+		*len = record->len;
+	}
+
+	k_mutex_unlock(&queue->pool->lock);
+
+	return (record != NULL) ? record->data : NULL;
+}
+
+void txqueue_free(struct txqueue *queue, void *data)
+{
+	struct txqueue_record *record = CONTAINER_OF(data, struct txqueue_record, data);
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+
+	record_release(queue, record);
+
+	k_mutex_unlock(&queue->pool->lock);
+}
+
+int txqueue_get(struct txqueue *queue, void *data, size_t size)
+{
+	size_t len;
+	void *record = txqueue_take(queue, &len);
+
+	if (record == NULL)
+	{
+		return -ENOMSG;
+	}
+
+	if (len <= size)
+	{
+		memcpy(data, record, len);
+	}
+
+	txqueue_free(queue, record);
+
+	return (len <= size) ? (int)len : -EMSGSIZE;
+}
+
+uint32_t txqueue_num_used_get(struct txqueue *queue)
+{
+	uint32_t used;
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+	used = queue->used;
+	k_mutex_unlock(&queue->pool->lock);
+
+	return used;
+}
+
+size_t txqueue_bytes_get(struct txqueue *queue)
+{
+	size_t bytes;
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+	bytes = queue->bytes;
+	k_mutex_unlock(&queue->pool->lock);
+
+	return bytes;
+}
+
+size_t txqueue_capacity_get(struct txqueue *queue)
+{
+	size_t capacity;
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+	capacity = queue->bytes + available(queue);
+	k_mutex_unlock(&queue->pool->lock);
+
+	return capacity;
+}
+
+uint32_t txqueue_expired_take(struct txqueue *queue, int64_t *oldest, int64_t *newest)
+{
+	uint32_t expired;
+
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+
+	expired = queue->expired;
+	*oldest = queue->expired_oldest;
+	*newest = queue->expired_newest;
+	queue->expired = 0;
+
+	k_mutex_unlock(&queue->pool->lock);
+
+	return expired;
+}
+
+void txqueue_overflow_set(struct txqueue *queue, enum txqueue_overflow overflow)
+{
+	k_mutex_lock(&queue->pool->lock, K_FOREVER);
+
+	queue->overflow = overflow;
+
+	k_mutex_unlock(&queue->pool->lock);
+}
+
+const char *txqueue_overflow_name(enum txqueue_overflow overflow)
+{
+	return (overflow < TXQUEUE_OVERFLOW_COUNT) ? overflow_names[overflow] : "unknown";
+}
+
+int txqueue_overflow_parse(const char *name)
+{
+	for (int i = 0; i < TXQUEUE_OVERFLOW_COUNT; i++)
+	{
+		if (strcmp(name, overflow_names[i]) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -EINVAL;
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Transport queues of variable size records with time to live, sharing one pool.
+ *
+ * All queues allocate their records from one heap, the pool, sized by a total byte budget. A
+ * record takes its length plus a small header, rounded up to the chunks of the heap, so that a
+ * short Nina line no longer pins a whole payload buffer. Each queue has a minimum quota that
+ * stays reserved for it while unused, and a maximum quota it can grow to by borrowing capacity
+ * the other queues do not use.
+ *
+ * The heap is larger than the budget by its own metadata, so that records filling the quotas
+ * always fit into it unless it is fragmented.
+ *
+ * Every record carries the uptime it was enqueued at, records older than the time to live of
+ * the queue expire, and the queue drains either oldest first, for a complete history, or newest
+ * first, for the live state.
+ *
+ * Expired records are removed before every put and get, so they neither take the room of new
+ * records nor the connection time of fresh ones. They are counted until
+ * txqueue_expired_take() collects them.
+ *
+ * What happens to a record put into a queue without room depends on the overflow policy of the
+ * queue, see enum txqueue_overflow. It can be changed at runtime.
+ *
+ * One thread may put while another one gets. The pool is protected by a mutex, queues cannot be
+ * used from interrupts.
+ */
+
+#ifndef TXQUEUE_H__
+#define TXQUEUE_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/** Overflow policies, what a put into a queue without room does */
+	enum txqueue_overflow
+	{
+		/** The new record is dropped */
+		TXQUEUE_DROP_NEWEST,
+		/** The oldest record is dropped to make room */
+		TXQUEUE_DROP_OLDEST,
+		/** Only every Nth queued record is kept, counting back from the newest one */
+		TXQUEUE_DECIMATE,
+		/** The two oldest adjacent records that can be merged are merged, see txqueue_merge_t.
+		 *  The oldest record is dropped if there is no room for the aggregate.
+		 */
+		TXQUEUE_MERGE,
+		TXQUEUE_OVERFLOW_COUNT,
+	};
+
+	/**
+	 * @brief Merges two records into one.
+	 *
+	 * @param older older record
+	 * @param older_len length of the older record
+	 * @param older_aggregate true if the older record is an aggregate of earlier merges
+	 * @param newer next newer record
+	 * @param newer_len length of the newer record
+	 * @param newer_aggregate true if the newer record is an aggregate of earlier merges
+	 * @param merged set to the aggregate of both, valid until the next call
+	 *
+	 * @return Length of the aggregate, at most older_len + newer_len, or 0 if the records cannot
+	 *         be merged.
+	 */
+	typedef size_t (*txqueue_merge_t)(const void *older, size_t older_len, bool older_aggregate,
+									  const void *newer, size_t newer_len, bool newer_aggregate,
+									  const void **merged);
+
+/** Bytes of a heap chunk header, 8 on 64-bit targets, see sys_heap */
+#define TXQUEUE_CHUNK_HEADER ((sizeof(void *) > 4) ? 8 : 4)
+
+/** Bytes a heap allocation of len bytes takes, in chunks of 8 bytes with their header */
+#define TXQUEUE_CHUNK_SIZE(len) ROUND_UP((len) + TXQUEUE_CHUNK_HEADER, 8)
+
+/** Bytes the heap takes for its own header, free lists and end marker */
+#define TXQUEUE_HEAP_META 128
+
+/** Size of the heap of a pool with a byte budget of p_size */
+#define TXQUEUE_HEAP_SIZE(p_size) ((p_size) + TXQUEUE_HEAP_META)
+
+	struct txqueue_pool
+	{
+		/** Held across heap allocations, merges and expiry */
+		struct k_mutex lock;
+		struct k_heap *heap;
+		/** Byte budget, the heap is larger by its metadata */
+		size_t size;
+		/** Bytes taken by records in heap chunks, including their headers */
+		size_t used;
+		/** Bytes of the minimum quotas not used by their queues */
+		size_t reserved;
+		size_t high_water;
+		/** Allocations the heap refused although the quotas had room, it was fragmented */
+		uint32_t fragmented;
+	};
+
+	struct txqueue
+	{
+		struct txqueue_pool *pool;
+		/** Records from the oldest to the newest one */
+		sys_dlist_t records;
+		/** Quotas in bytes of records in heap chunks, including their headers */
+		size_t min_bytes;
+		size_t max_bytes;
+		size_t bytes;
+		uint32_t used;
+		size_t bytes_high_water;
+		uint32_t used_high_water;
+		/** Records expire this many ms after they were enqueued, 0 never */
+		int64_t ttl_ms;
+		/** Drain the newest record first */
+		bool newest_first;
+		enum txqueue_overflow overflow;
+		/** Merges records with TXQUEUE_MERGE, without it the oldest record is dropped */
+		txqueue_merge_t merge;
+
+		/** Number of overflows handled by each policy */
+		uint32_t overflows[TXQUEUE_OVERFLOW_COUNT];
+
+		/** Expired records since the last txqueue_expired_take() */
+		uint32_t expired;
+		int64_t expired_oldest;
+		int64_t expired_newest;
+	};
+
+/**
+ * @brief Defines a pool for transport queues.
+ *
+ * The chunk headers of heaps from 256 KB on take 8 bytes on all targets, the pool is limited to
+ * smaller ones.
+ *
+ * @param name name of the pool
+ * @param p_size byte budget of the pool
+ */
+#define TXQUEUE_POOL_DEFINE(name, p_size)                                              \
+	BUILD_ASSERT(TXQUEUE_HEAP_SIZE(p_size) / 8 <= 0x7fff, "Transport pool too large"); \
+	K_HEAP_DEFINE(_txqueue_heap_##name, TXQUEUE_HEAP_SIZE(p_size));                    \
+	struct txqueue_pool name = {                                                       \
+		.lock = Z_MUTEX_INITIALIZER(name.lock),                                        \
+		.heap = &_txqueue_heap_##name,                                                 \
+		.size = (p_size),                                                              \
+	}
+
+/**
+ * @brief Defines a transport queue, to be initialized with txqueue_init().
+ *
+ * @param name name of the queue
+ * @param q_pool pool of the queue
+ * @param q_min_bytes minimum quota in bytes, reserved for the queue
+ * @param q_max_bytes maximum quota in bytes
+ * @param q_ttl_s time to live of a record in seconds, 0 never expires
+ * @param q_newest_first true to drain the newest record first
+ * @param q_overflow overflow policy, see enum txqueue_overflow
+ * @param q_merge merge function for TXQUEUE_MERGE, or NULL
+ */
+#define TXQUEUE_DEFINE(name, q_pool, q_min_bytes, q_max_bytes, q_ttl_s, q_newest_first, \
+					   q_overflow, q_merge)                                           \
+	struct txqueue name = {                                                          \
+		.pool = &(q_pool),                                                           \
+		.records = SYS_DLIST_STATIC_INIT(&name.records),                             \
+		.min_bytes = (q_min_bytes),                                                  \
+		.max_bytes = (q_max_bytes),                                                  \
+		.ttl_ms = (int64_t)(q_ttl_s) * MSEC_PER_SEC,                                 \
+		.newest_first = (q_newest_first),                                            \
+		.overflow = (q_overflow),                                                    \
+		.merge = (q_merge),                                                          \
+	}
+
+	/**
+	 * @brief Reserves the minimum quota of a queue in its pool, before its first put.
+	 *
+	 * @param queue queue
+	 */
+	void txqueue_init(struct txqueue *queue);
+
+	/**
+	 * @brief Allocates a record, applying the overflow policy if there is no room.
+	 *
+	 * The record is added to the queue by txqueue_commit(). Only one record of a queue can be
+	 * allocated at a time.
+	 *
+	 * @param queue queue
+	 * @param len length of the record
+	 *
+	 * @return Record to fill, or NULL if the record is dropped.
+	 */
+	void *txqueue_alloc(struct txqueue *queue, size_t len);
+
+	/**
+	 * @brief Adds a record allocated by txqueue_alloc() as the newest one.
+	 *
+	 * @param queue queue
+	 * @param data record
+	 */
+	void txqueue_commit(struct txqueue *queue, void *data);
+
+	/**
+	 * @brief Copies a record to the queue, see txqueue_alloc().
+	 *
+	 * @param queue queue
+	 * @param data record
+	 * @param len length of the record
+	 *
+	 * @retval 0 on success, possibly after the overflow policy made room.
+	 * @retval -ENOMSG if the record is dropped.
+	 */
+	int txqueue_put(struct txqueue *queue, const void *data, size_t len);
+
+	/**
+	 * @brief Removes the oldest or the newest record from the queue without copying it, see
+	 *        newest_first.
+	 *
+	 * The record keeps its room in the pool until it is returned by txqueue_free().
+	 *
+	 * @param queue queue
+	 * @param len set to the length of the record
+	 *
+	 * @return Record, or NULL if the queue is empty, or all records have expired.
+	 */
+	void *txqueue_take(struct txqueue *queue, size_t *len);
+
+	/**
+	 * @brief Returns the room of a record removed by txqueue_take() to the pool.
+	 *
+	 * @param queue queue the record was taken from
+	 * @param data record
+	 */
+	void txqueue_free(struct txqueue *queue, void *data);
+
+	/**
+	 * @brief Removes the oldest or the newest record from the queue, see newest_first.
+	 *
+	 * @param queue queue
+	 * @param data buffer
+	 * @param size size of the buffer
+	 *
+	 * @return Length of the record on success.
+	 * @retval -ENOMSG if the queue is empty, or all records have expired.
+	 * @retval -EMSGSIZE if the record does not fit into the buffer, it is dropped.
+	 */
+	int txqueue_get(struct txqueue *queue, void *data, size_t size);
+
+	/**
+	 * @brief Returns the number of records in the queue, including ones that have expired
+	 *        since the last put or get.
+	 */
+	uint32_t txqueue_num_used_get(struct txqueue *queue);
+
+	/**
+	 * @brief Returns the number of bytes taken by the records of the queue.
+	 */
+	size_t txqueue_bytes_get(struct txqueue *queue);
+
+	/**
+	 * @brief Returns the number of bytes the queue can hold right now, the bytes taken by its
+	 *        records plus the ones it could still allocate.
+	 */
+	size_t txqueue_capacity_get(struct txqueue *queue);
+
+	/**
+	 * @brief Returns the number of expired records and resets it.
+	 *
+	 * @param queue queue
+	 * @param oldest uptime in ms the oldest expired record was enqueued at
+	 * @param newest uptime in ms the newest expired record was enqueued at
+	 *
+	 * @return Number of records expired since the previous call.
+	 */
+	uint32_t txqueue_expired_take(struct txqueue *queue, int64_t *oldest, int64_t *newest);
+
+	/**
+	 * @brief Changes the overflow policy of a queue.
+	 *
+	 * @param queue queue
+	 * @param overflow overflow policy
+	 */
+	void txqueue_overflow_set(struct txqueue *queue, enum txqueue_overflow overflow);
+
+	/**
+	 * @brief Returns the name of an overflow policy, like "drop-oldest".
+	 */
+	const char *txqueue_overflow_name(enum txqueue_overflow overflow);
+
+	/**
+	 * @brief Looks up an overflow policy by its name.
+	 *
+	 * @param name name, see txqueue_overflow_name()
+	 *
+	 * @return Overflow policy, or a negative error code if the name is unknown.
+	 */
+	int txqueue_overflow_parse(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TXQUEUE_H__ */
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include "json_minify.h"
+
+BUILD_ASSERT(JSON_MINIFY_MAX_DEPTH <= 32, "Nesting is tracked in a 32 bit mask");
+
+enum json_expect
+{
+	/* A value, or the end of an empty array */
+	JSON_EXPECT_VALUE,
+	/* A member name, or the end of an empty object */
+	JSON_EXPECT_NAME,
+	JSON_EXPECT_COLON,
+	/* A comma or the end of the enclosing object or array */
+	JSON_EXPECT_NEXT,
+	/* Nothing but whitespace */
+	JSON_EXPECT_END,
+};
+
+static bool is_space(char c)
+{
+	return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t');
+}
+
+static bool is_digit(char c)
+{
+	return (c >= '0') && (c <= '9');
+}
+
+static bool is_hex(char c)
+{
+	return is_digit(c) || ((c >= 'a') && (c <= 'f')) || ((c >= 'A') && (c <= 'F'));
+}
+
+/* The scanners return the end of the token or NULL if it is invalid or truncated */
+
+static const char *scan_string(const char *p, const char *end)
+{
+	/* Skip the opening quote */
+	p++;
+
+	while (p < end)
+	{
+		char c = *p++;
+
+		if (c == '"')
+		{
+			return p;
+		}
+
+		if ((uint8_t)c < 0x20)
+		{
+			return NULL;
+		}
+
+		if (c != '\\')
+		{
+			continue;
+		}
+
+		if (p == end)
+		{
+			return NULL;
+		}
+
+		switch (*p++)
+		{
+		case '"':
+		case '\\':
+		case '/':
+		case 'b':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+			break;
+		case 'u':
+			if ((end - p < 4) || !is_hex(p[0]) || !is_hex(p[1]) || !is_hex(p[2]) ||
+				!is_hex(p[3]))
+			{
+				return NULL;
+			}
+			p += 4;
+			break;
+		default:
+			return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+static const char *scan_digits(const char *p, const char *end)
+{
+	const char *start = p;
+
+	while ((p < end) && is_digit(*p))
+	{
+		p++;
+	}
+
+	return (p > start) ? p : NULL;
+}
+
+static const char *scan_number(const char *p, const char *end)
+{
+	if (*p == '-')
+	{
+		p++;
+	}
+
+	if ((p < end) && (*p == '0'))
+	{
+		p++;
+	}
+	else if ((p = scan_digits(p, end)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((p < end) && (*p == '.'))
+	{
+		if ((p = scan_digits(p + 1, end)) == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	if ((p < end) && ((*p == 'e') || (*p == 'E')))
+	{
+		p++;
+
+		if ((p < end) && ((*p == '+') || (*p == '-')))
+		{
+			p++;
+		}
+
+		if ((p = scan_digits(p, end)) == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	return p;
+}
+
+static const char *scan_literal(const char *p, const char *end, const char *literal, size_t len)
+{
+	if (((size_t)(end - p) < len) || memcmp(p, literal, len))
+	{
+		return NULL;
+	}
+
+	return p + len;
+}
+
+static const char *scan_scalar(const char *p, const char *end)
+{
+	switch (*p)
+	{
+	case '"':
+		return scan_string(p, end);
+	case 't':
+		return scan_literal(p, end, "true", 4);
+	case 'f':
+		return scan_literal(p, end, "false", 5);
+	case 'n':
+		return scan_literal(p, end, "null", 4);
+	default:
+		return scan_number(p, end);
+	}
+}
+
+int json_minify(char *buf, size_t len)
+{
+	const char *end = buf + len;
+	const char *r = buf;
+	char *w = buf;
+	enum json_expect expect = JSON_EXPECT_VALUE;
+	/* Bit n is set if the container at depth n + 1 is an object */
+	uint32_t objects = 0;
+	int depth = 0;
+	bool empty = false;
+
+	while (r < end)
+	{
+		const char *token = r;
+		char c = *r;
+		bool in_object = (depth > 0) && (objects & BIT(depth - 1));
+		bool close = false;
+
+		if (is_space(c))
+		{
+			r++;
+			continue;
+		}
+
+		switch (expect)
+		{
+		case JSON_EXPECT_VALUE:
+			if ((c == '{') || (c == '['))
+			{
+				if (depth == JSON_MINIFY_MAX_DEPTH)
+				{
+					return -E2BIG;
+				}
+
+				WRITE_BIT(objects, depth, c == '{');
+				depth++;
+				r++;
+				expect = (c == '{') ? JSON_EXPECT_NAME : JSON_EXPECT_VALUE;
+				empty = true;
+				break;
+			}
+
+			if ((c == ']') && empty && !in_object)
+			{
+				close = true;
+				break;
+			}
+
+			/* The text is an object or array, not a bare value */
+			if (depth == 0)
+			{
+				return -EBADMSG;
+			}
+
+			r = scan_scalar(r, end);
+			expect = JSON_EXPECT_NEXT;
+			break;
+		case JSON_EXPECT_NAME:
+			if ((c == '}') && empty)
+			{
+				close = true;
+				break;
+			}
+
+			r = (c == '"') ? scan_string(r, end) : NULL;
+			expect = JSON_EXPECT_COLON;
+			break;
+		case JSON_EXPECT_COLON:
+			r = (c == ':') ? r + 1 : NULL;
+			expect = JSON_EXPECT_VALUE;
+			empty = false;
+			break;
+		case JSON_EXPECT_NEXT:
+			if (c == ',')
+			{
+				r++;
+				expect = in_object ? JSON_EXPECT_NAME : JSON_EXPECT_VALUE;
+				empty = false;
+				break;
+			}
+
+			if (c != (in_object ? '}' : ']'))
+			{
+				return -EBADMSG;
+			}
+
+			close = true;
+			break;
+		case JSON_EXPECT_END:
+		default:
+			return -EBADMSG;
+		}
+
+		if (close)
+		{
+			r++;
+			depth--;
+			expect = (depth > 0) ? JSON_EXPECT_NEXT : JSON_EXPECT_END;
+		}
+		else if (r == NULL)
+		{
+			return -EBADMSG;
+		}
+
+		/* Nothing to move until the first whitespace has been skipped */
+		if (w != token)
+		{
+			memmove(w, token, r - token);
+		}
+		w += r - token;
+	}
+
+	if (expect != JSON_EXPECT_END)
+	{
+		/* Truncated */
+		return -EBADMSG;
+	}
+
+	return w - buf;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef JSON_MINIFY_H__
+#define JSON_MINIFY_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Maximum nesting depth of objects and arrays */
+#define JSON_MINIFY_MAX_DEPTH 32
+
+	/**
+	 * @brief Validates a JSON text and removes insignificant whitespace in place, in a single
+	 *	  pass and without allocating.
+	 *
+	 * The text has to be exactly one object or array. Truncated texts, trailing data, control
+	 * characters in strings and invalid escapes, numbers or literals are rejected. The buffer
+	 * content is undefined if the text is rejected.
+	 *
+	 * @param buf JSON text, does not need to be null-terminated
+	 * @param len length of the text
+	 *
+	 * @return Length of the minified text, it is not null-terminated.
+	 * @retval -EBADMSG if the text is not valid JSON.
+	 * @retval -E2BIG if the text is nested deeper than JSON_MINIFY_MAX_DEPTH.
+	 */
+	int json_minify(char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_MINIFY_H__ */
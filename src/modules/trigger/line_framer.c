@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include "line_framer.h"
+
+typedef uintptr_t word_t;
+
+#define WORD_ONES ((word_t)-1 / 0xFF)
+#define WORD_HIGHS (WORD_ONES * 0x80)
+
+/* Non-zero if any byte of the word is zero */
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+const uint8_t *line_framer_find(const uint8_t *data, size_t len, uint8_t byte)
+{
+	const uint8_t *end = data + len;
+	const word_t pattern = WORD_ONES * byte;
+
+	/* Head, until data is word aligned */
+	while ((data < end) && ((uintptr_t)data % sizeof(word_t)))
+	{
+		if (*data == byte)
+		{
+			return data;
+		}
+		data++;
+	}
+
+	/* Body, one aligned word per iteration */
+	while ((size_t)(end - data) >= sizeof(word_t))
+	{
+		word_t w;
+
+		memcpy(&w, data, sizeof(w));
+
+		if (WORD_HAS_ZERO(w ^ pattern))
+		{
+			break;
+		}
+		data += sizeof(word_t);
+	}
+
+	/* Tail, and the word that contains the match */
+	while (data < end)
+	{
+		if (*data == byte)
+		{
+			return data;
+		}
+		data++;
+	}
+
+	return NULL;
+}
+
+void line_framer_init(struct line_framer *framer, uint8_t delimiter, char *carry,
+					  size_t carry_size, line_framer_cb_t cb, void *user_data)
+{
+	memset(framer, 0, sizeof(*framer));
+
+	framer->delimiter = delimiter;
+	framer->carry = carry;
+	framer->carry_size = carry_size;
+	framer->cb = cb;
+	framer->user_data = user_data;
+}
+
+void line_framer_reset(struct line_framer *framer)
+{
+	framer->carry_len = 0;
+	framer->overrun = true;
+}
+
+void line_framer_restart(struct line_framer *framer, uint8_t delimiter)
+{
+	framer->delimiter = delimiter;
+	framer->carry_len = 0;
+	framer->overrun = false;
+}
+
+/* Appends to the carry buffer, flags an overrun if the line does not fit */
+static void carry_append(struct line_framer *framer, const uint8_t *data, size_t len)
+{
+	if (framer->overrun)
+	{
+		return;
+	}
+
+	if (len > framer->carry_size - framer->carry_len)
+	{
+		framer->overrun = true;
+		return;
+	}
+
+	memcpy(&framer->carry[framer->carry_len], data, len);
+	framer->carry_len += len;
+}
+
+static void emit(struct line_framer *framer, const char *line, size_t line_size)
+{
+	if (framer->overrun || (line_size > framer->carry_size))
+	{
+		framer->overruns++;
+	}
+	else if (line_size > 0)
+	{
+		framer->lines++;
+		framer->cb(line, line_size, framer->user_data);
+	}
+
+	framer->carry_len = 0;
+	framer->overrun = false;
+}
+
+void line_framer_feed(struct line_framer *framer, const uint8_t *data, size_t len)
+{
+	const uint8_t *end = data + len;
+	const uint8_t *delim;
+
+	while ((delim = line_framer_find(data, end - data, framer->delimiter)) != NULL)
+	{
+		if (framer->carry_len || framer->overrun)
+		{
+			/* Completes a line started in a previous chunk */
+			carry_append(framer, data, delim - data);
+			emit(framer, framer->carry, framer->carry_len);
+		}
+		else
+		{
+			emit(framer, (const char *)data, delim - data);
+		}
+
+		data = delim + 1;
+	}
+
+	carry_append(framer, data, end - data);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LINE_FRAMER_H__
+#define LINE_FRAMER_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/**
+	 * @brief Callback invoked for every complete line.
+	 *
+	 * @param line start of the line, not null-terminated and not including the delimiter.
+	 *	       Only valid for the duration of the callback.
+	 * @param line_size number of bytes in the line
+	 * @param user_data user data given to line_framer_init()
+	 */
+	typedef void (*line_framer_cb_t)(const char *line, size_t line_size, void *user_data);
+
+	/**
+	 * @brief Splits a stream of received chunks into delimiter separated lines.
+	 *
+	 * Lines that are completely contained in one chunk are passed to the callback straight
+	 * from the chunk. Only the part of a line that crosses a chunk boundary is copied, once,
+	 * into the carry buffer.
+	 */
+	struct line_framer
+	{
+		uint8_t delimiter;
+		char *carry;
+		size_t carry_size;
+		size_t carry_len;
+		bool overrun;
+		line_framer_cb_t cb;
+		void *user_data;
+
+		/* Statistics */
+		uint32_t lines;
+		uint32_t overruns;
+	};
+
+	/**
+	 * @brief Initializes a line framer.
+	 *
+	 * @param framer line framer
+	 * @param delimiter line delimiter
+	 * @param carry buffer for lines crossing chunk boundaries, also the maximum line size
+	 * @param carry_size size of the carry buffer
+	 * @param cb callback invoked for every complete line
+	 * @param user_data passed to the callback
+	 */
+	void line_framer_init(struct line_framer *framer, uint8_t delimiter, char *carry,
+						  size_t carry_size, line_framer_cb_t cb, void *user_data);
+
+	/**
+	 * @brief Frames one received chunk. Lines longer than the carry buffer are dropped and
+	 *	  counted as overruns.
+	 *
+	 * @param framer line framer
+	 * @param data received data
+	 * @param len number of received bytes
+	 */
+	void line_framer_feed(struct line_framer *framer, const uint8_t *data, size_t len);
+
+	/**
+	 * @brief Drops a partially received line, e.g. after received data was lost.
+	 *
+	 * @param framer line framer
+	 */
+	void line_framer_reset(struct line_framer *framer);
+
+	/**
+	 * @brief Discards any partial line and restarts framing with a new delimiter. The next
+	 *	  received byte starts a new line.
+	 *
+	 * @param framer line framer
+	 * @param delimiter line delimiter
+	 */
+	void line_framer_restart(struct line_framer *framer, uint8_t delimiter);
+
+	/**
+	 * @brief Finds the first occurrence of a byte, scanning one machine word at a time.
+	 *
+	 * @param data buffer to scan
+	 * @param len size of the buffer
+	 * @param byte byte to look for
+	 *
+	 * @return Pointer to the first occurrence or NULL if not found.
+	 */
+	const uint8_t *line_framer_find(const uint8_t *data, size_t len, uint8_t byte);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_FRAMER_H__ */
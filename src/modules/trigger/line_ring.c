@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+
+#include "line_ring.h"
+
+BUILD_ASSERT(IS_POWER_OF_TWO(LINE_RING_DEPTH), "Line ring depth must be a power of two");
+
+#define LINE_RING_MASK (LINE_RING_DEPTH - 1)
+
+void line_ring_init(struct line_ring *ring)
+{
+	memset(ring, 0, sizeof(*ring));
+}
+
+/* Returns the slot at the head of the ring, or NULL if the consumer has not released it yet. */
+static struct line_ring_slot *producer_slot(struct line_ring *ring)
+{
+	atomic_val_t head = atomic_get(&ring->head);
+
+	if ((uint32_t)(head - atomic_get(&ring->tail)) >= LINE_RING_DEPTH)
+	{
+		return NULL;
+	}
+
+	return &ring->slots[head & LINE_RING_MASK];
+}
+
+static void commit(struct line_ring *ring, uint8_t flags)
+{
+	atomic_val_t head = atomic_get(&ring->head);
+	struct line_ring_slot *slot = &ring->slots[head & LINE_RING_MASK];
+
+	slot->len = ring->fill;
+	slot->flags = flags | (ring->cont ? LINE_RING_FLAG_CONT : 0);
+	slot->timestamp = k_cycle_get_64();
+
+	/* The slot content must be visible to the consumer before the new head. */
+	atomic_set(&ring->head, head + 1);
+
+	ring->fill = 0;
+	ring->cont = (flags & LINE_RING_FLAG_MORE);
+}
+
+static void drop_line(struct line_ring *ring)
+{
+	atomic_inc(&ring->dropped);
+
+	/* Slots already committed for this line carry LINE_RING_FLAG_MORE, the consumer discards
+	 * them when the next line starts without LINE_RING_FLAG_CONT.
+	 */
+	ring->discarding = true;
+	ring->fill = 0;
+	ring->cont = false;
+}
+
+bool line_ring_put(struct line_ring *ring, uint8_t byte, uint8_t delimiter)
+{
+	if (byte == delimiter)
+	{
+		bool truncated = ring->truncating;
+
+		ring->truncating = false;
+
+		if (ring->discarding)
+		{
+			ring->discarding = false;
+			return false;
+		}
+
+		if (ring->fill == 0)
+		{
+			/* Ignore empty lines */
+			if (!ring->cont)
+			{
+				return false;
+			}
+
+			if (producer_slot(ring) == NULL)
+			{
+				drop_line(ring);
+				ring->discarding = false;
+				return false;
+			}
+		}
+
+		commit(ring, truncated ? LINE_RING_FLAG_TRUNCATED : 0);
+		atomic_inc(&ring->lines);
+
+		return true;
+	}
+
+	if (ring->discarding || ring->truncating)
+	{
+		return false;
+	}
+
+	if (ring->fill == LINE_RING_SLOT_SIZE)
+	{
+		if (!IS_ENABLED(CONFIG_MQTT_SAMPLE_TRIGGER_LINE_RING_SPILL))
+		{
+			atomic_inc(&ring->truncated);
+			ring->truncating = true;
+			return false;
+		}
+
+		commit(ring, LINE_RING_FLAG_MORE);
+	}
+
+	if (ring->fill == 0 && producer_slot(ring) == NULL)
+	{
+		drop_line(ring);
+		return false;
+	}
+
+	ring->slots[atomic_get(&ring->head) & LINE_RING_MASK].data[ring->fill++] = byte;
+
+	return false;
+}
+
+struct line_ring_slot *line_ring_peek(struct line_ring *ring)
+{
+	atomic_val_t tail = atomic_get(&ring->tail);
+
+	if (tail == atomic_get(&ring->head))
+	{
+		return NULL;
+	}
+
+	return &ring->slots[tail & LINE_RING_MASK];
+}
+
+void line_ring_release(struct line_ring *ring)
+{
+	atomic_inc(&ring->tail);
+}
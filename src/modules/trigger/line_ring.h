@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef LINE_RING_H__
+#define LINE_RING_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** The line continues in the next slot. */
+#define LINE_RING_FLAG_MORE BIT(0)
+/** The slot continues the line of the previous slot. */
+#define LINE_RING_FLAG_CONT BIT(1)
+/** Bytes of the line were discarded because the line did not fit into a slot. */
+#define LINE_RING_FLAG_TRUNCATED BIT(2)
+
+#define LINE_RING_DEPTH CONFIG_MQTT_SAMPLE_TRIGGER_LINE_RING_DEPTH
+#define LINE_RING_SLOT_SIZE CONFIG_MQTT_SAMPLE_TRIGGER_LINE_RING_SLOT_SIZE
+
+	struct line_ring_slot
+	{
+		/** Number of valid bytes in data. */
+		uint16_t len;
+
+		/** LINE_RING_FLAG_* */
+		uint8_t flags;
+
+		/** k_cycle_get_64() when the slot was committed. */
+		uint64_t timestamp;
+
+		char data[LINE_RING_SLOT_SIZE];
+	};
+
+	/**
+	 * @brief Single producer, single consumer ring of received lines.
+	 *
+	 * The producer (usually the UART interrupt handler) frames bytes directly into the slot at
+	 * the head of the ring and commits it when the delimiter is received. The consumer reads
+	 * committed slots at the tail. Neither side takes a lock, head is only written by the
+	 * producer and tail only by the consumer.
+	 */
+	struct line_ring
+	{
+		struct line_ring_slot slots[LINE_RING_DEPTH];
+		atomic_t head;
+		atomic_t tail;
+
+		/* Producer state */
+		uint16_t fill;
+		bool cont;
+		bool truncating;
+		bool discarding;
+
+		/* Statistics */
+		atomic_t lines;
+		atomic_t dropped;
+		atomic_t truncated;
+	};
+
+	/**
+	 * @brief Initializes an empty line ring.
+	 *
+	 * @param ring line ring
+	 */
+	void line_ring_init(struct line_ring *ring);
+
+	/**
+	 * @brief Frames one received byte into the ring. Producer side, ISR safe.
+	 *
+	 * A line that does not fit into one slot either spills into the following slots or is
+	 * truncated, depending on CONFIG_MQTT_SAMPLE_TRIGGER_LINE_RING_SPILL. If the ring is full
+	 * the line is dropped and counted.
+	 *
+	 * @param ring line ring
+	 * @param byte received byte
+	 * @param delimiter line delimiter
+	 *
+	 * @retval true if a complete line was committed.
+	 * @retval false otherwise.
+	 */
+	bool line_ring_put(struct line_ring *ring, uint8_t byte, uint8_t delimiter);
+
+	/**
+	 * @brief Returns the oldest committed slot. Consumer side.
+	 *
+	 * @param ring line ring
+	 *
+	 * @return Pointer to the slot or NULL if the ring is empty.
+	 */
+	struct line_ring_slot *line_ring_peek(struct line_ring *ring);
+
+	/**
+	 * @brief Hands the slot returned by line_ring_peek() back to the producer.
+	 *
+	 * @param ring line ring
+	 */
+	void line_ring_release(struct line_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LINE_RING_H__ */
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "nina_link.h"
+
+#define CRC_SEED 0xFFFF
+
+/* Streaming COBS encoder state */
+struct cobs_encoder
+{
+	uint8_t *out;
+	size_t out_size;
+	size_t code_pos;
+	size_t pos;
+	uint8_t code;
+};
+
+static int cobs_start(struct cobs_encoder *enc, uint8_t *out, size_t out_size)
+{
+	if (out_size < 1)
+	{
+		return -ENOMEM;
+	}
+
+	enc->out = out;
+	enc->out_size = out_size;
+	enc->code_pos = 0;
+	enc->pos = 1;
+	enc->code = 1;
+
+	return 0;
+}
+
+static int cobs_put(struct cobs_encoder *enc, const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		if (data[i] != 0)
+		{
+			if (enc->pos >= enc->out_size)
+			{
+				return -ENOMEM;
+			}
+			enc->out[enc->pos++] = data[i];
+			enc->code++;
+		}
+
+		if ((data[i] == 0) || (enc->code == 0xFF))
+		{
+			if (enc->pos >= enc->out_size)
+			{
+				return -ENOMEM;
+			}
+			enc->out[enc->code_pos] = enc->code;
+			enc->code_pos = enc->pos++;
+			enc->code = 1;
+		}
+	}
+
+	return 0;
+}
+
+static int cobs_finish(struct cobs_encoder *enc)
+{
+	if (enc->pos >= enc->out_size)
+	{
+		return -ENOMEM;
+	}
+
+	enc->out[enc->code_pos] = enc->code;
+	enc->out[enc->pos++] = NINA_LINK_DELIMITER;
+
+	return enc->pos;
+}
+
+int nina_link_frame_encode(uint8_t type, const uint8_t *payload, size_t len,
+						   uint8_t *out, size_t out_size)
+{
+	struct cobs_encoder enc;
+	uint8_t crc_le[2];
+	uint16_t crc;
+	int err;
+
+	crc = crc16_itu_t(CRC_SEED, &type, 1);
+	crc = crc16_itu_t(crc, payload, len);
+	sys_put_le16(crc, crc_le);
+
+	err = cobs_start(&enc, out, out_size);
+	if (err)
+	{
+		return err;
+	}
+
+	err = cobs_put(&enc, &type, 1);
+	if (err)
+	{
+		return err;
+	}
+
+	err = cobs_put(&enc, payload, len);
+	if (err)
+	{
+		return err;
+	}
+
+	err = cobs_put(&enc, crc_le, sizeof(crc_le));
+	if (err)
+	{
+		return err;
+	}
+
+	return cobs_finish(&enc);
+}
+
+static int cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size)
+{
+	size_t out_len = 0;
+	size_t i = 0;
+
+	while (i < len)
+	{
+		uint8_t code = in[i++];
+
+		if ((code == 0) || ((size_t)(code - 1) > len - i))
+		{
+			return -EINVAL;
+		}
+
+		if ((size_t)(code - 1) > out_size - out_len)
+		{
+			return -ENOMEM;
+		}
+
+		memcpy(&out[out_len], &in[i], code - 1);
+		out_len += code - 1;
+		i += code - 1;
+
+		/* A full block is not followed by an implicit zero, neither is the last block */
+		if ((code != 0xFF) && (i < len))
+		{
+			if (out_len >= out_size)
+			{
+				return -ENOMEM;
+			}
+			out[out_len++] = 0;
+		}
+	}
+
+	return out_len;
+}
+
+int nina_link_frame_decode(const uint8_t *frame, size_t len, uint8_t *out, size_t out_size,
+						   uint8_t *type, const uint8_t **payload)
+{
+	int decoded = cobs_decode(frame, len, out, out_size);
+
+	if (decoded < 0)
+	{
+		return decoded;
+	}
+
+	if (decoded < NINA_LINK_FRAME_OVERHEAD)
+	{
+		return -EINVAL;
+	}
+
+	decoded -= sizeof(uint16_t);
+
+	if (crc16_itu_t(CRC_SEED, out, decoded) != sys_get_le16(&out[decoded]))
+	{
+		return -EBADMSG;
+	}
+
+	*type = out[0];
+	*payload = &out[1];
+
+	return decoded - 1;
+}
+
+static int send(const struct nina_link_port *port, uint8_t type, const uint8_t *payload,
+				size_t len)
+{
+	uint8_t frame[NINA_LINK_ENCODED_SIZE(NINA_LINK_HELLO_SIZE)];
+	int frame_size = nina_link_frame_encode(type, payload, len, frame, sizeof(frame));
+
+	if (frame_size < 0)
+	{
+		return frame_size;
+	}
+
+	port->send(frame, frame_size);
+
+	return 0;
+}
+
+int nina_link_negotiate(const struct nina_link_port *port, uint32_t default_baudrate,
+						uint32_t baudrate, int32_t timeout_ms)
+{
+	uint8_t hello[NINA_LINK_HELLO_SIZE];
+	int err;
+
+	hello[0] = NINA_LINK_VERSION;
+	sys_put_le32(baudrate, &hello[1]);
+
+	err = send(port, NINA_LINK_FRAME_HELLO, hello, sizeof(hello));
+	if (err)
+	{
+		return err;
+	}
+
+	err = port->receive(NINA_LINK_FRAME_HELLO_ACK, hello, sizeof(hello), timeout_ms);
+	if (err < 0)
+	{
+		return -ETIMEDOUT;
+	}
+
+	if ((err < NINA_LINK_HELLO_SIZE) || (hello[0] != NINA_LINK_VERSION))
+	{
+		return -EPROTONOSUPPORT;
+	}
+
+	baudrate = MIN(sys_get_le32(&hello[1]), baudrate);
+	if (baudrate <= default_baudrate)
+	{
+		return default_baudrate;
+	}
+
+	err = port->baudrate_set(baudrate);
+	if (!err)
+	{
+		err = send(port, NINA_LINK_FRAME_PROBE, NULL, 0);
+	}
+
+	if (!err)
+	{
+		err = port->receive(NINA_LINK_FRAME_PROBE_ACK, NULL, 0, timeout_ms);
+	}
+
+	if (err < 0)
+	{
+		(void)port->baudrate_set(default_baudrate);
+		return -EIO;
+	}
+
+	return baudrate;
+}
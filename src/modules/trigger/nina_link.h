@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Binary framing of the Nina link.
+ *
+ * A frame consists of a type byte, the payload and a CRC16 (CRC-16/CCITT-FALSE, little endian)
+ * calculated over type and payload. The frame is COBS encoded and terminated by a 0x00 byte, so
+ * the delimiter never occurs inside a frame.
+ *
+ * Baud rate negotiation, initiated by the nRF91 at the default baud rate:
+ *  1. nRF91 sends HELLO with the protocol version and the highest baud rate it supports.
+ *  2. Nina answers HELLO_ACK with the baud rate both sides switch to. A Nina that does not
+ *     understand HELLO stays silent and the link keeps using newline delimited text.
+ *  3. Both sides switch, the nRF91 sends PROBE at the new baud rate and Nina answers PROBE_ACK.
+ *     If the PROBE exchange fails both sides return to the default baud rate and text mode.
+ *
+ * nina_link_negotiate() runs the nRF91 side of the handshake on top of a nina_link_port, so it
+ * does not depend on the UART driver.
+ */
+
+#ifndef NINA_LINK_H__
+#define NINA_LINK_H__
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define NINA_LINK_VERSION 1
+
+/** Frame delimiter */
+#define NINA_LINK_DELIMITER 0x00
+
+/** Type byte and CRC */
+#define NINA_LINK_FRAME_OVERHEAD 3
+
+/** Payload size of HELLO and HELLO_ACK */
+#define NINA_LINK_HELLO_SIZE 5
+
+/** Worst case encoded size of a frame with a payload of len bytes, including the delimiter. COBS
+ *  adds one code byte per started block of 254 bytes, and a trailing block of its own when the
+ *  frame ends exactly on a block boundary.
+ */
+#define NINA_LINK_ENCODED_SIZE(len) \
+	((len) + NINA_LINK_FRAME_OVERHEAD + ((len) + NINA_LINK_FRAME_OVERHEAD) / 254 + 1 + 1)
+
+	enum nina_link_frame_type
+	{
+		/** Payload is one JSON message, same content as one line in text mode. */
+		NINA_LINK_FRAME_DATA = 0x01,
+		/** Payload is the protocol version (1 byte) and a baud rate (4 bytes, LE). */
+		NINA_LINK_FRAME_HELLO = 0x10,
+		/** Payload is the protocol version (1 byte) and the agreed baud rate (4 bytes, LE). */
+		NINA_LINK_FRAME_HELLO_ACK = 0x11,
+		/** No payload. */
+		NINA_LINK_FRAME_PROBE = 0x12,
+		/** No payload. */
+		NINA_LINK_FRAME_PROBE_ACK = 0x13,
+	};
+
+	/**
+	 * @brief Builds a complete, COBS encoded frame including the trailing delimiter.
+	 *
+	 * @param type frame type
+	 * @param payload frame payload
+	 * @param len payload size
+	 * @param out output buffer
+	 * @param out_size size of the output buffer
+	 *
+	 * @return Number of bytes written to out.
+	 * @retval -ENOMEM if the output buffer is too small.
+	 */
+	int nina_link_frame_encode(uint8_t type, const uint8_t *payload, size_t len,
+							   uint8_t *out, size_t out_size);
+
+	/**
+	 * @brief Decodes and verifies one frame received without its delimiter.
+	 *
+	 * @param frame received frame
+	 * @param len size of the received frame
+	 * @param out buffer for the decoded frame, may not overlap frame
+	 * @param out_size size of the output buffer
+	 * @param type frame type
+	 * @param payload set to the start of the payload in out
+	 *
+	 * @return Payload size.
+	 * @retval -EINVAL if the frame is not valid COBS or too short.
+	 * @retval -ENOMEM if the output buffer is too small.
+	 * @retval -EBADMSG if the CRC does not match.
+	 */
+	int nina_link_frame_decode(const uint8_t *frame, size_t len, uint8_t *out, size_t out_size,
+							   uint8_t *type, const uint8_t **payload);
+
+	/**
+	 * @brief Access of the link negotiation to the UART.
+	 */
+	struct nina_link_port
+	{
+		/** Sends a complete, encoded frame. */
+		void (*send)(const uint8_t *frame, size_t len);
+
+		/**
+		 * Waits for a frame of the given type and copies at most size bytes of its payload.
+		 * Returns the payload size of the frame or a negative error code on timeout.
+		 */
+		int (*receive)(uint8_t type, uint8_t *payload, size_t size, int32_t timeout_ms);
+
+		/** Switches the UART to another baud rate. Returns 0 or a negative error code. */
+		int (*baudrate_set)(uint32_t baudrate);
+	};
+
+	/**
+	 * @brief Negotiates binary framing with the Nina module, see the handshake above. The link
+	 *	  is expected to run binary framing at the default baud rate when this is called.
+	 *
+	 * @param port access to the UART
+	 * @param default_baudrate baud rate the link currently runs at
+	 * @param baudrate highest baud rate to offer
+	 * @param timeout_ms time to wait for every answer
+	 *
+	 * @return Baud rate the binary link runs at.
+	 * @retval -ETIMEDOUT if Nina did not answer HELLO, the link stays at the default baud rate.
+	 * @retval -EPROTONOSUPPORT if Nina answered with another protocol version.
+	 * @retval -EIO if the link failed at the new baud rate, it is back at the default baud rate.
+	 * Text mode has to be used in all error cases.
+	 */
+	int nina_link_negotiate(const struct nina_link_port *port, uint32_t default_baudrate,
+							uint32_t baudrate, int32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NINA_LINK_H__ */
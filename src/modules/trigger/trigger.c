@@ -1,122 +1,1199 @@
-/*
- * Copyright (c) 2023 Nordic Semiconductor ASA
- *
- * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
- */
-
-#include <zephyr/kernel.h>
-#include <zephyr/logging/log.h>
-#include <zephyr/zbus/zbus.h>
-#include <zephyr/drivers/uart.h>
-
-#if CONFIG_DK_LIBRARY
-#include <dk_buttons_and_leds.h>
-#endif /* CONFIG_DK_LIBRARY */
-
-#include "message_channel.h"
-#define RX_BUF_SIZE 512
-
-static const struct device *const dev = DEVICE_DT_GET(DT_NODELABEL(uart0));
-
-#define UART_CFG                              \
-	((struct uart_config){                    \
-		.baudrate = 115200,                   \
-		.parity = UART_CFG_PARITY_NONE,       \
-		.stop_bits = UART_CFG_STOP_BITS_1,    \
-		.data_bits = UART_CFG_DATA_BITS_8,    \
-		.flow_ctrl = UART_CFG_FLOW_CTRL_NONE, \
-	})
-
-/* Register log module */
-LOG_MODULE_REGISTER(trigger, CONFIG_MQTT_SAMPLE_TRIGGER_LOG_LEVEL);
-struct velopera_payload payload = {0};
-int len;
-static struct k_sem uart_sem; // created semaphore
-uint8_t rx_byte;
-char rx_buf[RX_BUF_SIZE];
-static int index = 0;
-static void uart_handler(const struct device *dev, void *data)
-{
-
-	int err;
-	uart_fifo_read(dev, &rx_byte, 1);
-
-	if (rx_byte == '\n')
-	{
-		memset(payload.string, 0, sizeof(payload.string));
-		len = snprintk(payload.string, sizeof(payload.string), "%s", rx_buf);
-		//LOG_INF("line %d  rxbufTail=%d rxbuf=%s", __LINE__, index, rx_buf);
-		memset(rx_buf, 0, sizeof(rx_buf));
-
-		index = 0;
-	}
-	else if (index < RX_BUF_SIZE - 1)
-	{
-		rx_buf[index] = rx_byte;
-		index++;
-		// LOG_INF("line %d  rxbufTail=%d rxbuf=%s", __LINE__, index, rx_buf);
-	}
-	else
-	{
-		LOG_ERR("UART RX ERROR");
-		SEND_FATAL_ERROR();
-	}
-
-	k_sem_give(&uart_sem); // release semaphore for sleep mode
-}
-
-static int uart_init(void)
-{
-	k_sem_init(&uart_sem, 0, 1);
-	if (!device_is_ready(dev))
-	{
-		LOG_ERR("%s device not ready", dev->name);
-		return -ENODEV;
-	}
-
-	uart_irq_callback_user_data_set(dev, uart_handler, NULL);
-
-	struct uart_config uart_cfg = UART_CFG;
-	/* Configure UART parameters */
-	int err = uart_configure(dev, &uart_cfg);
-	if (err)
-	{
-		LOG_ERR("uart_configure, error: %d", err);
-		return err;
-	}
-	/* Enable RX interrupt */
-	uart_irq_rx_enable(dev);
-
-	return 0;
-}
-
-char *message_payload;
-static void trigger_task(void)
-{
-	int err = uart_init();
-	if (err)
-	{
-		LOG_ERR("uart_init, error: %d", err);
-		SEND_FATAL_ERROR();
-	}
-
-	while (true)
-	{
-		k_sem_take(&uart_sem, K_FOREVER); // take semaphore
-		if ((payload.string[0] != '\0' && strlen(payload.string) > 0))
-		{
-			err = zbus_chan_pub(&MQTT_CHAN, &payload, K_SECONDS(10));
-			if (err)
-			{
-				LOG_ERR("zbus_chan_pub, error:%d", err);
-				SEND_FATAL_ERROR();
-			}
-			memset(payload.string, 0, sizeof(payload.string));
-			LOG_INF("line %d",__LINE__);
-		}
-		//k_sleep(K_MINUTES(1));
-	}
-}
-K_THREAD_DEFINE(trigger_task_id,
-				CONFIG_MQTT_SAMPLE_TRIGGER_THREAD_STACK_SIZE,
-				trigger_task, NULL, NULL, NULL, 3, 0, 0);
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/zbus/zbus.h>
+#include <zephyr/drivers/uart.h>
+
+#if CONFIG_DK_LIBRARY
+#include <dk_buttons_and_leds.h>
+#endif /* CONFIG_DK_LIBRARY */
+
+#include "message_channel.h"
+#include "payload_buf.h"
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_IRQ)
+#include "line_ring.h"
+#else
+#include "line_framer.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_IRQ */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+#include "nina_link.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER)
+#include "json_minify.h"
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER)
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/pm/device.h>
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER */
+
+#define RX_BUF_SIZE 512
+
+#define ASCII_XON 0x11
+#define ASCII_XOFF 0x13
+
+static const struct device *const dev = DEVICE_DT_GET(DT_NODELABEL(uart0));
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_RTS_CTS)
+#define FLOW_CTRL UART_CFG_FLOW_CTRL_RTS_CTS
+#else
+#define FLOW_CTRL UART_CFG_FLOW_CTRL_NONE
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_RTS_CTS */
+
+#define UART_CFG                              \
+	((struct uart_config){                    \
+		.baudrate = 115200,                   \
+		.parity = UART_CFG_PARITY_NONE,       \
+		.stop_bits = UART_CFG_STOP_BITS_1,    \
+		.data_bits = UART_CFG_DATA_BITS_8,    \
+		.flow_ctrl = FLOW_CTRL,               \
+	})
+
+/* Register log module */
+LOG_MODULE_REGISTER(trigger, CONFIG_MQTT_SAMPLE_TRIGGER_LOG_LEVEL);
+static struct k_sem uart_sem; // created semaphore
+
+/* Set on every reception, used to detect an idle link */
+static atomic_t rx_activity;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_PREAMBLE)
+/* Set on wake-up until the first byte that is not a wake byte has been received */
+static atomic_t wake_filter;
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_PREAMBLE */
+
+/* Returns the number of wake bytes at the start of data that have to be skipped */
+static size_t wake_filter_skip(const uint8_t *data, size_t len)
+{
+	size_t skip = 0;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_PREAMBLE)
+	if (!atomic_get(&wake_filter))
+	{
+		return 0;
+	}
+
+	while ((skip < len) && (data[skip] == CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_BYTE))
+	{
+		skip++;
+	}
+
+	if (skip < len)
+	{
+		atomic_clear(&wake_filter);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_PREAMBLE */
+
+	return skip;
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+
+/* Received data handed over from the UART callback to trigger_task. The chunk points into one of
+ * the DMA buffers, which stays allocated until the driver has released it and trigger_task has
+ * framed every chunk that was received into it.
+ */
+struct rx_chunk
+{
+	uint8_t *buf;
+	size_t offset;
+	size_t len;
+	uint64_t timestamp;
+};
+
+K_MEM_SLAB_DEFINE_STATIC(rx_slab, CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_SIZE,
+						 CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_COUNT, 4);
+
+/* A buffer can produce several RX_RDY events (one per inactivity timeout), the release queue on
+ * the other hand never holds more entries than there are buffers.
+ */
+K_MSGQ_DEFINE(rx_chunk_queue, sizeof(struct rx_chunk),
+			  CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_COUNT * 4, 4);
+K_MSGQ_DEFINE(rx_release_queue, sizeof(uint8_t *),
+			  CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_COUNT, 4);
+
+/* Holds lines that cross a DMA buffer or chunk boundary */
+static char line_carry[RX_BUF_SIZE];
+static struct line_framer rx_framer;
+
+/* Timestamp of the chunk being framed, lines completed in it are stamped with it */
+static uint64_t rx_timestamp;
+static void framer_line_cb(const char *line, size_t line_size, void *user_data);
+static atomic_t rx_disabled;
+static atomic_t rx_chunks_dropped;
+static uint32_t rx_chunks_lost;
+
+/* Keeps reception disabled, e.g. while the baud rate is changed */
+static atomic_t rx_hold;
+
+/* Set while backpressure stops reception */
+static atomic_t rx_throttled;
+
+/* Set while the UART is suspended */
+static atomic_t rx_suspended;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+/* Binary framing is used while the link negotiation is running and after it succeeded */
+static bool link_binary;
+
+/* Last handshake answer received since the last frame was sent, type 0 if none */
+static uint8_t link_ack_type;
+static uint8_t link_ack[NINA_LINK_HELLO_SIZE];
+static int link_ack_len;
+static uint8_t frame_buf[RX_BUF_SIZE];
+
+static uint32_t frames_received;
+static uint32_t frames_crc_errors;
+static uint32_t frames_invalid;
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+static int rx_enable(void)
+{
+	uint8_t *buf;
+	int err = k_mem_slab_alloc(&rx_slab, (void **)&buf, K_NO_WAIT);
+
+	if (err)
+	{
+		return err;
+	}
+
+	err = uart_rx_enable(dev, buf, CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_SIZE,
+						 CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_RX_TIMEOUT_US);
+	if (err)
+	{
+		k_mem_slab_free(&rx_slab, (void *)buf);
+	}
+
+	return err;
+}
+
+static void uart_handler(const struct device *dev, struct uart_event *evt, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	uint8_t *buf;
+
+	switch (evt->type)
+	{
+	case UART_RX_BUF_REQUEST:
+		/* Hand the next buffer to the driver so that DMA continues seamlessly when the
+		 * current one is full. If the slab is exhausted the driver stops reception once the
+		 * current buffer is full and trigger_task restarts it when buffers are freed.
+		 */
+		if (k_mem_slab_alloc(&rx_slab, (void **)&buf, K_NO_WAIT) == 0)
+		{
+			if (uart_rx_buf_rsp(dev, buf, CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_SIZE))
+			{
+				k_mem_slab_free(&rx_slab, (void *)buf);
+			}
+		}
+		break;
+	case UART_RX_RDY:
+	{
+		struct rx_chunk chunk = {
+			.buf = evt->data.rx.buf,
+			.offset = evt->data.rx.offset,
+			.len = evt->data.rx.len,
+			.timestamp = k_cycle_get_64(),
+		};
+
+		if (k_msgq_put(&rx_chunk_queue, &chunk, K_NO_WAIT))
+		{
+			atomic_inc(&rx_chunks_dropped);
+		}
+
+		atomic_set(&rx_activity, 1);
+		k_sem_give(&uart_sem);
+		break;
+	}
+	case UART_RX_BUF_RELEASED:
+		buf = evt->data.rx_buf.buf;
+
+		/* Cannot fail, there are never more released buffers than buffers in the slab. */
+		(void)k_msgq_put(&rx_release_queue, &buf, K_NO_WAIT);
+		k_sem_give(&uart_sem);
+		break;
+	case UART_RX_DISABLED:
+		atomic_set(&rx_disabled, 1);
+		k_sem_give(&uart_sem);
+		break;
+	case UART_RX_STOPPED:
+		LOG_WRN("UART RX stopped, reason: %d", evt->data.rx_stop.reason);
+		break;
+	default:
+		break;
+	}
+}
+
+#else
+
+/* Lines framed by the interrupt handler, consumed by trigger_task */
+static struct line_ring rx_ring;
+
+/* Line currently being read out of rx_ring, NULL while the rest of a line is skipped */
+static struct net_buf *rx_line;
+static bool rx_line_truncated;
+static uint32_t lines_incomplete;
+static uint32_t lines_truncated;
+
+static void uart_handler(const struct device *dev, void *data)
+{
+	ARG_UNUSED(data);
+
+	uint8_t rx_data[16];
+	bool line_complete = false;
+	int count;
+
+	while (uart_irq_update(dev) && uart_irq_rx_ready(dev))
+	{
+		count = uart_fifo_read(dev, rx_data, sizeof(rx_data));
+		if (count <= 0)
+		{
+			continue;
+		}
+
+		atomic_set(&rx_activity, 1);
+
+		for (int i = wake_filter_skip(rx_data, count); i < count; i++)
+		{
+			line_complete |= line_ring_put(&rx_ring, rx_data[i], '\n');
+		}
+	}
+
+	/* Wake trigger_task once per completed line, not per byte */
+	if (line_complete)
+	{
+		k_sem_give(&uart_sem);
+	}
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+
+static int uart_init(void)
+{
+	k_sem_init(&uart_sem, 0, 1);
+	if (!device_is_ready(dev))
+	{
+		LOG_ERR("%s device not ready", dev->name);
+		return -ENODEV;
+	}
+
+	struct uart_config uart_cfg = UART_CFG;
+	/* Configure UART parameters */
+	int err = uart_configure(dev, &uart_cfg);
+	if (err)
+	{
+		LOG_ERR("uart_configure, error: %d", err);
+		return err;
+	}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+	line_framer_init(&rx_framer, '\n', line_carry, sizeof(line_carry), framer_line_cb, NULL);
+
+	err = uart_callback_set(dev, uart_handler, NULL);
+	if (err)
+	{
+		LOG_ERR("uart_callback_set, error: %d", err);
+		return err;
+	}
+
+	/* Start DMA reception, the second buffer is provided on UART_RX_BUF_REQUEST */
+	err = rx_enable();
+	if (err)
+	{
+		LOG_ERR("uart_rx_enable, error: %d", err);
+		return err;
+	}
+#else
+	line_ring_init(&rx_ring);
+	uart_irq_callback_user_data_set(dev, uart_handler, NULL);
+
+	/* Enable RX interrupt */
+	uart_irq_rx_enable(dev);
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+
+	return 0;
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER)
+
+/* JSON filter statistics, the difference of bytes in and out is the saving */
+static uint32_t json_bytes_in;
+static uint32_t json_bytes_out;
+static uint32_t json_rejects;
+static uint64_t json_cycles;
+
+/* Validates and minifies the line in place. Returns false if the line has to be dropped. */
+static bool payload_filter(struct net_buf *buf)
+{
+	size_t len = buf->len;
+	uint32_t start = k_cycle_get_32();
+	int minified = json_minify((char *)buf->data, len);
+
+	json_cycles += k_cycle_get_32() - start;
+	json_bytes_in += len;
+
+	if (minified < 0)
+	{
+		json_rejects++;
+		LOG_WRN("Invalid JSON line dropped (%d), %d in total", minified, json_rejects);
+		return false;
+	}
+
+	net_buf_remove_mem(buf, len - minified);
+	json_bytes_out += minified;
+
+	LOG_DBG("JSON filter: %d bytes in, %d bytes out, %d rejects, %d us", json_bytes_in,
+			json_bytes_out, json_rejects, (int)k_cyc_to_us_floor64(json_cycles));
+
+	return true;
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_TYPED_DATA)
+
+static uint32_t typed_messages;
+static uint32_t untyped_messages;
+static uint32_t mixed_messages;
+static uint32_t mixed_members;
+
+/* Publishes the signals of the line on NINA_DATA_CHAN. Returns true if the line carried known
+ * signals only.
+ */
+static bool publish_typed(struct net_buf *buf)
+{
+	struct velopera_nina_data data = {
+		.timestamp = payload_buf_timestamp(buf),
+	};
+	uint32_t others;
+	int found = nina_data_parse((const char *)buf->data, buf->len, &data, &others);
+	int err;
+
+	if (found <= 0)
+	{
+		untyped_messages++;
+		LOG_DBG("No known signals in line, %d in total", untyped_messages);
+		return false;
+	}
+
+	typed_messages++;
+
+	err = zbus_chan_pub(&NINA_DATA_CHAN, &data, K_SECONDS(10));
+	if (err)
+	{
+		LOG_ERR("zbus_chan_pub, error:%d", err);
+		SEND_FATAL_ERROR();
+	}
+
+	if (others > 0)
+	{
+		mixed_messages++;
+		mixed_members += others;
+		LOG_DBG("Line with %d other members published as received, %d lines and %d members "
+				"in total",
+				others, mixed_messages, mixed_members);
+		return false;
+	}
+
+	return true;
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_TYPED_DATA */
+
+/* Lines dropped because the payload buffer pool was full */
+static uint32_t payload_buf_drops;
+
+/* Lines published on MQTT_CHAN, and lines published on NINA_DATA_CHAN alone */
+static uint32_t lines_published;
+static uint32_t lines_typed;
+
+static void payload_buf_drop(void)
+{
+	payload_buf_drops++;
+	LOG_WRN("Payload buffers full, line dropped, %d in total", payload_buf_drops);
+}
+
+/* Publishes a line written into a payload buffer on MQTT_CHAN as reference to the buffer, and
+ * releases the buffer.
+ *
+ * @param buf buffer returned by payload_buf_get() holding the line
+ * @param timestamp uptime in hardware cycles when the line was completely received
+ */
+static void publish_payload(struct net_buf *buf, uint64_t timestamp)
+{
+	int err;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER)
+	if (!payload_filter(buf))
+	{
+		net_buf_unref(buf);
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER */
+
+	payload_buf_finish(buf, timestamp);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_TYPED_DATA)
+	/* The aggregator or the transport time series publish the signals. Lines with other
+	 * members go out as received as well, so that those members are not lost.
+	 */
+	if (publish_typed(buf) && (IS_ENABLED(CONFIG_MQTT_SAMPLE_AGGREGATOR) ||
+							   IS_ENABLED(CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES)))
+	{
+		lines_typed++;
+		net_buf_unref(buf);
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_TYPED_DATA */
+
+	err = zbus_chan_pub(&MQTT_CHAN, &buf, K_SECONDS(10));
+	net_buf_unref(buf);
+	if (err)
+	{
+		LOG_ERR("zbus_chan_pub, error:%d", err);
+		SEND_FATAL_ERROR();
+		return;
+	}
+
+	lines_published++;
+}
+
+/* Publishes the line counters on TRIGGER_STATS_CHAN if they changed */
+static void stats_publish(void)
+{
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_STATS)
+	static struct velopera_trigger_stats published;
+	struct velopera_trigger_stats stats = {
+		.published = lines_published,
+		.typed = lines_typed,
+		.payload_buf_drops = payload_buf_drops,
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER)
+		.json_rejects = json_rejects,
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_JSON_FILTER */
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+		.rx_dropped = rx_framer.overruns + rx_chunks_lost,
+#else
+		.rx_dropped = atomic_get(&rx_ring.dropped),
+		.incomplete = lines_incomplete,
+		.truncated = atomic_get(&rx_ring.truncated) + lines_truncated,
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+	};
+	int err;
+
+	if (memcmp(&stats, &published, sizeof(stats)) == 0)
+	{
+		return;
+	}
+
+	err = zbus_chan_pub(&TRIGGER_STATS_CHAN, &stats, K_SECONDS(10));
+	if (err)
+	{
+		LOG_ERR("zbus_chan_pub, error:%d", err);
+		SEND_FATAL_ERROR();
+		return;
+	}
+
+	published = stats;
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_STATS */
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+
+/**
+ * @brief Publishes one complete line from the Nina module on MQTT_CHAN.
+ *
+ * @param line received line, not including the delimiter
+ * @param line_size number of characters in the line
+ */
+static void publish_line(const char *line, size_t line_size)
+{
+	struct net_buf *buf;
+
+	if (line_size == 0)
+	{
+		return;
+	}
+
+	line_size = MIN(line_size, PAYLOAD_BUF_LINE_MAX);
+
+	buf = payload_buf_get(line_size);
+	if (buf == NULL)
+	{
+		payload_buf_drop();
+		return;
+	}
+
+	net_buf_add_mem(buf, line, line_size);
+	publish_payload(buf, rx_timestamp);
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+
+static void frame_received(const char *frame, size_t frame_size)
+{
+	uint8_t type;
+	const uint8_t *data;
+	int len = nina_link_frame_decode((const uint8_t *)frame, frame_size, frame_buf,
+									 sizeof(frame_buf), &type, &data);
+
+	if (len == -EBADMSG)
+	{
+		frames_crc_errors++;
+		LOG_WRN("Frame with bad CRC dropped, %d in total", frames_crc_errors);
+		return;
+	}
+	else if (len < 0)
+	{
+		frames_invalid++;
+		return;
+	}
+
+	frames_received++;
+
+	switch (type)
+	{
+	case NINA_LINK_FRAME_DATA:
+		publish_line((const char *)data, len);
+		break;
+	case NINA_LINK_FRAME_HELLO_ACK:
+	case NINA_LINK_FRAME_PROBE_ACK:
+		link_ack_len = len;
+		memcpy(link_ack, data, MIN(len, sizeof(link_ack)));
+		link_ack_type = type;
+		break;
+	default:
+		frames_invalid++;
+		break;
+	}
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+static void framer_line_cb(const char *line, size_t line_size, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+	if (link_binary)
+	{
+		frame_received(line, line_size);
+		return;
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+	publish_line(line, line_size);
+}
+
+static void frame_pending_chunks(void)
+{
+	struct rx_chunk chunk;
+
+	size_t skip;
+
+	while (k_msgq_get(&rx_chunk_queue, &chunk, K_NO_WAIT) == 0)
+	{
+		skip = wake_filter_skip(chunk.buf + chunk.offset, chunk.len);
+		rx_timestamp = chunk.timestamp;
+		line_framer_feed(&rx_framer, chunk.buf + chunk.offset + skip, chunk.len - skip);
+	}
+}
+
+static void rx_process(void)
+{
+	uint8_t *buf;
+	atomic_val_t dropped;
+
+	frame_pending_chunks();
+
+	/* Chunks of a buffer are always queued before the buffer is released, so draining the
+	 * chunk queue once more guarantees that nothing points into the buffer when it is freed.
+	 */
+	while (k_msgq_get(&rx_release_queue, &buf, K_NO_WAIT) == 0)
+	{
+		frame_pending_chunks();
+		k_mem_slab_free(&rx_slab, (void *)buf);
+	}
+
+	dropped = atomic_clear(&rx_chunks_dropped);
+	if (dropped)
+	{
+		rx_chunks_lost += dropped;
+		LOG_WRN("%d RX chunks dropped, framing resynchronised", (int)dropped);
+		line_framer_reset(&rx_framer);
+	}
+
+	if (!atomic_get(&rx_hold) && !atomic_get(&rx_throttled) && !atomic_get(&rx_suspended) &&
+		atomic_cas(&rx_disabled, 1, 0))
+	{
+		int err = rx_enable();
+
+		if (err)
+		{
+			LOG_ERR("uart_rx_enable, error: %d", err);
+			atomic_set(&rx_disabled, 1);
+		}
+	}
+
+	LOG_DBG("lines received: %d, lines overrun: %d", rx_framer.lines, rx_framer.overruns);
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+	LOG_DBG("frames received: %d, CRC errors: %d, invalid: %d", frames_received,
+			frames_crc_errors, frames_invalid);
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+	stats_publish();
+}
+
+/* Stops reception and processes everything received until the driver reports RX_DISABLED. The
+ * caller sets rx_hold or rx_suspended beforehand so that rx_process() does not restart it.
+ */
+static void rx_stop(void)
+{
+	int64_t deadline;
+	int err;
+
+	err = uart_rx_disable(dev);
+	if (err && (err != -EFAULT))
+	{
+		LOG_ERR("uart_rx_disable, error: %d", err);
+	}
+
+	deadline = k_uptime_get() + 100;
+	while (!atomic_get(&rx_disabled) && (k_uptime_get() < deadline))
+	{
+		(void)k_sem_take(&uart_sem, K_MSEC(10));
+		rx_process();
+	}
+}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+
+static void link_send(const uint8_t *frame, size_t len)
+{
+	link_ack_type = 0;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		uart_poll_out(dev, frame[i]);
+	}
+}
+
+/* Processes received data until an answer of the given type arrived or the timeout expires */
+static int link_receive(uint8_t type, uint8_t *data, size_t size, int32_t timeout_ms)
+{
+	int64_t deadline = k_uptime_get() + timeout_ms;
+	int64_t remaining;
+
+	while (link_ack_type != type)
+	{
+		remaining = deadline - k_uptime_get();
+		if (remaining <= 0)
+		{
+			return -ETIMEDOUT;
+		}
+
+		(void)k_sem_take(&uart_sem, K_MSEC(remaining));
+		rx_process();
+	}
+
+	if (size > 0)
+	{
+		memcpy(data, link_ack, MIN(size, MIN(link_ack_len, sizeof(link_ack))));
+	}
+
+	return link_ack_len;
+}
+
+static int link_baudrate_set(uint32_t baudrate)
+{
+	struct uart_config uart_cfg = UART_CFG;
+	int err;
+
+	uart_cfg.baudrate = baudrate;
+
+	/* Reception has to be stopped while the UART is reconfigured */
+	atomic_set(&rx_hold, 1);
+	rx_stop();
+
+	err = uart_configure(dev, &uart_cfg);
+	if (err)
+	{
+		LOG_ERR("uart_configure, error: %d", err);
+	}
+
+	atomic_set(&rx_hold, 0);
+	line_framer_restart(&rx_framer, NINA_LINK_DELIMITER);
+	rx_process();
+
+	return err;
+}
+
+/* Tries to switch the Nina link to binary framing at CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK_BAUDRATE.
+ * Falls back to newline delimited text at the default baud rate if the Nina module does not
+ * support it.
+ */
+static void link_negotiate(void)
+{
+	static const struct nina_link_port port = {
+		.send = link_send,
+		.receive = link_receive,
+		.baudrate_set = link_baudrate_set,
+	};
+	int baudrate;
+
+	link_binary = true;
+	line_framer_restart(&rx_framer, NINA_LINK_DELIMITER);
+
+	baudrate = nina_link_negotiate(&port, UART_CFG.baudrate,
+								   CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK_BAUDRATE,
+								   CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK_TIMEOUT_MS);
+	if (baudrate > 0)
+	{
+		LOG_INF("Nina link: binary framing at %d baud", baudrate);
+		return;
+	}
+
+	if (baudrate == -EIO)
+	{
+		LOG_WRN("Nina link: no answer at the negotiated baud rate, using text mode");
+	}
+	else
+	{
+		LOG_INF("Nina link: not supported, using text mode");
+	}
+
+	link_binary = false;
+	line_framer_restart(&rx_framer, '\n');
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+#else
+
+/* Drains every line queued in rx_ring. The slots of a line are added to its payload buffer
+ * directly, a line that spilled over several slots gets room for the longest line.
+ */
+static void rx_process(void)
+{
+	struct line_ring_slot *slot;
+	static atomic_val_t dropped_reported;
+	atomic_val_t dropped;
+
+	while ((slot = line_ring_peek(&rx_ring)) != NULL)
+	{
+		if (!(slot->flags & LINE_RING_FLAG_CONT))
+		{
+			if (rx_line != NULL)
+			{
+				/* The rest of the previous line was dropped by the producer */
+				lines_incomplete++;
+				net_buf_unref(rx_line);
+			}
+
+			rx_line = payload_buf_get((slot->flags & LINE_RING_FLAG_MORE) ? PAYLOAD_BUF_LINE_MAX
+																	   : slot->len);
+			rx_line_truncated = false;
+
+			if (rx_line == NULL)
+			{
+				payload_buf_drop();
+			}
+		}
+
+		if (rx_line == NULL)
+		{
+			line_ring_release(&rx_ring);
+			continue;
+		}
+
+		size_t copy = MIN(slot->len, payload_buf_room(rx_line));
+
+		if (copy < slot->len)
+		{
+			/* Spilled line longer than the payload buffer */
+			rx_line_truncated = true;
+		}
+
+		net_buf_add_mem(rx_line, slot->data, copy);
+
+		if (!(slot->flags & LINE_RING_FLAG_MORE))
+		{
+			lines_truncated += rx_line_truncated;
+			publish_payload(rx_line, slot->timestamp);
+			rx_line = NULL;
+		}
+
+		line_ring_release(&rx_ring);
+	}
+
+	dropped = atomic_get(&rx_ring.dropped);
+	if (dropped != dropped_reported)
+	{
+		LOG_WRN("RX line ring full, %d lines dropped in total", (int)dropped);
+		dropped_reported = dropped;
+	}
+
+	LOG_DBG("lines received: %d, dropped: %d, truncated: %d, incomplete: %d",
+			(int)atomic_get(&rx_ring.lines), (int)dropped,
+			(int)atomic_get(&rx_ring.truncated) + lines_truncated, lines_incomplete);
+
+	stats_publish();
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+
+/* Backpressure towards the Nina module, driven by the fill level of the transport queue. The
+ * queue status is published from several transport contexts.
+ */
+static K_MUTEX_DEFINE(throttle_lock);
+static bool throttled;
+static int64_t throttle_start;
+static int64_t throttled_ms_total;
+static uint32_t throttle_count;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER)
+/* Set with throttle_lock held while the UART is suspended or being suspended. Backpressure does
+ * not touch the UART meanwhile, uart_rx_restart() applies its state.
+ */
+static atomic_t uart_suspended;
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER */
+
+static inline bool link_suspended(void)
+{
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER)
+	return atomic_get(&uart_suspended);
+#else
+	return false;
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER */
+}
+
+/* Called with throttle_lock held */
+static void link_throttle(bool enable)
+{
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_RTS_CTS)
+	/* Stop draining the receiver, the UART deasserts RTS as soon as its FIFO is full */
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+	if (enable)
+	{
+		atomic_set(&rx_throttled, 1);
+		if (!link_suspended())
+		{
+			(void)uart_rx_disable(dev);
+		}
+	}
+	else
+	{
+		/* trigger_task restarts reception */
+		atomic_set(&rx_throttled, 0);
+		k_sem_give(&uart_sem);
+	}
+#else
+	if (link_suspended())
+	{
+		return;
+	}
+
+	if (enable)
+	{
+		uart_irq_rx_disable(dev);
+	}
+	else
+	{
+		uart_irq_rx_enable(dev);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+#elif defined(CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_XON_XOFF)
+	if (!link_suspended())
+	{
+		uart_poll_out(dev, enable ? ASCII_XOFF : ASCII_XON);
+	}
+#endif
+}
+
+static void backpressure_callback(const struct zbus_channel *chan)
+{
+	const struct velopera_queue_status *status;
+	int64_t now;
+
+	if (IS_ENABLED(CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_NONE) || (&QUEUE_STATUS_CHAN != chan))
+	{
+		return;
+	}
+
+	status = zbus_chan_const_msg(chan);
+	now = k_uptime_get();
+
+	k_mutex_lock(&throttle_lock, K_FOREVER);
+
+	if (!throttled &&
+		(status->used * 100 >= status->capacity * CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_HIGH_WATERMARK))
+	{
+		throttled = true;
+		throttle_start = now;
+		throttle_count++;
+		link_throttle(true);
+
+		LOG_DBG("Nina link throttled, queue %d/%d", status->used, status->capacity);
+	}
+	else if (throttled &&
+			 (status->used * 100 <= status->capacity * CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_LOW_WATERMARK))
+	{
+		throttled = false;
+		throttled_ms_total += now - throttle_start;
+		link_throttle(false);
+
+		LOG_INF("Nina link released after %d ms, throttled %d times for %d ms in total",
+				(int)(now - throttle_start), throttle_count, (int)throttled_ms_total);
+	}
+
+	k_mutex_unlock(&throttle_lock);
+}
+
+/* Register listener - backpressure_callback is called everytime the transport queue fill level
+ * changes.
+ */
+ZBUS_LISTENER_DEFINE(trigger, backpressure_callback);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER)
+
+BUILD_ASSERT(DT_NODE_HAS_PROP(DT_PATH(zephyr_user), nina_wake_gpios),
+			 "Low power mode requires the nina-wake-gpios property in the zephyr,user node");
+
+static const struct gpio_dt_spec wake_gpio = GPIO_DT_SPEC_GET(DT_PATH(zephyr_user), nina_wake_gpios);
+static struct gpio_callback wake_cb;
+
+/* Set by the wake interrupt, the UART is resumed by trigger_task */
+static atomic_t uart_wake_pending;
+
+/* UART-on time accounting, only accessed by trigger_task */
+static int64_t uart_on_since;
+static int64_t uart_off_since;
+static int64_t uart_on_ms_total;
+static int64_t uart_off_ms_total;
+static uint32_t uart_wakeups;
+
+/* Restarts reception once the UART is resumed, or failed to suspend, and applies the
+ * backpressure state of the meantime
+ */
+static void uart_rx_restart(void)
+{
+	k_mutex_lock(&throttle_lock, K_FOREVER);
+
+	atomic_set(&uart_suspended, 0);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+	atomic_set(&rx_suspended, 0);
+	if (!atomic_get(&rx_throttled) && atomic_cas(&rx_disabled, 1, 0) && rx_enable())
+	{
+		atomic_set(&rx_disabled, 1);
+	}
+#else
+	if (!IS_ENABLED(CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_RTS_CTS) || !throttled)
+	{
+		uart_irq_rx_enable(dev);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_XON_XOFF)
+	/* The UART is only suspended while the link is released */
+	if (throttled)
+	{
+		uart_poll_out(dev, ASCII_XOFF);
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BACKPRESSURE_XON_XOFF */
+
+	k_mutex_unlock(&throttle_lock);
+}
+
+static void uart_resume(void)
+{
+	int err = pm_device_action_run(dev, PM_DEVICE_ACTION_RESUME);
+
+	if (err && (err != -EALREADY))
+	{
+		LOG_ERR("pm_device_action_run, error: %d", err);
+	}
+
+	uart_on_since = k_uptime_get();
+	uart_wakeups++;
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_PREAMBLE)
+	atomic_set(&wake_filter, 1);
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_WAKE_PREAMBLE */
+
+	/* Restart reception right away, the first frame is already on its way */
+	uart_rx_restart();
+}
+
+/* Resuming the UART driver is not allowed in interrupt context, trigger_task does it */
+static void wake_handler(const struct device *port, struct gpio_callback *cb, gpio_port_pins_t pins)
+{
+	ARG_UNUSED(port);
+	ARG_UNUSED(cb);
+	ARG_UNUSED(pins);
+
+	(void)gpio_pin_interrupt_configure_dt(&wake_gpio, GPIO_INT_DISABLE);
+	atomic_set(&uart_wake_pending, 1);
+	k_sem_give(&uart_sem);
+}
+
+static int uart_wake_init(void)
+{
+	int err;
+
+	if (!gpio_is_ready_dt(&wake_gpio))
+	{
+		LOG_ERR("%s device not ready", wake_gpio.port->name);
+		return -ENODEV;
+	}
+
+	gpio_init_callback(&wake_cb, wake_handler, BIT(wake_gpio.pin));
+
+	err = gpio_add_callback(wake_gpio.port, &wake_cb);
+	if (err)
+	{
+		LOG_ERR("gpio_add_callback, error: %d", err);
+		return err;
+	}
+
+	uart_on_since = k_uptime_get();
+
+	return 0;
+}
+
+/* Suspends the UART once nothing has been received for a whole idle period */
+static void uart_suspend_if_idle(void)
+{
+	int64_t now;
+	int err;
+
+	k_mutex_lock(&throttle_lock, K_FOREVER);
+
+	if (atomic_clear(&rx_activity) || throttled)
+	{
+		k_mutex_unlock(&throttle_lock);
+		return;
+	}
+
+	atomic_set(&uart_suspended, 1);
+	k_mutex_unlock(&throttle_lock);
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+	atomic_set(&rx_suspended, 1);
+	rx_stop();
+	line_framer_restart(&rx_framer, rx_framer.delimiter);
+#else
+	uart_irq_rx_disable(dev);
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+
+	err = pm_device_action_run(dev, PM_DEVICE_ACTION_SUSPEND);
+	if (err)
+	{
+		LOG_ERR("pm_device_action_run, error: %d", err);
+		uart_rx_restart();
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC)
+		rx_process();
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_UART_ASYNC */
+		return;
+	}
+
+	now = k_uptime_get();
+	uart_on_ms_total += now - uart_on_since;
+	uart_off_since = now;
+
+	/* The UART released the RX pin, watch it for the next activity */
+	err = gpio_pin_configure_dt(&wake_gpio, GPIO_INPUT);
+	if (!err)
+	{
+		err = gpio_pin_interrupt_configure_dt(&wake_gpio, GPIO_INT_EDGE_TO_ACTIVE);
+	}
+
+	if (err)
+	{
+		LOG_ERR("Configuring the wake GPIO failed, error: %d", err);
+		uart_resume();
+		return;
+	}
+
+	LOG_INF("Nina UART suspended, on for %d ms, suspended for %d ms in total, %d wake-ups",
+			(int)uart_on_ms_total, (int)uart_off_ms_total, uart_wakeups);
+}
+
+/* Resumes the UART after a wake interrupt and accounts the time it was suspended */
+static void uart_wake(void)
+{
+	if (atomic_clear(&uart_wake_pending) && atomic_get(&uart_suspended))
+	{
+		uart_resume();
+	}
+
+	if (uart_off_since && !atomic_get(&uart_suspended))
+	{
+		uart_off_ms_total += uart_on_since - uart_off_since;
+		uart_off_since = 0;
+
+		LOG_DBG("Nina UART woken up, on for %d ms, suspended for %d ms in total",
+				(int)uart_on_ms_total, (int)uart_off_ms_total);
+	}
+}
+
+static k_timeout_t uart_idle_timeout(void)
+{
+	return atomic_get(&uart_suspended) ? K_FOREVER
+									   : K_MSEC(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER_IDLE_MS);
+}
+
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER */
+
+char *message_payload;
+static void trigger_task(void)
+{
+	int err = uart_init();
+	if (err)
+	{
+		LOG_ERR("uart_init, error: %d", err);
+		SEND_FATAL_ERROR();
+	}
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK)
+	link_negotiate();
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_BINARY_LINK */
+
+#if defined(CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER)
+	err = uart_wake_init();
+	if (err)
+	{
+		LOG_ERR("uart_wake_init, error: %d", err);
+		SEND_FATAL_ERROR();
+	}
+
+	while (true)
+	{
+		if (k_sem_take(&uart_sem, uart_idle_timeout()) == -EAGAIN)
+		{
+			uart_suspend_if_idle();
+			continue;
+		}
+
+		uart_wake();
+		rx_process();
+	}
+#else
+	while (true)
+	{
+		k_sem_take(&uart_sem, K_FOREVER); // take semaphore
+		rx_process();
+		//k_sleep(K_MINUTES(1));
+	}
+#endif /* CONFIG_MQTT_SAMPLE_TRIGGER_LOW_POWER */
+}
+K_THREAD_DEFINE(trigger_task_id,
+				CONFIG_MQTT_SAMPLE_TRIGGER_THREAD_STACK_SIZE,
+				trigger_task, NULL, NULL, NULL, 3, 0, 0);
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Timing of the native_posix benchmarks.
+ *
+ * native_posix runs code in zero simulated time, so the benchmarks measure the host CPU time of
+ * the process instead, like the replay harness. Results compare implementations on the same
+ * host, they are no cycle counts of the nRF91.
+ */
+
+#ifndef BENCH_H__
+#define BENCH_H__
+
+#include <time.h>
+#include <zephyr/kernel.h>
+
+/** Host CPU time of the test process in ns */
+static inline int64_t bench_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+#endif /* BENCH_H__ */
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* fixed_format() and gnss_json_format() against snprintf() with %.*f and the former
+ * GNSS_DATA_JSON format: rounding ties, negative zero, subnormals, the limits of the supported
+ * range and random readings, and the time per reading of both.
+ */
+
+#include <stdio.h>
+#include <zephyr/ztest.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "bench.h"
+#include "fixed_format.h"
+#include "gps_trace.h"
+
+#define RANDOM_VALUES 1000000
+#define RANDOM_FIXES 100000
+#define BENCH_VALUES 100000
+
+static uint64_t rand_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rand64(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 7;
+	rand_state ^= rand_state << 17;
+
+	return rand_state;
+}
+
+static double from_bits(uint64_t bits)
+{
+	double value;
+
+	memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+static uint64_t to_bits(double value)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &value, sizeof(bits));
+
+	return bits;
+}
+
+static void check(double value, uint8_t decimals)
+{
+	char expected[64];
+	char text[64];
+	int len;
+
+	snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+	len = fixed_format(text, sizeof(text), value, decimals);
+
+	zassert_equal(len, strlen(expected), "%.17g with %u decimals", value, decimals);
+	zassert_mem_equal(text, expected, strlen(expected) + 1, "%.17g with %u decimals", value, decimals);
+}
+
+static void check_all_decimals(double value)
+{
+	for (uint8_t decimals = 0; decimals <= FIXED_FORMAT_MAX_DECIMALS; decimals++)
+	{
+		check(value, decimals);
+	}
+}
+
+ZTEST(fixed_format, test_values)
+{
+	static const double values[] = {
+		0.0, 1.0, 0.5, 1.5, 2.5, 0.125, 0.375, 0.625, 2.675, 1.005, 1.115, 0.045, 9.995,
+		99.95, 0.05, 0.15, 0.25, 0.35, 0.1, 0.2, 0.3, 0.7, 123456.789, 63.430515, 10.395053,
+		359.95, 1e-9, 5e-10, 4.9999999999e-10, 1e-300, 999999999.9999999995, 9007199254.5,
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(values); i++)
+	{
+		check_all_decimals(values[i]);
+		check_all_decimals(-values[i]);
+	}
+}
+
+/* Negative readings that round to zero, and -0.0 itself, keep the sign */
+ZTEST(fixed_format, test_negative_zero)
+{
+	char text[16];
+
+	zassert_equal(fixed_format(text, sizeof(text), -0.0, 2), 5);
+	zassert_mem_equal(text, "-0.00", sizeof("-0.00"));
+
+	zassert_equal(fixed_format(text, sizeof(text), -0.004, 2), 5);
+	zassert_mem_equal(text, "-0.00", sizeof("-0.00"));
+
+	zassert_equal(fixed_format(text, sizeof(text), 0.0, 0), 1);
+	zassert_mem_equal(text, "0", sizeof("0"));
+
+	check_all_decimals(-0.0);
+}
+
+/* Exact binary ties, k / 2^n, are rounded to even */
+ZTEST(fixed_format, test_ties)
+{
+	for (int n = 1; n <= 30; n++)
+	{
+		for (int i = 0; i < 2000; i++)
+		{
+			double value = (double)(rand64() % BIT64(33)) / (double)BIT64(n);
+
+			check_all_decimals(value);
+		}
+	}
+}
+
+ZTEST(fixed_format, test_subnormal)
+{
+	check_all_decimals(from_bits(1));
+	check_all_decimals(from_bits(0x000fffffffffffffULL));
+	check_all_decimals(from_bits(0x0010000000000000ULL));
+	check_all_decimals(-from_bits(12345));
+}
+
+/* Largest readings inside the supported range of each number of decimals */
+ZTEST(fixed_format, test_limits)
+{
+	static const double limits[] = {9.2e18, 9.2e17, 9.2e16, 9.2e15, 9.2e14,
+									9.2e13, 9.2e12, 9.2e11, 9.2e10, 9.2e9};
+
+	for (uint8_t decimals = 0; decimals <= FIXED_FORMAT_MAX_DECIMALS; decimals++)
+	{
+		double value = limits[decimals];
+
+		for (int i = 0; i < 1000; i++)
+		{
+			check(value, decimals);
+			check(-value, decimals);
+			value = from_bits(rand64() % BIT64(52) | (to_bits(limits[decimals]) & ~(BIT64(52) - 1)));
+			value = MIN(value, limits[decimals]);
+		}
+	}
+}
+
+/* Random readings from 1e-12 up to the supported range */
+ZTEST(fixed_format, test_random)
+{
+	for (int i = 0; i < RANDOM_VALUES; i++)
+	{
+		uint64_t bits = rand64();
+		uint64_t exponent = 1023 - 40 + (bits >> 52) % 73;
+		uint8_t decimals = (bits >> 8) % (FIXED_FORMAT_MAX_DECIMALS + 1);
+		double value = from_bits((bits & ((1ULL << 52) - 1)) | (exponent << 52) |
+								 (bits & BIT64(63) ? BIT64(63) : 0));
+
+		if ((value >= 9.2e18 / 1e9) || (value <= -9.2e18 / 1e9))
+		{
+			continue;
+		}
+
+		check(value, decimals);
+	}
+}
+
+ZTEST(fixed_format, test_buffer_too_small)
+{
+	char text[8];
+
+	zassert_equal(fixed_format(text, sizeof(text), 12.345, 3), 6);
+	zassert_equal(fixed_format(text, 7, 12.345, 3), 6);
+	zassert_equal(fixed_format(text, 6, 12.345, 3), -ENOMEM);
+	zassert_equal(text[5], '\0');
+	zassert_equal(fixed_format(text, 0, 12.345, 3), -ENOMEM);
+}
+
+static void check_fix(const struct velopera_gps_data *gps)
+{
+	char expected[512];
+	char text[512];
+	int len;
+
+	gps_trace_printf(gps, expected, sizeof(expected));
+	len = gnss_json_format(gps, text, sizeof(text));
+
+	zassert_equal(len, strlen(expected));
+	zassert_mem_equal(text, expected, strlen(expected) + 1);
+}
+
+ZTEST(fixed_format, test_gnss_json)
+{
+	struct velopera_gps_data gps;
+	struct gps_trace trace;
+
+	gps_trace_init(&trace, 15);
+
+	for (int i = 0; i < RANDOM_FIXES; i++)
+	{
+		gps_trace_next(&trace, &gps);
+
+		/* Anywhere on earth, from below sea level to airliners */
+		if (i % 2)
+		{
+			gps.pvt.latitude = from_bits(rand64() >> 12 | 0x3ff0000000000000ULL) * 180.0 - 270.0;
+			gps.pvt.longitude = from_bits(rand64() >> 12 | 0x3ff0000000000000ULL) * 360.0 - 540.0;
+			gps.pvt.altitude = (float)(from_bits(rand64() >> 12 | 0x3ff0000000000000ULL) * 12000.0 -
+									   12500.0);
+			gps.pvt.heading = (float)(from_bits(rand64() >> 12 | 0x3ff0000000000000ULL) * 360.0 -
+									  360.0);
+		}
+
+		check_fix(&gps);
+	}
+}
+
+static void bench(const char *name, int (*format)(char *buf, size_t size, double value,
+												  uint8_t decimals))
+{
+	static double values[BENCH_VALUES];
+	char text[32];
+	int64_t start;
+	int64_t ns;
+
+	for (int i = 0; i < BENCH_VALUES; i++)
+	{
+		values[i] = 63.0 + (double)(rand64() % 1000000000) / 1e9;
+	}
+
+	start = bench_cpu_ns();
+
+	for (int i = 0; i < BENCH_VALUES; i++)
+	{
+		zassert_true(format(text, sizeof(text), values[i], (i % 2) ? 6 : 1) > 0);
+	}
+
+	ns = bench_cpu_ns() - start;
+
+	TC_PRINT("%-12s %4u ns/reading\n", name, (uint32_t)(ns / BENCH_VALUES));
+}
+
+static int snprintf_format(char *buf, size_t size, double value, uint8_t decimals)
+{
+	return snprintf(buf, size, "%.*f", decimals, value);
+}
+
+ZTEST(fixed_format, test_speed)
+{
+	bench("snprintf", snprintf_format);
+	bench("fixed_format", fixed_format);
+}
+
+ZTEST_SUITE(fixed_format, NULL, NULL, NULL, NULL, NULL);
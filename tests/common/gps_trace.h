@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Synthetic GPS fixes shared by the transport benchmarks.
+ *
+ * A bike ride at 1 Hz: position, altitude, speed and heading follow a seeded random walk, the
+ * accuracies and dilutions of precision jitter around typical values of an open sky fix. The
+ * same seed always gives the same trace.
+ */
+
+#ifndef GPS_TRACE_H__
+#define GPS_TRACE_H__
+
+#include <stdio.h>
+#include <zephyr/kernel.h>
+#include <nrf_modem_gnss.h>
+
+#include "message_channel.h"
+
+struct gps_trace
+{
+	uint32_t rand;
+	uint32_t count;
+	double latitude;
+	double longitude;
+	double lat_step;
+	double lon_step;
+	float altitude;
+	float speed;
+	float heading;
+};
+
+/** Next pseudo random number, xorshift32 */
+static inline uint32_t gps_trace_rand(struct gps_trace *trace)
+{
+	trace->rand ^= trace->rand << 13;
+	trace->rand ^= trace->rand >> 17;
+	trace->rand ^= trace->rand << 5;
+
+	return trace->rand;
+}
+
+/** Pseudo random number in [-1, 1] */
+static inline double gps_trace_noise(struct gps_trace *trace)
+{
+	return (double)gps_trace_rand(trace) / UINT32_MAX * 2.0 - 1.0;
+}
+
+static inline void gps_trace_init(struct gps_trace *trace, uint32_t seed)
+{
+	memset(trace, 0, sizeof(*trace));
+
+	trace->rand = seed ? seed : 1;
+	trace->latitude = 63.430515;
+	trace->longitude = 10.395053;
+	trace->lat_step = 0.00004;
+	trace->lon_step = 0.00006;
+	trace->altitude = 12.0f;
+	trace->speed = 6.0f;
+	trace->heading = 45.0f;
+}
+
+/** Fills the next fix of the ride */
+static inline void gps_trace_next(struct gps_trace *trace, struct velopera_gps_data *gps)
+{
+	struct nrf_modem_gnss_pvt_data_frame *pvt = &gps->pvt;
+	uint32_t seconds = 7 * 3600 + 45 * 60 + trace->count;
+
+	trace->lat_step = CLAMP(trace->lat_step + gps_trace_noise(trace) * 0.000005, -0.00008,
+							0.00008);
+	trace->lon_step = CLAMP(trace->lon_step + gps_trace_noise(trace) * 0.000005, -0.00012,
+							0.00012);
+	trace->latitude += trace->lat_step;
+	trace->longitude += trace->lon_step;
+	trace->altitude = CLAMP(trace->altitude + gps_trace_noise(trace) * 0.4, -5.0, 400.0);
+	trace->speed = CLAMP(trace->speed + gps_trace_noise(trace) * 0.3, 0.0, 12.0);
+	trace->heading += gps_trace_noise(trace) * 8.0;
+	trace->heading += (trace->heading < 0.0f) ? 360.0f : 0.0f;
+	trace->heading -= (trace->heading >= 360.0f) ? 360.0f : 0.0f;
+
+	memset(gps, 0, sizeof(*gps));
+	pvt->latitude = trace->latitude;
+	pvt->longitude = trace->longitude;
+	pvt->altitude = trace->altitude;
+	pvt->accuracy = 2.5f + gps_trace_noise(trace) * 1.5f;
+	pvt->speed = trace->speed;
+	pvt->speed_accuracy = 0.4f + gps_trace_noise(trace) * 0.2f;
+	pvt->heading = trace->heading;
+	pvt->datetime.year = 2023;
+	pvt->datetime.month = 6;
+	pvt->datetime.day = 14;
+	pvt->datetime.hour = seconds / 3600 % 24;
+	pvt->datetime.minute = seconds / 60 % 60;
+	pvt->datetime.seconds = seconds % 60;
+	pvt->datetime.ms = gps_trace_rand(trace) % 4 * 250;
+	pvt->pdop = 1.6f + gps_trace_noise(trace) * 0.4f;
+	pvt->hdop = 0.9f + gps_trace_noise(trace) * 0.2f;
+	pvt->vdop = 1.3f + gps_trace_noise(trace) * 0.3f;
+	pvt->tdop = 1.0f + gps_trace_noise(trace) * 0.2f;
+	gps->meas_id = trace->count;
+	gps->timestamp = (uint64_t)(60 + trace->count) * sys_clock_hw_cycles_per_sec();
+
+	trace->count++;
+}
+
+/* JSON format of a fix before fixed_format.c, needs printf with float support */
+#define GNSS_DATA_JSON                                                                          \
+	"{\"Latitude\":\"%.06f\",\"Longitude\":\"%.06f\",\"Altitude\":\"%.01f\",\"Accuracy\":"   \
+	"\"%.01f\",\"Speed\":\"%.01f\",\"Speed accuracy\":\"%.01f\",\"Heading\":\"%.01f\","       \
+	"\"Date\":\"%04u-%02u-%02u\",\"Time\":\"%02u:%02u:%02u.%03u\",\"PDOP\":\"%.01f\","        \
+	"\"HDOP\":\"%.01f\",\"VDOP\":\"%.01f\",\"TDOP\":\"%.01f\",\"measId\":%d,\"uptime\":%u.%06u}"
+
+/** Formats a fix with snprintf() and GNSS_DATA_JSON, the reference of gnss_json_format() */
+static inline int gps_trace_printf(const struct velopera_gps_data *gps, char *buf, size_t size)
+{
+	const struct nrf_modem_gnss_pvt_data_frame *pvt = &gps->pvt;
+	const struct nrf_modem_gnss_datetime *dt = &pvt->datetime;
+	uint64_t uptime_us = k_cyc_to_us_floor64(gps->timestamp);
+
+	return snprintf(buf, size, GNSS_DATA_JSON, pvt->latitude, pvt->longitude,
+					(double)pvt->altitude, (double)pvt->accuracy, (double)pvt->speed,
+					(double)pvt->speed_accuracy, (double)pvt->heading, dt->year, dt->month,
+					dt->day, dt->hour, dt->minute, dt->seconds, dt->ms, (double)pvt->pdop,
+					(double)pvt->hdop, (double)pvt->vdop, (double)pvt->tdop, gps->meas_id,
+					(uint32_t)(uptime_us / USEC_PER_SEC), (uint32_t)(uptime_us % USEC_PER_SEC));
+}
+
+#endif /* GPS_TRACE_H__ */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/**
+ * @brief Nina lines shared by the benchmarks.
+ *
+ * CAN and compass messages interleaved the way the Nina module sends them during a ride, in the
+ * format of the replay captures. One line keeps the pretty printing of older Nina firmware.
+ */
+
+#ifndef NINA_TRACE_H__
+#define NINA_TRACE_H__
+
+#include <string.h>
+#include <zephyr/kernel.h>
+
+static const char *const nina_trace[] = {
+	"{\"speed\":\"23.41\",\"cadence\":81,\"battery\":\"77.5\",\"motorCurrent\":\"4.213\"}",
+	"{\"heading\":\"182.3\",\"pitch\":\"-1.2\",\"roll\":\"0.4\"}",
+	"{\"speed\":\"23.48\",\"cadence\":82,\"battery\":\"77.5\",\"motorCurrent\":\"4.198\"}",
+	"{\"heading\":\"182.9\",\"pitch\":\"-1.1\",\"roll\":\"0.6\"}",
+	"{\"can\":{\"id\":\"0x18FF50E5\",\"speed\":\"23.52\",\"cadence\":82,\"assist\":3},"
+	"\"battery\":\"77.4\",\"motorCurrent\":\"4.305\",\"temperature\":\"31.5\"}",
+	"{\"heading\":\"183.4\",\"pitch\":\"-0.9\",\"roll\":\"0.9\"}",
+	"{ \"speed\": \"23.60\", \"cadence\": 83, \"battery\": \"77.4\", \"motorCurrent\": \"4.412\" }",
+	"{\"heading\":\"184.1\",\"pitch\":\"-0.7\",\"roll\":\"1.3\"}",
+	"{\"speed\":\"23.71\",\"cadence\":83,\"battery\":\"77.4\",\"motorCurrent\":\"4.520\"}",
+	"{\"event\":\"gear\",\"from\":5,\"to\":6,\"shifter\":\"rear\"}",
+	"{\"heading\":\"184.6\",\"pitch\":\"-0.4\",\"roll\":\"1.1\"}",
+	"{\"speed\":\"23.88\",\"cadence\":79,\"battery\":\"77.3\",\"motorCurrent\":\"3.987\"}",
+	"{\"can\":{\"id\":\"0x18FF51E5\",\"errors\":[],\"odometer\":\"1843.27\",\"trip\":\"12.84\"},"
+	"\"lights\":true,\"battery\":\"77.3\",\"range\":\"54\"}",
+	"{\"heading\":\"185.0\",\"pitch\":\"-0.2\",\"roll\":\"0.8\"}",
+	"{\"speed\":\"24.02\",\"cadence\":80,\"battery\":\"77.3\",\"motorCurrent\":\"4.102\"}",
+	"{\"heading\":\"185.2\",\"pitch\":\"0.1\",\"roll\":\"0.5\"}",
+};
+
+#define NINA_TRACE_LINES ARRAY_SIZE(nina_trace)
+
+/**
+ * @brief Fills a buffer with the trace, repeated as often as complete lines fit.
+ *
+ * @param buf buffer
+ * @param size size of the buffer
+ * @param delimiter appended to every line
+ * @param lines set to the number of lines written
+ *
+ * @return Number of bytes written.
+ */
+static inline size_t nina_trace_fill(uint8_t *buf, size_t size, uint8_t delimiter,
+									 uint32_t *lines)
+{
+	size_t len = 0;
+
+	*lines = 0;
+
+	for (size_t i = 0;; i = (i + 1) % NINA_TRACE_LINES)
+	{
+		size_t line_len = strlen(nina_trace[i]);
+
+		if (len + line_len + 1 > size)
+		{
+			return len;
+		}
+
+		memcpy(&buf[len], nina_trace[i], line_len);
+		len += line_len;
+		buf[len++] = delimiter;
+		(*lines)++;
+	}
+}
+
+#endif /* NINA_TRACE_H__ */
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Members added to the JSON object of a line: objects with and without members and whitespace
+ * around them, lines that are not an object and are left as they are, and buffers without room
+ * for the member. Reports the time and the copies per Nina line of the payload buffers against
+ * the line assembled in a struct velopera_payload first.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "nina_trace.h"
+#include "payload_buf.h"
+
+#define MEMBER "\"uptime\":12.000345"
+#define ROUNDS 20000
+
+/* Adds MEMBER to a line and checks the line and the error against the expected ones */
+static void check(const char *line, const char *expected, int err)
+{
+	struct net_buf *buf = payload_buf_alloc(line, strlen(line), 0);
+
+	zassert_not_null(buf);
+	zassert_equal(payload_buf_member_add(buf, MEMBER), err, "%s", line);
+	zassert_equal(buf->len, strlen(expected), "%s", line);
+	zassert_mem_equal(buf->data, expected, buf->len + 1, "%s", line);
+
+	net_buf_unref(buf);
+}
+
+ZTEST(payload_buf, test_object)
+{
+	check("{\"speed\":12}", "{\"speed\":12," MEMBER "}", 0);
+	check("{\"a\":{\"b\":1},\"c\":[2]}", "{\"a\":{\"b\":1},\"c\":[2]," MEMBER "}", 0);
+	check(" \t{\"speed\":12 }\r\n", " \t{\"speed\":12 ," MEMBER "}", 0);
+}
+
+ZTEST(payload_buf, test_empty_object)
+{
+	check("{}", "{" MEMBER "}", 0);
+	check("{ \t}", "{ \t" MEMBER "}", 0);
+	check("  {}  ", "  {" MEMBER "}", 0);
+}
+
+/* Lines that are not a single object are published unchanged */
+ZTEST(payload_buf, test_not_object)
+{
+	static const char *const lines[] = {
+		"",
+		"   ",
+		"{",
+		"}",
+		"[{\"a\":1},{\"b\":2}]",
+		"[]",
+		"ERR 42 {code}",
+		"{\"a\":1} trailing",
+		"leading {\"a\":1}",
+		"\"{}\"",
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(lines); i++)
+	{
+		check(lines[i], lines[i], -EINVAL);
+	}
+}
+
+/* An object that fills the buffer is left as it is */
+ZTEST(payload_buf, test_no_room)
+{
+	static char line[PAYLOAD_BUF_LINE_MAX + PAYLOAD_BUF_TAILROOM];
+	struct net_buf *buf;
+	size_t len;
+
+	buf = payload_buf_get(PAYLOAD_BUF_LINE_MAX);
+	zassert_not_null(buf);
+
+	len = net_buf_tailroom(buf) - 1;
+	memset(line, ' ', len);
+	line[0] = '{';
+	line[len - 1] = '}';
+
+	net_buf_add_mem(buf, line, len);
+	payload_buf_finish(buf, 0);
+
+	zassert_equal(payload_buf_member_add(buf, MEMBER), -ENOMEM);
+	zassert_equal(buf->len, len);
+	zassert_mem_equal(buf->data, line, len);
+	zassert_equal(buf->data[len], '\0');
+
+	net_buf_unref(buf);
+
+	/* Room for exactly the member, its separator, the closing brace and the terminator */
+	buf = payload_buf_get(PAYLOAD_BUF_LINE_MAX);
+	zassert_not_null(buf);
+
+	len = net_buf_tailroom(buf) - (1 + strlen(MEMBER) + 2) + 1;
+	memset(line, ' ', len);
+	line[0] = '{';
+	line[1] = '1';
+	line[len - 1] = '}';
+
+	net_buf_add_mem(buf, line, len);
+	payload_buf_finish(buf, 0);
+
+	zassert_ok(payload_buf_member_add(buf, MEMBER));
+	zassert_equal(net_buf_tailroom(buf), 1);
+	zassert_equal(buf->data[buf->len], '\0');
+
+	net_buf_unref(buf);
+}
+
+/* The framer hands a line to the trigger, which publishes it on MQTT_CHAN */
+ZTEST(payload_buf, test_bench)
+{
+	/* String of the former struct velopera_payload */
+	static char payload[PAYLOAD_BUF_LINE_MAX + 1];
+	size_t lens[NINA_TRACE_LINES];
+	uint32_t bytes = 0;
+	struct net_buf *buf;
+	int64_t start;
+	int64_t copy_ns;
+	int64_t direct_ns;
+
+	for (size_t i = 0; i < NINA_TRACE_LINES; i++)
+	{
+		lens[i] = strlen(nina_trace[i]);
+		bytes += lens[i];
+	}
+
+	/* Assembled in the payload, then copied into a buffer sized to the line */
+	start = bench_cpu_ns();
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (size_t i = 0; i < NINA_TRACE_LINES; i++)
+		{
+			memcpy(payload, nina_trace[i], lens[i]);
+			payload[lens[i]] = '\0';
+
+			buf = payload_buf_alloc(payload, lens[i], 0);
+			zassert_not_null(buf);
+			net_buf_unref(buf);
+		}
+	}
+
+	copy_ns = bench_cpu_ns() - start;
+
+	/* Added to the buffer directly */
+	start = bench_cpu_ns();
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (size_t i = 0; i < NINA_TRACE_LINES; i++)
+		{
+			buf = payload_buf_get(lens[i]);
+			zassert_not_null(buf);
+
+			net_buf_add_mem(buf, nina_trace[i], lens[i]);
+			payload_buf_finish(buf, 0);
+			net_buf_unref(buf);
+		}
+	}
+
+	direct_ns = bench_cpu_ns() - start;
+
+	TC_PRINT("%u bytes/line: payload %u ns/line, 2 copies, buffer %u ns/line, 1 copy\n",
+			 bytes / (uint32_t)NINA_TRACE_LINES,
+			 (uint32_t)(copy_ns / (ROUNDS * NINA_TRACE_LINES)),
+			 (uint32_t)(direct_ns / (ROUNDS * NINA_TRACE_LINES)));
+}
+
+ZTEST_SUITE(payload_buf, NULL, NULL, NULL, NULL, NULL);
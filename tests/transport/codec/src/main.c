@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Size and encoding time of a GPS fix as JSON, formatted with printf like before fixed_format.c
+ * and with gnss_json_format(), and as CBOR with cbor_gps_encode(). The CBOR maps are decoded
+ * again and checked against the fixes.
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "bench.h"
+#include "fixed_format.h"
+#include "gps_trace.h"
+#include "payload_cbor.h"
+
+#define FIXES 1000
+#define ROUNDS 20
+#define BUF_SIZE 512
+
+static struct velopera_gps_data fixes[FIXES];
+static uint8_t buf[BUF_SIZE];
+
+static int printf_encode(const struct velopera_gps_data *gps, uint8_t *out, size_t size)
+{
+	return gps_trace_printf(gps, (char *)out, size);
+}
+
+static int json_encode(const struct velopera_gps_data *gps, uint8_t *out, size_t size)
+{
+	return gnss_json_format(gps, (char *)out, size);
+}
+
+/* Minimal CBOR reader for the integer maps written by payload_cbor.c */
+struct cbor_reader
+{
+	const uint8_t *buf;
+	size_t len;
+	size_t pos;
+};
+
+static int get_head(struct cbor_reader *r, uint8_t *major, uint64_t *arg)
+{
+	uint8_t info;
+	size_t len;
+
+	if (r->pos >= r->len)
+	{
+		return -ENODATA;
+	}
+
+	*major = r->buf[r->pos] & 0xe0;
+	info = r->buf[r->pos++] & 0x1f;
+
+	if (info < 24)
+	{
+		*arg = info;
+		return 0;
+	}
+
+	if (info > 27)
+	{
+		return -EBADMSG;
+	}
+
+	len = 1 << (info - 24);
+	if (len > r->len - r->pos)
+	{
+		return -EBADMSG;
+	}
+
+	*arg = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		*arg = (*arg << 8) | r->buf[r->pos++];
+	}
+
+	/* Shortest form only */
+	zassert_true((len == 1) ? (*arg >= 24) : (*arg >> (len * 4) != 0));
+
+	return 0;
+}
+
+static int64_t get_int(struct cbor_reader *r)
+{
+	uint8_t major;
+	uint64_t arg;
+
+	zassert_ok(get_head(r, &major, &arg));
+	zassert_true((major == 0x00) || (major == 0x20));
+
+	return (major == 0x00) ? (int64_t)arg : -1 - (int64_t)arg;
+}
+
+static int64_t fixed(double value, int32_t scale)
+{
+	value *= scale;
+
+	return (int64_t)((value < 0) ? value - 0.5 : value + 0.5);
+}
+
+static void cbor_check(const struct velopera_gps_data *gps, const uint8_t *map, size_t len)
+{
+	const struct nrf_modem_gnss_pvt_data_frame *pvt = &gps->pvt;
+	struct cbor_reader r = {.buf = map, .len = len};
+	int64_t values[CBOR_GPS_KEY_COUNT];
+	uint8_t major;
+	uint64_t count;
+
+	zassert_ok(get_head(&r, &major, &count));
+	zassert_equal(major, 0xa0);
+	zassert_equal(count, CBOR_GPS_KEY_COUNT);
+
+	for (int key = 0; key < CBOR_GPS_KEY_COUNT; key++)
+	{
+		zassert_equal(get_int(&r), key);
+		values[key] = get_int(&r);
+	}
+
+	zassert_equal(r.pos, len, "Trailing bytes");
+
+	zassert_equal(values[CBOR_GPS_LATITUDE], fixed(pvt->latitude, 1000000));
+	zassert_equal(values[CBOR_GPS_LONGITUDE], fixed(pvt->longitude, 1000000));
+	zassert_equal(values[CBOR_GPS_ALTITUDE], fixed(pvt->altitude, 10));
+	zassert_equal(values[CBOR_GPS_SPEED], fixed(pvt->speed, 10));
+	zassert_equal(values[CBOR_GPS_HEADING], fixed(pvt->heading, 10));
+	zassert_equal(values[CBOR_GPS_DATE], 20230614);
+	zassert_equal(values[CBOR_GPS_TIME] / 1000,
+				  (pvt->datetime.hour * 100 + pvt->datetime.minute) * 100 +
+					  pvt->datetime.seconds);
+	zassert_equal(values[CBOR_GPS_MEAS_ID], gps->meas_id);
+	zassert_equal(values[CBOR_GPS_UPTIME], k_cyc_to_us_floor64(gps->timestamp));
+}
+
+static void *codec_setup(void)
+{
+	struct gps_trace trace;
+
+	gps_trace_init(&trace, 2023);
+
+	for (int i = 0; i < FIXES; i++)
+	{
+		gps_trace_next(&trace, &fixes[i]);
+	}
+
+	return NULL;
+}
+
+ZTEST(codec, test_cbor_decode)
+{
+	for (int i = 0; i < FIXES; i++)
+	{
+		int len = cbor_gps_encode(&fixes[i], buf, sizeof(buf));
+
+		zassert_true(len > 0);
+		cbor_check(&fixes[i], buf, len);
+	}
+}
+
+ZTEST(codec, test_cbor_negative)
+{
+	struct velopera_gps_data gps = fixes[0];
+	int len;
+
+	gps.pvt.latitude = -33.856784;
+	gps.pvt.longitude = -151.215297;
+	gps.pvt.altitude = -12.3f;
+
+	len = cbor_gps_encode(&gps, buf, sizeof(buf));
+	zassert_true(len > 0);
+	cbor_check(&gps, buf, len);
+}
+
+ZTEST(codec, test_buffer_too_small)
+{
+	int len = cbor_gps_encode(&fixes[0], buf, sizeof(buf));
+
+	zassert_true(len > 0);
+	zassert_equal(cbor_gps_encode(&fixes[0], buf, len), len);
+	zassert_equal(cbor_gps_encode(&fixes[0], buf, len - 1), -ENOMEM);
+	zassert_equal(cbor_gps_encode(&fixes[0], buf, 0), -ENOMEM);
+}
+
+static void bench(const char *name,
+				  int (*encode)(const struct velopera_gps_data *gps, uint8_t *out, size_t size))
+{
+	uint32_t bytes = 0;
+	int64_t start;
+	int64_t ns;
+
+	start = bench_cpu_ns();
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (int i = 0; i < FIXES; i++)
+		{
+			int len = encode(&fixes[i], buf, sizeof(buf));
+
+			zassert_true((len > 0) && (len < sizeof(buf)), "%s", name);
+			bytes += len;
+		}
+	}
+
+	ns = bench_cpu_ns() - start;
+
+	TC_PRINT("%-8s %3u.%u bytes/fix, %5u ns/fix\n", name, bytes / (FIXES * ROUNDS),
+			 bytes * 10 / (FIXES * ROUNDS) % 10, (uint32_t)(ns / (FIXES * ROUNDS)));
+}
+
+ZTEST(codec, test_gps_encode)
+{
+	bench("printf", printf_encode);
+	bench("json", json_encode);
+	bench("cbor", cbor_gps_encode);
+}
+
+ZTEST_SUITE(codec, NULL, codec_setup, NULL, NULL, NULL);
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Delta encoded GPS tracks: tracks written by the encoder are read back with the reference
+ * decoder, over a synthetic ride and over the varint length boundaries, sign changes and the
+ * extremes of every field. Malformed tracks are rejected.
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "gps_trace.h"
+#include "gps_track.h"
+
+#define FIXES 1000
+#define BUF_SIZE 8192
+
+static uint8_t buf[BUF_SIZE];
+static struct gps_track_encoder enc;
+
+static bool fix_equal(const struct gps_track_fix *a, const struct gps_track_fix *b)
+{
+	return (a->time == b->time) && (a->latitude == b->latitude) &&
+		   (a->longitude == b->longitude) && (a->altitude == b->altitude) &&
+		   (a->speed == b->speed);
+}
+
+/* Encodes the fixes into one track and checks that the decoder gives them back */
+static void round_trip(const struct gps_track_fix *fixes, size_t count)
+{
+	struct gps_track_decoder dec;
+	struct gps_track_fix fix;
+
+	gps_track_encoder_init(&enc, buf, sizeof(buf));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		zassert_ok(gps_track_encoder_add(&enc, &fixes[i]), "fix %u", (uint32_t)i);
+	}
+
+	zassert_equal(enc.count, count);
+	zassert_ok(gps_track_decoder_init(&dec, buf, enc.len));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		zassert_ok(gps_track_decoder_next(&dec, &fix), "fix %u", (uint32_t)i);
+		zassert_true(fix_equal(&fix, &fixes[i]), "fix %u", (uint32_t)i);
+	}
+
+	zassert_equal(gps_track_decoder_next(&dec, &fix), -ENODATA);
+	zassert_equal(dec.pos, enc.len);
+}
+
+/* Length of the record of a fix that differs from the previous one in the latitude only */
+static size_t latitude_record_len(int32_t from, int32_t to)
+{
+	struct gps_track_fix fixes[] = {{.latitude = from}, {.latitude = to}};
+	size_t len;
+
+	gps_track_encoder_init(&enc, buf, sizeof(buf));
+	zassert_ok(gps_track_encoder_add(&enc, &fixes[0]));
+	len = enc.len;
+	zassert_ok(gps_track_encoder_add(&enc, &fixes[1]));
+	len = enc.len - len;
+
+	round_trip(fixes, ARRAY_SIZE(fixes));
+
+	/* One byte each for the time, longitude, altitude and speed differences of zero */
+	return len - 4;
+}
+
+ZTEST(gps_track, test_trace)
+{
+	static struct gps_track_fix fixes[FIXES];
+	struct velopera_gps_data gps;
+	struct gps_trace trace;
+
+	gps_trace_init(&trace, 16);
+
+	for (int i = 0; i < FIXES; i++)
+	{
+		gps_trace_next(&trace, &gps);
+		gps_track_fix_from_pvt(&gps.pvt, &fixes[i]);
+	}
+
+	round_trip(fixes, FIXES);
+
+	TC_PRINT("%u fixes, %u bytes, %u.%u bytes/fix\n", FIXES, (uint32_t)enc.len,
+			 (uint32_t)enc.len / FIXES, (uint32_t)enc.len * 10 / FIXES % 10);
+}
+
+/* Zig-zag varints switch to the next length at 2^(7n - 1) in both directions */
+ZTEST(gps_track, test_varint_length)
+{
+	static const struct
+	{
+		int32_t delta;
+		size_t len;
+	} cases[] = {
+		{0, 1},
+		{1, 1},
+		{-1, 1},
+		{63, 1},
+		{-64, 1},
+		{64, 2},
+		{-65, 2},
+		{8191, 2},
+		{-8192, 2},
+		{8192, 3},
+		{-8193, 3},
+		{1048575, 3},
+		{-1048576, 3},
+		{1048576, 4},
+		{-1048577, 4},
+		{134217727, 4},
+		{-134217728, 4},
+		{134217728, 5},
+		{-134217729, 5},
+		{INT32_MAX, 5},
+		{INT32_MIN, 5},
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(cases); i++)
+	{
+		zassert_equal(latitude_record_len(0, cases[i].delta), cases[i].len, "delta %d",
+					  cases[i].delta);
+	}
+}
+
+/* Differences of 32 bit fields need 33 bits */
+ZTEST(gps_track, test_int32_extremes)
+{
+	static const struct gps_track_fix fixes[] = {
+		{0, INT32_MIN, INT32_MAX, INT32_MIN, INT32_MAX},
+		{0, INT32_MAX, INT32_MIN, INT32_MAX, INT32_MIN},
+		{0, INT32_MIN, INT32_MAX, INT32_MIN, INT32_MAX},
+		{0, 0, 0, 0, 0},
+		{0, INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX},
+	};
+
+	zassert_equal(latitude_record_len(INT32_MIN, INT32_MAX), 5);
+	zassert_equal(latitude_record_len(INT32_MAX, INT32_MIN), 5);
+
+	round_trip(fixes, ARRAY_SIZE(fixes));
+}
+
+/* The largest time difference gives the largest record */
+ZTEST(gps_track, test_time_extremes)
+{
+	static const struct gps_track_fix fixes[] = {
+		{INT64_MAX, INT32_MIN, INT32_MIN, INT32_MIN, INT32_MIN},
+		{0, INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX},
+		{-1, 0, 0, 0, 0},
+		{INT64_MIN / 2, 0, 0, 0, 0},
+		{INT64_MAX / 2, 0, 0, 0, 0},
+		{1686728700250, 634305150, 103950530, 120, 60},
+		{1686728701250, 634305150, 103950530, 120, 60},
+	};
+	size_t len;
+
+	round_trip(fixes, ARRAY_SIZE(fixes));
+
+	/* Absolute time and extreme negative fields of the first fix */
+	gps_track_encoder_init(&enc, buf, sizeof(buf));
+	zassert_ok(gps_track_encoder_add(&enc, &fixes[0]));
+	len = enc.len;
+
+	/* -INT64_MAX and four differences of 2^32 - 1 */
+	zassert_ok(gps_track_encoder_add(&enc, &fixes[1]));
+	zassert_equal(enc.len - len, GPS_TRACK_RECORD_MAX_SIZE);
+}
+
+/* Deltas alternating in sign, crossing the equator, the prime meridian and sea level */
+ZTEST(gps_track, test_sign_changes)
+{
+	static struct gps_track_fix fixes[200];
+
+	for (int i = 0; i < ARRAY_SIZE(fixes); i++)
+	{
+		int32_t step = (i % 2) ? -(i * 37) : i * 41;
+
+		fixes[i].time = 1686728700000 + i * 1000 - ((i % 3) ? 0 : 500);
+		fixes[i].latitude = step * 1000;
+		fixes[i].longitude = -step * 999;
+		fixes[i].altitude = (i % 4 < 2) ? -i : i;
+		fixes[i].speed = (i % 2) ? 0 : i;
+	}
+
+	round_trip(fixes, ARRAY_SIZE(fixes));
+}
+
+ZTEST(gps_track, test_buffer_full)
+{
+	static uint8_t small[1 + 2 * GPS_TRACK_RECORD_MAX_SIZE];
+	static const struct gps_track_fix first = {INT64_MAX, INT32_MIN, INT32_MIN, INT32_MIN,
+											   INT32_MIN};
+	static const struct gps_track_fix second = {0, INT32_MAX, INT32_MAX, INT32_MAX, INT32_MAX};
+	struct gps_track_decoder dec;
+	struct gps_track_fix fix;
+	size_t len;
+
+	gps_track_encoder_init(&enc, small, sizeof(small));
+	zassert_ok(gps_track_encoder_add(&enc, &first));
+	zassert_ok(gps_track_encoder_add(&enc, &second));
+	len = enc.len;
+
+	/* Left unchanged */
+	zassert_equal(gps_track_encoder_add(&enc, &first), -ENOMEM);
+	zassert_equal(enc.len, len);
+	zassert_equal(enc.count, 2);
+
+	zassert_ok(gps_track_decoder_init(&dec, small, enc.len));
+	zassert_ok(gps_track_decoder_next(&dec, &fix));
+	zassert_true(fix_equal(&fix, &first));
+	zassert_ok(gps_track_decoder_next(&dec, &fix));
+	zassert_true(fix_equal(&fix, &second));
+	zassert_equal(gps_track_decoder_next(&dec, &fix), -ENODATA);
+}
+
+ZTEST(gps_track, test_malformed)
+{
+	static const uint8_t too_long[] = {GPS_TRACK_VERSION, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+									   0xff, 0xff, 0xff, 0xff, 0x01, 0, 0, 0, 0};
+	static const uint8_t wrong_version[] = {GPS_TRACK_VERSION + 1, 0, 0, 0, 0, 0};
+	static const struct gps_track_fix fixes[] = {
+		{1686728700250, 634305150, 103950530, 120, 60},
+		{1686728701250, 634305550, 103951130, 118, 63},
+	};
+	struct gps_track_decoder dec;
+	struct gps_track_fix fix;
+	size_t first_len;
+
+	zassert_equal(gps_track_decoder_init(&dec, buf, 0), -EBADMSG);
+	zassert_equal(gps_track_decoder_init(&dec, wrong_version, sizeof(wrong_version)),
+				  -EBADMSG);
+
+	zassert_ok(gps_track_decoder_init(&dec, too_long, sizeof(too_long)));
+	zassert_equal(gps_track_decoder_next(&dec, &fix), -EBADMSG);
+
+	/* Cut after every byte, only complete records are returned */
+	gps_track_encoder_init(&enc, buf, sizeof(buf));
+	zassert_ok(gps_track_encoder_add(&enc, &fixes[0]));
+	first_len = enc.len;
+	zassert_ok(gps_track_encoder_add(&enc, &fixes[1]));
+
+	for (size_t len = 1; len < enc.len; len++)
+	{
+		zassert_ok(gps_track_decoder_init(&dec, buf, len));
+
+		if (len < first_len)
+		{
+			zassert_equal(gps_track_decoder_next(&dec, &fix), (len == 1) ? -ENODATA : -EBADMSG,
+						  "len %u", (uint32_t)len);
+			continue;
+		}
+
+		zassert_ok(gps_track_decoder_next(&dec, &fix));
+		zassert_true(fix_equal(&fix, &fixes[0]));
+		zassert_equal(gps_track_decoder_next(&dec, &fix),
+					  (len == first_len) ? -ENODATA : -EBADMSG, "len %u", (uint32_t)len);
+	}
+}
+
+ZTEST(gps_track, test_fix_from_pvt)
+{
+	struct nrf_modem_gnss_pvt_data_frame pvt = {
+		.latitude = 63.430515,
+		.longitude = -10.39505349,
+		.altitude = -4.25f,
+		.speed = 6.04f,
+		.datetime = {.year = 2023, .month = 6, .day = 14, .hour = 7, .minute = 45, .ms = 250},
+	};
+	struct gps_track_fix fix;
+
+	gps_track_fix_from_pvt(&pvt, &fix);
+
+	zassert_equal(fix.time, 1686728700250);
+	zassert_equal(fix.latitude, 634305150);
+	zassert_equal(fix.longitude, -103950535);
+	zassert_equal(fix.altitude, -43);
+	zassert_equal(fix.speed, 60);
+
+	/* Epoch, and a leap day of a century divisible by 400 */
+	pvt.datetime = (struct nrf_modem_gnss_datetime){.year = 1970, .month = 1, .day = 1};
+	gps_track_fix_from_pvt(&pvt, &fix);
+	zassert_equal(fix.time, 0);
+
+	pvt.datetime = (struct nrf_modem_gnss_datetime){
+		.year = 2000, .month = 2, .day = 29, .hour = 23, .minute = 59, .seconds = 59};
+	gps_track_fix_from_pvt(&pvt, &fix);
+	zassert_equal(fix.time, 951868799000);
+}
+
+ZTEST_SUITE(gps_track, NULL, NULL, NULL, NULL, NULL);
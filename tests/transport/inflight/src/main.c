@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* QoS 1 in-flight window with a fake send function: message IDs wrap around skipping 0 and the
+ * IDs still in flight, messages without PUBACK are sent again with the DUP flag after the
+ * timeout and after a reconnect, acknowledged messages free their slot and their heap memory,
+ * a full window or heap wakes the publisher with the PUBACK that makes room, and failed sends
+ * are not counted as sent.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "inflight.c"
+
+#define TOPIC "v/inflight"
+#define MAX_SENDS 64
+#define PAYLOAD_SIZE 16
+
+struct sent
+{
+	uint32_t seq;
+	uint16_t id;
+	bool dup;
+	bool topic_ok;
+};
+
+static struct sent sends[MAX_SENDS];
+static uint32_t send_count;
+static int send_error;
+
+static int send(const uint8_t *topic, const uint8_t *data, size_t len, uint16_t message_id,
+				bool dup)
+{
+	if (send_error)
+	{
+		return send_error;
+	}
+
+	if ((send_count == MAX_SENDS) || (len < sizeof(uint32_t)))
+	{
+		return -EINVAL;
+	}
+
+	memcpy(&sends[send_count].seq, data, sizeof(uint32_t));
+	sends[send_count].id = message_id;
+	sends[send_count].dup = dup;
+	sends[send_count].topic_ok = (strcmp((const char *)topic, TOPIC) == 0);
+	send_count++;
+
+	return 0;
+}
+
+static int publish_len(uint32_t seq, size_t len)
+{
+	static uint8_t payload[CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_HEAP_SIZE];
+
+	memset(payload, seq, len);
+	memcpy(payload, &seq, sizeof(seq));
+
+	return inflight_publish((const uint8_t *)TOPIC, payload, len);
+}
+
+static int publish(uint32_t seq)
+{
+	return publish_len(seq, PAYLOAD_SIZE);
+}
+
+/* Checks the send at index against the message it has to be */
+static void check_send(uint32_t index, uint32_t seq, uint16_t id, bool dup)
+{
+	zassert_true(index < send_count, "send %u", index);
+	zassert_equal(sends[index].seq, seq, "send %u", index);
+	zassert_equal(sends[index].id, id, "send %u", index);
+	zassert_equal(sends[index].dup, dup, "send %u", index);
+	zassert_true(sends[index].topic_ok, "send %u", index);
+}
+
+static void inflight_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	for (size_t i = 0; i < ARRAY_SIZE(slots); i++)
+	{
+		if (slots[i].buf != NULL)
+		{
+			k_heap_free(&inflight_heap, slots[i].buf);
+		}
+	}
+
+	memset(slots, 0, sizeof(slots));
+	atomic_clear(&next_message_id);
+	atomic_clear(&restart);
+	atomic_clear(&waiting);
+	inflight_acks = 0;
+	inflight_retransmits = 0;
+	inflight_ack_ms = 0;
+
+	send_count = 0;
+	send_error = 0;
+
+	inflight_init(send);
+}
+
+/* Messages are sent right away with consecutive IDs, the PUBACKs free their slots */
+ZTEST(inflight, test_publish_puback)
+{
+	for (uint32_t seq = 0; seq < 3; seq++)
+	{
+		zassert_ok(publish(seq));
+		check_send(seq, seq, seq + 1, false);
+	}
+
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS);
+	zassert_equal(send_count, 3);
+
+	zassert_false(inflight_puback(2));
+	zassert_false(inflight_puback(2));
+	zassert_false(inflight_puback(100));
+	zassert_equal(atomic_get(&slots[1].state), SLOT_ACKED);
+
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS);
+	zassert_equal(atomic_get(&slots[1].state), SLOT_FREE);
+	zassert_is_null(slots[1].buf);
+	zassert_equal(inflight_acks, 1);
+
+	zassert_false(inflight_puback(1));
+	zassert_false(inflight_puback(3));
+	zassert_equal(inflight_process(true), -1);
+}
+
+/* IDs wrap around to 1 and skip the ones still in flight */
+ZTEST(inflight, test_message_id_wrap)
+{
+	zassert_ok(publish(0));
+	zassert_ok(publish(1));
+	check_send(0, 0, 1, false);
+	check_send(1, 1, 2, false);
+
+	atomic_set(&next_message_id, UINT16_MAX - 2);
+	zassert_ok(publish(2));
+	zassert_ok(publish(3));
+	zassert_ok(publish(4));
+	check_send(2, 2, UINT16_MAX - 1, false);
+	check_send(3, 3, UINT16_MAX, false);
+	check_send(4, 4, 3, false);
+
+	/* Once acknowledged, an ID is used again after the next wrap */
+	zassert_false(inflight_puback(1));
+	inflight_process(true);
+	atomic_set(&next_message_id, UINT16_MAX);
+	zassert_equal(inflight_message_id(), 1);
+	zassert_equal(inflight_message_id(), 4);
+}
+
+/* Messages without PUBACK are sent again with the same ID and the DUP flag */
+ZTEST(inflight, test_timeout)
+{
+	zassert_ok(publish(0));
+	k_sleep(K_MSEC(1000));
+	zassert_ok(publish(1));
+
+	k_sleep(K_MSEC(INFLIGHT_TIMEOUT_MS - 1001));
+	zassert_equal(inflight_process(true), 1);
+	zassert_equal(send_count, 2);
+
+	k_sleep(K_MSEC(1));
+	zassert_equal(inflight_process(true), 1000);
+	zassert_equal(send_count, 3);
+	check_send(2, 0, 1, true);
+	zassert_equal(inflight_retransmits, 1);
+
+	/* Nothing is sent while disconnected */
+	k_sleep(K_MSEC(1000));
+	zassert_equal(inflight_process(false), -1);
+	zassert_equal(send_count, 3);
+
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS - 1000);
+	check_send(3, 1, 2, true);
+
+	zassert_false(inflight_puback(1));
+	zassert_false(inflight_puback(2));
+	zassert_equal(inflight_process(true), -1);
+	zassert_equal(inflight_acks, 2);
+}
+
+/* After reconnecting, all messages in flight are sent again right away */
+ZTEST(inflight, test_restart)
+{
+	for (uint32_t seq = 0; seq < 3; seq++)
+	{
+		zassert_ok(publish(seq));
+	}
+
+	zassert_false(inflight_puback(2));
+
+	inflight_restart();
+	zassert_equal(inflight_process(false), -1);
+	zassert_equal(send_count, 3);
+
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS);
+	zassert_equal(send_count, 5);
+	check_send(3, 0, 1, true);
+	check_send(4, 2, 3, true);
+
+	/* Only once */
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS);
+	zassert_equal(send_count, 5);
+}
+
+/* A full window is reported once, the PUBACK that frees a slot wakes the publisher */
+ZTEST(inflight, test_window_full)
+{
+	for (uint32_t seq = 0; seq < INFLIGHT_WINDOW; seq++)
+	{
+		zassert_false(inflight_full());
+		zassert_ok(publish(seq));
+	}
+
+	zassert_true(inflight_full());
+	zassert_equal(publish(INFLIGHT_WINDOW), -EBUSY);
+	zassert_equal(send_count, INFLIGHT_WINDOW);
+
+	zassert_true(inflight_puback(3));
+	zassert_false(inflight_full());
+	zassert_false(inflight_puback(3));
+
+	zassert_ok(publish(INFLIGHT_WINDOW));
+	check_send(INFLIGHT_WINDOW, INFLIGHT_WINDOW, INFLIGHT_WINDOW + 1, false);
+	zassert_true(inflight_full());
+}
+
+/* A full heap is reported like a full window, the memory is freed with the PUBACK */
+ZTEST(inflight, test_heap_full)
+{
+	size_t len = CONFIG_MQTT_SAMPLE_TRANSPORT_INFLIGHT_HEAP_SIZE / 2;
+
+	zassert_ok(publish_len(0, len));
+	zassert_equal(publish_len(1, len), -ENOMEM);
+	zassert_false(inflight_full());
+	zassert_ok(publish(2));
+
+	zassert_true(inflight_puback(1));
+	zassert_ok(publish_len(1, len));
+	check_send(2, 1, 3, false);
+	zassert_equal(publish_len(3, len), -ENOMEM);
+
+	zassert_true(inflight_puback(3));
+	zassert_false(inflight_puback(2));
+}
+
+/* A message that could not be sent stays in the window and is sent without the DUP flag */
+ZTEST(inflight, test_send_error)
+{
+	send_error = -EAGAIN;
+	zassert_ok(publish(0));
+	zassert_equal(send_count, 0);
+	zassert_false(slots[0].sent);
+
+	/* Neither after a reconnect */
+	inflight_restart();
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS);
+	zassert_false(slots[0].sent);
+	zassert_equal(inflight_retransmits, 0);
+
+	send_error = 0;
+	k_sleep(K_MSEC(INFLIGHT_TIMEOUT_MS));
+	zassert_equal(inflight_process(true), INFLIGHT_TIMEOUT_MS);
+	check_send(0, 0, 1, false);
+	zassert_true(slots[0].sent);
+	zassert_equal(inflight_retransmits, 0);
+
+	/* Failed retransmits keep the DUP flag */
+	send_error = -EAGAIN;
+	k_sleep(K_MSEC(INFLIGHT_TIMEOUT_MS));
+	inflight_process(true);
+	send_error = 0;
+	k_sleep(K_MSEC(INFLIGHT_TIMEOUT_MS));
+	inflight_process(true);
+	check_send(1, 0, 1, true);
+	zassert_equal(inflight_retransmits, 1);
+}
+
+ZTEST_SUITE(inflight, NULL, NULL, inflight_before, NULL, NULL);
@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* LZSS compression of batches: Nina lines, GPS fixes and random bytes are batched the way
+ * batch_add() of the transport module does, compressed while the messages are added and decoded
+ * again. Reports the compression ratio and the time per KB of the encoder and the reference
+ * decoder.
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/zbus/zbus.h>
+
+#include "bench.h"
+#include "gps_trace.h"
+#include "lzss.h"
+#include "nina_trace.h"
+
+#define BATCH_SIZE CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_MAX_BYTES
+#define BATCH_MAX_COUNT CONFIG_MQTT_SAMPLE_TRANSPORT_BATCH_MAX_COUNT
+/* Batches are limited by their compressed size */
+#define RAW_SIZE (4 * BATCH_SIZE)
+
+#define MESSAGES 4000
+#define MESSAGE_SIZE 512
+#define RANDOM_MESSAGE_SIZE 64
+#define BATCHES 1000
+
+struct batch
+{
+	char raw[RAW_SIZE];
+	size_t raw_len;
+	uint32_t count;
+	uint8_t out[BATCH_SIZE];
+	int out_len;
+};
+
+static char messages[MESSAGES][MESSAGE_SIZE];
+static size_t message_len[MESSAGES];
+
+static struct batch batches[BATCHES];
+static uint32_t batch_count;
+static struct lzss_encoder enc;
+static uint8_t decoded[RAW_SIZE];
+
+static uint32_t rand_state = 17;
+
+static uint32_t rand32(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+
+static void nina_messages(void)
+{
+	for (int i = 0; i < MESSAGES; i++)
+	{
+		message_len[i] = strlen(nina_trace[i % NINA_TRACE_LINES]);
+		memcpy(messages[i], nina_trace[i % NINA_TRACE_LINES], message_len[i]);
+	}
+}
+
+static void gps_messages(void)
+{
+	struct velopera_gps_data gps;
+	struct gps_trace trace;
+
+	gps_trace_init(&trace, 17);
+
+	for (int i = 0; i < MESSAGES; i++)
+	{
+		gps_trace_next(&trace, &gps);
+		message_len[i] = gps_trace_printf(&gps, messages[i], MESSAGE_SIZE);
+	}
+}
+
+static void random_messages(void)
+{
+	for (int i = 0; i < MESSAGES; i++)
+	{
+		for (int j = 0; j < RANDOM_MESSAGE_SIZE; j++)
+		{
+			messages[i][j] = rand32();
+		}
+
+		message_len[i] = RANDOM_MESSAGE_SIZE;
+	}
+}
+
+static void batch_write(struct batch *batch, const void *data, size_t len)
+{
+	zassert_ok(lzss_encoder_write(&enc, data, len));
+	zassert_true(batch->raw_len + len <= RAW_SIZE);
+
+	memcpy(&batch->raw[batch->raw_len], data, len);
+	batch->raw_len += len;
+}
+
+static void batch_flush(void)
+{
+	struct batch *batch = &batches[batch_count];
+
+	batch_write(batch, "]", 1);
+	batch->out_len = lzss_encoder_finish(&enc);
+	zassert_true(batch->out_len > 0);
+
+	zassert_true(++batch_count < BATCHES);
+	batches[batch_count].raw_len = 0;
+	batches[batch_count].count = 0;
+	lzss_encoder_init(&enc, batches[batch_count].out, BATCH_SIZE);
+}
+
+/* Same limits as batch_add() */
+static void batch_add(const char *message, size_t len)
+{
+	struct batch *batch = &batches[batch_count];
+
+	/* Separator, message and closing bracket */
+	if (lzss_encoder_bound(&enc, 1 + len + 1) > BATCH_SIZE)
+	{
+		batch_flush();
+		batch = &batches[batch_count];
+	}
+
+	zassert_true(lzss_encoder_bound(&enc, 1 + len + 1) <= BATCH_SIZE);
+
+	batch_write(batch, (batch->count == 0) ? "[" : ",", 1);
+	batch_write(batch, message, len);
+
+	if (++batch->count >= BATCH_MAX_COUNT)
+	{
+		batch_flush();
+	}
+}
+
+static void batches_build(void)
+{
+	batch_count = 0;
+	batches[0].raw_len = 0;
+	batches[0].count = 0;
+	lzss_encoder_init(&enc, batches[0].out, BATCH_SIZE);
+
+	for (int i = 0; i < MESSAGES; i++)
+	{
+		batch_add(messages[i], message_len[i]);
+	}
+
+	if (batches[batch_count].count > 0)
+	{
+		batch_flush();
+	}
+}
+
+static void check_decode(const struct batch *batch)
+{
+	int len = lzss_decode(batch->out, batch->out_len, decoded, sizeof(decoded));
+
+	zassert_equal(len, batch->raw_len);
+	zassert_mem_equal(decoded, batch->raw, len);
+}
+
+static void bench(const char *name)
+{
+	uint32_t raw_bytes = 0;
+	uint32_t out_bytes = 0;
+	int64_t start;
+	int64_t encode_ns;
+	int64_t decode_ns;
+
+	start = bench_cpu_ns();
+	batches_build();
+	encode_ns = bench_cpu_ns() - start;
+
+	start = bench_cpu_ns();
+
+	for (uint32_t i = 0; i < batch_count; i++)
+	{
+		lzss_decode(batches[i].out, batches[i].out_len, decoded, sizeof(decoded));
+	}
+
+	decode_ns = bench_cpu_ns() - start;
+
+	for (uint32_t i = 0; i < batch_count; i++)
+	{
+		check_decode(&batches[i]);
+
+		raw_bytes += batches[i].raw_len;
+		out_bytes += batches[i].out_len;
+	}
+
+	TC_PRINT("W=%u L=%u %-6s %2u messages, %4u -> %4u bytes/batch, ratio %u.%02u, "
+			 "encode %6u ns/KB, decode %5u ns/KB\n",
+			 LZSS_WINDOW_BITS, LZSS_LENGTH_BITS, name, MESSAGES / batch_count,
+			 raw_bytes / batch_count, out_bytes / batch_count, raw_bytes / out_bytes,
+			 raw_bytes * 100 / out_bytes % 100, (uint32_t)(encode_ns * 1024 / raw_bytes),
+			 (uint32_t)(decode_ns * 1024 / raw_bytes));
+}
+
+ZTEST(lzss, test_nina)
+{
+	nina_messages();
+	bench("nina");
+}
+
+ZTEST(lzss, test_gps)
+{
+	gps_messages();
+	bench("gps");
+}
+
+ZTEST(lzss, test_random)
+{
+	random_messages();
+	bench("random");
+}
+
+/* The output does not depend on how the input is split into writes */
+ZTEST(lzss, test_chunks)
+{
+	static uint8_t out[BATCH_SIZE];
+	const struct batch *batch = &batches[0];
+
+	gps_messages();
+	batches_build();
+
+	for (size_t chunk = 1; chunk <= 2 * LZSS_WINDOW_SIZE + LZSS_MAX_MATCH + 1; chunk++)
+	{
+		lzss_encoder_init(&enc, out, sizeof(out));
+
+		for (size_t pos = 0; pos < batch->raw_len; pos += chunk)
+		{
+			zassert_ok(lzss_encoder_write(&enc, &batch->raw[pos],
+										  MIN(chunk, batch->raw_len - pos)));
+		}
+
+		zassert_equal(lzss_encoder_finish(&enc), batch->out_len, "chunk %u", (uint32_t)chunk);
+		zassert_mem_equal(out, batch->out, batch->out_len, "chunk %u", (uint32_t)chunk);
+	}
+}
+
+/* Runs are encoded as references overlapping the bytes they produce */
+ZTEST(lzss, test_runs)
+{
+	struct batch *batch = &batches[0];
+
+	for (size_t len = 0; len < 3 * LZSS_WINDOW_SIZE; len += 7)
+	{
+		/* One literal, then references of maximum length */
+		size_t bits = 9 + (len / LZSS_MAX_MATCH + 1) * (1 + LZSS_WINDOW_BITS + LZSS_LENGTH_BITS);
+
+		memset(batch->raw, 'a' + len % 26, len);
+		batch->raw_len = len;
+
+		lzss_encoder_init(&enc, batch->out, sizeof(batch->out));
+		zassert_ok(lzss_encoder_write(&enc, batch->raw, len));
+		batch->out_len = lzss_encoder_finish(&enc);
+
+		zassert_true(batch->out_len <= LZSS_HEADER_SIZE + DIV_ROUND_UP(bits, 8), "len %u",
+					 (uint32_t)len);
+		check_decode(batch);
+	}
+}
+
+ZTEST(lzss, test_output_full)
+{
+	static uint8_t out[64];
+	const struct batch *batch = &batches[0];
+
+	nina_messages();
+	batches_build();
+
+	lzss_encoder_init(&enc, out, sizeof(out));
+	lzss_encoder_write(&enc, batch->raw, batch->raw_len);
+	zassert_equal(lzss_encoder_finish(&enc), -ENOMEM);
+
+	zassert_equal(lzss_decode(batch->out, batch->out_len, decoded, batch->raw_len - 1),
+				  -ENOMEM);
+}
+
+ZTEST(lzss, test_malformed)
+{
+	/* Reference to distance 1 before any output */
+	const uint8_t reference[] = {LZSS_MAGIC, (LZSS_WINDOW_BITS << 4) | LZSS_LENGTH_BITS, 0x00,
+								 0x00, 0x00};
+	const uint8_t magic[] = {0x5b, (LZSS_WINDOW_BITS << 4) | LZSS_LENGTH_BITS, 0x80};
+	const uint8_t bits[] = {LZSS_MAGIC, 0x21, 0x80};
+
+	zassert_equal(lzss_decode(reference, sizeof(reference), decoded, sizeof(decoded)),
+				  -EBADMSG);
+	zassert_equal(lzss_decode(magic, sizeof(magic), decoded, sizeof(decoded)), -EBADMSG);
+	zassert_equal(lzss_decode(bits, sizeof(bits), decoded, sizeof(decoded)), -EBADMSG);
+	zassert_equal(lzss_decode(reference, 1, decoded, sizeof(decoded)), -EBADMSG);
+}
+
+ZTEST_SUITE(lzss, NULL, NULL, NULL, NULL, NULL);
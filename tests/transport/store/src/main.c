@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Store-and-forward queue on the flash simulator: chunks are appended to the FCB while offline
+ * and replayed in order once connected, records are sent again without PUBACK, after a send error
+ * and after reconnecting. A full partition drops its oldest sector, acknowledged sectors are
+ * erased. A reboot is simulated by resetting the state of store.c, the chunks in flash are sent
+ * again while the write buffer in RAM is lost.
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/storage/flash_map.h>
+
+#include "store.c"
+
+#define TOPIC "v/store"
+#define MAX_SENDS 2048
+#define PAYLOAD_SIZE 100
+
+struct sent
+{
+	uint32_t seq;
+	uint16_t id;
+	bool dup;
+	bool topic_ok;
+};
+
+static struct sent sends[MAX_SENDS];
+static uint32_t send_count;
+static int send_error;
+static uint16_t next_id;
+
+/* Message IDs of the in-flight module, which is not part of the test */
+uint16_t inflight_message_id(void)
+{
+	if (++next_id == 0)
+	{
+		next_id = 1;
+	}
+
+	return next_id;
+}
+
+static int send(const uint8_t *topic, const uint8_t *data, size_t len, uint16_t message_id,
+				bool dup)
+{
+	if (send_error)
+	{
+		return send_error;
+	}
+
+	if ((send_count == MAX_SENDS) || (len != PAYLOAD_SIZE))
+	{
+		return -EINVAL;
+	}
+
+	memcpy(&sends[send_count].seq, data, sizeof(uint32_t));
+	sends[send_count].id = message_id;
+	sends[send_count].dup = dup;
+	sends[send_count].topic_ok = (memcmp(topic, TOPIC, sizeof(TOPIC)) == 0);
+	send_count++;
+
+	return 0;
+}
+
+/* Everything in RAM is gone after a reboot, the flash is kept */
+static void reboot(void)
+{
+	memset(&fcb, 0, sizeof(fcb));
+	fcb.f_magic = STORE_FCB_MAGIC;
+	fcb.f_sectors = sectors;
+	fcb.f_sector_cnt = STORE_SECTOR_COUNT;
+
+	store_send = NULL;
+	initialized = false;
+	write_len = 0;
+	write_count = 0;
+	write_deadline = 0;
+	memset(&acked_loc, 0, sizeof(acked_loc));
+	backlog = false;
+	memset(&inflight_loc, 0, sizeof(inflight_loc));
+	inflight_count = 0;
+	inflight_sent = 0;
+	inflight_dup = 0;
+	atomic_clear(&inflight_acked);
+	inflight_sent_at = 0;
+	atomic_clear(&restart);
+
+	store_chunks = 0;
+	store_bytes = 0;
+	store_erases = 0;
+	store_dropped_sectors = 0;
+	store_retransmits = 0;
+
+	zassert_ok(store_init(send));
+}
+
+static void append(uint32_t seq)
+{
+	uint8_t payload[PAYLOAD_SIZE];
+
+	memset(payload, seq, sizeof(payload));
+	memcpy(payload, &seq, sizeof(seq));
+
+	zassert_ok(store_append((const uint8_t *)TOPIC, payload, sizeof(payload)));
+}
+
+/* Writes the write buffer once its delay has expired */
+static void flush(void)
+{
+	k_sleep(K_MSEC(CONFIG_MQTT_SAMPLE_TRANSPORT_STORE_WRITE_DELAY_MS));
+	store_process(false);
+	zassert_equal(write_count, 0);
+}
+
+/* Sends and acknowledges everything in the store */
+static void replay(void)
+{
+	for (int i = 0; store_pending() && (i < MAX_SENDS); i++)
+	{
+		uint32_t first = send_count;
+
+		store_process(true);
+
+		for (uint32_t j = first; j < send_count; j++)
+		{
+			store_puback(sends[j].id);
+		}
+	}
+
+	zassert_false(store_pending());
+	zassert_equal(store_process(true), -1);
+}
+
+/* Checks that the sends from index on are the sequence numbers from first to last */
+static void check_sends(uint32_t index, uint32_t first, uint32_t last)
+{
+	zassert_equal(send_count - index, last - first + 1, "%u sends from %u", send_count - index,
+				  index);
+
+	for (uint32_t i = index; i < send_count; i++)
+	{
+		zassert_equal(sends[i].seq, first + i - index, "send %u", i);
+		zassert_false(sends[i].dup, "send %u", i);
+		zassert_true(sends[i].topic_ok, "send %u", i);
+	}
+}
+
+static void store_before(void *fixture)
+{
+	const struct flash_area *fa;
+
+	zassert_ok(flash_area_open(STORE_PARTITION_ID, &fa));
+	zassert_ok(flash_area_erase(fa, 0, fa->fa_size));
+	flash_area_close(fa);
+
+	send_count = 0;
+	send_error = 0;
+
+	reboot();
+	zassert_false(store_pending());
+}
+
+/* Messages appended while offline are written after the write delay and sent in order */
+ZTEST(store, test_append_replay)
+{
+	for (uint32_t seq = 0; seq < 100; seq++)
+	{
+		append(seq);
+	}
+
+	zassert_true(store_chunks > 0);
+	zassert_true(write_count > 0);
+
+	/* Nothing is sent while offline, the rest of the write buffer is due after the delay */
+	zassert_equal(store_process(false), CONFIG_MQTT_SAMPLE_TRANSPORT_STORE_WRITE_DELAY_MS);
+	flush();
+	zassert_equal(send_count, 0);
+
+	replay();
+	check_sends(0, 0, 99);
+	zassert_false(store_pending());
+
+	/* The write buffer is sent right away while connected */
+	append(100);
+	replay();
+	check_sends(100, 100, 100);
+}
+
+/* Records without PUBACK are sent again with the DUP flag and the same message ID */
+ZTEST(store, test_puback_timeout)
+{
+	uint32_t count;
+
+	for (uint32_t seq = 0; seq < 5; seq++)
+	{
+		append(seq);
+	}
+
+	flush();
+
+	zassert_equal(store_process(true), PUBACK_TIMEOUT_MS);
+	check_sends(0, 0, 4);
+	count = send_count;
+
+	zassert_false(store_puback(sends[0].id));
+	zassert_false(store_puback(sends[2].id));
+	zassert_false(store_puback(sends[2].id + 1000));
+
+	k_sleep(K_MSEC(PUBACK_TIMEOUT_MS - 1));
+	zassert_equal(store_process(true), 1);
+	zassert_equal(send_count, count);
+
+	k_sleep(K_MSEC(1));
+	zassert_equal(store_process(true), PUBACK_TIMEOUT_MS);
+	zassert_equal(send_count, count + 3);
+	zassert_equal(store_retransmits, 3);
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const struct sent *sent = &sends[count + i];
+		const struct sent *first = &sends[(i == 0) ? 1 : 2 + i];
+
+		zassert_equal(sent->seq, first->seq);
+		zassert_equal(sent->id, first->id);
+		zassert_true(sent->dup);
+	}
+
+	zassert_false(store_puback(sends[1].id));
+	zassert_false(store_puback(sends[3].id));
+	zassert_true(store_puback(sends[4].id));
+	zassert_equal(store_process(true), -1);
+	zassert_false(store_pending());
+}
+
+/* A failed send is retried from the record that failed */
+ZTEST(store, test_send_error)
+{
+	for (uint32_t seq = 0; seq < 5; seq++)
+	{
+		append(seq);
+	}
+
+	flush();
+
+	send_error = -EAGAIN;
+	zassert_equal(store_process(true), SEND_RETRY_MS);
+	zassert_equal(send_count, 0);
+
+	send_error = 0;
+	replay();
+	check_sends(0, 0, 4);
+}
+
+/* After reconnecting the records of the current chunk are sent again */
+ZTEST(store, test_restart)
+{
+	for (uint32_t seq = 0; seq < 5; seq++)
+	{
+		append(seq);
+	}
+
+	flush();
+
+	store_process(true);
+	check_sends(0, 0, 4);
+	zassert_false(store_puback(sends[1].id));
+
+	store_restart();
+	store_process(true);
+	zassert_equal(send_count, 9);
+
+	for (uint32_t i = 5; i < send_count; i++)
+	{
+		zassert_not_equal(sends[i].seq, 1);
+		zassert_true(sends[i].dup);
+		zassert_equal(store_puback(sends[i].id), i == send_count - 1);
+	}
+
+	zassert_equal(store_process(true), -1);
+	zassert_false(store_pending());
+}
+
+/* A full partition drops its oldest sector, the newest messages are kept in order */
+ZTEST(store, test_full)
+{
+	uint32_t count = 2 * FIXED_PARTITION_SIZE(storage_partition) / PAYLOAD_SIZE;
+	uint32_t first;
+
+	for (uint32_t seq = 0; seq < count; seq++)
+	{
+		append(seq);
+	}
+
+	flush();
+	zassert_true(store_dropped_sectors > 0);
+
+	replay();
+
+	first = sends[0].seq;
+	zassert_true(first > 0);
+	check_sends(0, first, count - 1);
+
+	TC_PRINT("%u of %u messages kept in %u sectors, %u dropped\n", send_count, count,
+			 STORE_SECTOR_COUNT, store_dropped_sectors);
+}
+
+/* Sectors are erased once all chunks in them are acknowledged */
+ZTEST(store, test_erase)
+{
+	uint32_t count = FIXED_PARTITION_SIZE(storage_partition) / PAYLOAD_SIZE / 2;
+
+	for (uint32_t seq = 0; seq < count; seq++)
+	{
+		append(seq);
+	}
+
+	flush();
+	zassert_equal(store_dropped_sectors, 0);
+	zassert_not_equal(fcb.f_oldest, fcb.f_active.fe_sector);
+
+	replay();
+	check_sends(0, 0, count - 1);
+
+	/* Only the active sector is left */
+	zassert_true(store_erases > 0);
+	zassert_equal(fcb.f_oldest, fcb.f_active.fe_sector);
+
+	/* After a reboot at most the chunks of the active sector are sent again */
+	send_count = 0;
+	reboot();
+	replay();
+	zassert_true(send_count < count);
+	check_sends(0, count - send_count, count - 1);
+}
+
+/* Chunks in flash survive a reboot, the write buffer in RAM does not */
+ZTEST(store, test_reboot)
+{
+	uint32_t acked;
+
+	for (uint32_t seq = 0; seq < 20; seq++)
+	{
+		append(seq);
+	}
+
+	flush();
+
+	for (uint32_t seq = 20; seq < 25; seq++)
+	{
+		append(seq);
+	}
+
+	/* Part of the first chunk is acknowledged */
+	store_process(true);
+	acked = send_count / 2;
+	zassert_true(acked > 0);
+
+	for (uint32_t i = 0; i < acked; i++)
+	{
+		zassert_false(store_puback(sends[i].id));
+	}
+
+	send_count = 0;
+	reboot();
+	zassert_true(store_pending());
+
+	replay();
+	check_sends(0, 0, 19);
+}
+
+ZTEST(store, test_errors)
+{
+	static uint8_t payload[STORE_WRITE_BUFFER_SIZE];
+	char topic[UINT8_MAX + 1];
+
+	memset(topic, 'a', sizeof(topic) - 1);
+	topic[sizeof(topic) - 1] = '\0';
+
+	zassert_equal(store_append((const uint8_t *)TOPIC, payload, sizeof(payload) - RECORD_HEADER_SIZE -
+											   sizeof(TOPIC) + 1),
+				  -EMSGSIZE);
+	zassert_ok(store_append((const uint8_t *)TOPIC, payload,
+							sizeof(payload) - RECORD_HEADER_SIZE - sizeof(TOPIC)));
+	zassert_equal(store_append((const uint8_t *)topic, payload, 1), -EMSGSIZE);
+
+	initialized = false;
+	zassert_equal(store_append((const uint8_t *)TOPIC, payload, 1), -ENODEV);
+	zassert_equal(store_process(true), -1);
+	zassert_false(store_pending());
+}
+
+ZTEST_SUITE(store, NULL, NULL, store_before, NULL, NULL);
@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Time series blocks: synthetic Nina signals are cut into blocks of the default size, decoded
+ * again and reported in bits per sample against the 96 bits of a raw sample. The delta-of-delta
+ * buckets, the XOR windows, full blocks and truncated blocks are checked at their limits.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "timeseries.h"
+
+#define BLOCK_SIZE CONFIG_MQTT_SAMPLE_TRANSPORT_TIMESERIES_BLOCK_BYTES
+#define SAMPLES 100000
+#define SERIES_ID 7
+
+struct sample
+{
+	int64_t time;
+	int32_t value;
+};
+
+static struct sample samples[SAMPLES];
+static uint8_t buf[32 * BLOCK_SIZE];
+static struct ts_block block;
+
+static uint32_t rand_state = 18;
+
+static uint32_t rand32(void)
+{
+	rand_state ^= rand_state << 13;
+	rand_state ^= rand_state >> 17;
+	rand_state ^= rand_state << 5;
+
+	return rand_state;
+}
+
+/* Pseudo random number in [-range, range] */
+static int32_t noise(int32_t range)
+{
+	return (int32_t)(rand32() % (2 * range + 1)) - range;
+}
+
+/* Decodes one block and checks it against the samples it was built from */
+static size_t block_check(const uint8_t *data, size_t len, const struct sample *expected,
+						  size_t count)
+{
+	struct ts_block_decoder dec;
+	int64_t time;
+	int32_t value;
+	uint8_t id;
+
+	zassert_ok(ts_block_decoder_init(&dec, data, len, &id));
+	zassert_equal(id, SERIES_ID);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		zassert_ok(ts_block_decoder_next(&dec, &time, &value), "sample %u", (uint32_t)i);
+		zassert_equal(time, expected[i].time, "sample %u", (uint32_t)i);
+		zassert_equal(value, expected[i].value, "sample %u", (uint32_t)i);
+	}
+
+	zassert_equal(ts_block_decoder_next(&dec, &time, &value), -ENODATA);
+
+	return ts_block_decoder_size(&dec);
+}
+
+/* Encodes the samples into as many blocks of block_size as needed and decodes them again.
+ * Returns the total length of the blocks.
+ */
+static size_t round_trip(const struct sample *series, size_t count, size_t block_size,
+						 uint32_t *blocks)
+{
+	size_t total = 0;
+	size_t first = 0;
+
+	*blocks = 0;
+	ts_block_init(&block, SERIES_ID, buf, block_size);
+
+	for (size_t i = 0; i <= count; i++)
+	{
+		int err = (i < count) ? ts_block_append(&block, series[i].time, series[i].value)
+							  : -ENOMEM;
+		size_t len;
+
+		if (err == 0)
+		{
+			continue;
+		}
+
+		zassert_equal(err, -ENOMEM, "sample %u", (uint32_t)i);
+
+		len = ts_block_flush(&block);
+		zassert_equal(block_check(buf, len, &series[first], i - first), len);
+		total += len;
+		(*blocks)++;
+
+		if (i < count)
+		{
+			first = i;
+			ts_block_init(&block, SERIES_ID, buf, block_size);
+			zassert_ok(ts_block_append(&block, series[i].time, series[i].value));
+		}
+	}
+
+	return total;
+}
+
+/* Blocks of the default size */
+static void bench(const char *name)
+{
+	uint32_t blocks;
+	uint64_t bits;
+	int64_t start;
+	int64_t ns;
+
+	start = bench_cpu_ns();
+	ts_block_init(&block, SERIES_ID, buf, BLOCK_SIZE);
+
+	for (size_t i = 0; i < SAMPLES; i++)
+	{
+		if (ts_block_append(&block, samples[i].time, samples[i].value) != 0)
+		{
+			ts_block_flush(&block);
+			ts_block_init(&block, SERIES_ID, buf, BLOCK_SIZE);
+			ts_block_append(&block, samples[i].time, samples[i].value);
+		}
+	}
+
+	ts_block_flush(&block);
+	ns = bench_cpu_ns() - start;
+
+	bits = round_trip(samples, SAMPLES, BLOCK_SIZE, &blocks) * 8;
+
+	TC_PRINT("%-14s %3u samples/block, %2u.%u bits/sample, %3u ns/sample\n", name,
+			 SAMPLES / blocks, (uint32_t)(bits / SAMPLES), (uint32_t)(bits * 10 / SAMPLES % 10),
+			 (uint32_t)(ns / SAMPLES));
+}
+
+/* State of charge in 0.01 %, 10 Hz */
+ZTEST(timeseries, test_battery)
+{
+	for (int i = 0; i < SAMPLES; i++)
+	{
+		samples[i].time = 60000 + i * 100;
+		samples[i].value = 7750 - i / 500;
+	}
+
+	bench("battery");
+}
+
+/* Same, the lines arrive with a few ms of jitter */
+ZTEST(timeseries, test_battery_jitter)
+{
+	for (int i = 0; i < SAMPLES; i++)
+	{
+		samples[i].time = 60000 + i * 100 + noise(3);
+		samples[i].value = 7750 - i / 500;
+	}
+
+	bench("battery jitter");
+}
+
+/* Heading in 0.1 degrees, slow turns, from a resonator instead of libm */
+ZTEST(timeseries, test_heading)
+{
+	/* 2 * cos(2 * pi / 600) */
+	const double k = 1.9998903417374227;
+	double y0 = 0.0;
+	double y1 = 9.4246;
+
+	for (int i = 0; i < SAMPLES; i++)
+	{
+		double y2 = k * y1 - y0;
+
+		samples[i].time = 60000 + i * 100;
+		samples[i].value = 1800 + (int32_t)(y2 * 100.0);
+		y0 = y1;
+		y1 = y2;
+	}
+
+	bench("heading");
+}
+
+/* Speed in 0.01 km/h with sensor noise */
+ZTEST(timeseries, test_speed)
+{
+	int32_t speed = 2340;
+
+	for (int i = 0; i < SAMPLES; i++)
+	{
+		speed = CLAMP(speed + noise(8), 0, 4500);
+		samples[i].time = 60000 + i * 100;
+		samples[i].value = speed + noise(20);
+	}
+
+	bench("speed");
+}
+
+/* Motor current in mA, uncorrelated */
+ZTEST(timeseries, test_motor_current)
+{
+	for (int i = 0; i < SAMPLES; i++)
+	{
+		samples[i].time = 60000 + i * 100;
+		samples[i].value = rand32() % 20000;
+	}
+
+	bench("motor current");
+}
+
+/* Delta-of-delta at the edges of every bucket, each followed by its negation */
+ZTEST(timeseries, test_dod_buckets)
+{
+	static const int32_t dods[] = {0,	 1,	   63,	 64,   65,	   255,
+								   256, 257, 2047, 2048, 2049, 100000, INT32_MAX};
+	static struct sample series[2 + 2 * ARRAY_SIZE(dods)];
+	int64_t delta = 1000;
+	size_t count = 0;
+	uint32_t blocks;
+
+	series[count++] = (struct sample){.time = 0, .value = 0};
+	series[count++] = (struct sample){.time = delta, .value = 0};
+
+	for (size_t i = 0; i < ARRAY_SIZE(dods); i++)
+	{
+		series[count] = series[count - 1];
+		series[count++].time += delta + dods[i];
+		series[count] = series[count - 1];
+		series[count++].time += delta;
+	}
+
+	round_trip(series, count, sizeof(buf), &blocks);
+	zassert_equal(blocks, 1);
+	round_trip(series, count, BLOCK_SIZE, &blocks);
+}
+
+ZTEST(timeseries, test_dod_range)
+{
+	ts_block_init(&block, SERIES_ID, buf, sizeof(buf));
+
+	zassert_ok(ts_block_append(&block, 0, 0));
+	zassert_ok(ts_block_append(&block, 1000, 0));
+	zassert_equal(ts_block_append(&block, 1000 + 1000 + (int64_t)INT32_MAX + 1, 0), -ERANGE);
+	zassert_equal(block.count, 2);
+	zassert_ok(ts_block_append(&block, 1000 + 1000 + (int64_t)INT32_MAX, 0));
+}
+
+/* XOR windows of every position and width, sign changes and the extremes */
+ZTEST(timeseries, test_values)
+{
+	static const int32_t extremes[] = {INT32_MIN, INT32_MAX, 0, -1, 1, INT32_MIN,
+									   INT32_MIN, -2,		 2, -3, 3, INT32_MAX, 0};
+	static struct sample series[2000];
+	size_t count = 0;
+	uint32_t blocks;
+
+	for (int shift = 0; shift < 32; shift++)
+	{
+		for (int width = 1; width <= 32 - shift; width += 3)
+		{
+			uint32_t value = (uint32_t)BIT64_MASK(width) << shift;
+
+			series[count] = (struct sample){.time = count * 100, .value = value};
+			count++;
+			series[count] = (struct sample){.time = count * 100, .value = 0 - value};
+			count++;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(extremes); i++)
+	{
+		series[count] = (struct sample){.time = count * 100, .value = extremes[i]};
+		count++;
+	}
+
+	zassert_true(count <= ARRAY_SIZE(series));
+
+	round_trip(series, count, sizeof(buf), &blocks);
+	zassert_equal(blocks, 1);
+	round_trip(series, count, BLOCK_SIZE, &blocks);
+	round_trip(series, count, TS_BLOCK_HEADER_SIZE + 12, &blocks);
+}
+
+/* A sample that does not fit leaves the block as it was */
+ZTEST(timeseries, test_block_full)
+{
+	static uint8_t copy[BLOCK_SIZE];
+	struct ts_block saved;
+	size_t len;
+	int i;
+
+	ts_block_init(&block, SERIES_ID, buf, BLOCK_SIZE);
+
+	for (i = 0; ts_block_append(&block, i * 100, i * 7919) == 0; i++)
+	{
+	}
+
+	saved = block;
+	len = ts_block_flush(&block);
+	memcpy(copy, buf, len);
+
+	zassert_equal(ts_block_append(&block, i * 100, i * 7919), -ENOMEM);
+	zassert_equal(ts_block_flush(&block), len);
+	zassert_mem_equal(buf, copy, len);
+	zassert_equal(block.count, saved.count);
+	zassert_equal(block.bit_len, saved.bit_len);
+}
+
+/* Flushing does not end the block, blocks are self-delimiting */
+ZTEST(timeseries, test_concatenated)
+{
+	static const struct sample first[] = {{1000, 5}, {1100, 6}, {1200, 6}, {1310, -6}};
+	static const struct sample second[] = {{-5, INT32_MIN}, {-5, INT32_MAX}};
+	struct ts_block other;
+	size_t len;
+
+	ts_block_init(&block, SERIES_ID, buf, BLOCK_SIZE);
+	zassert_ok(ts_block_append(&block, first[0].time, first[0].value));
+	zassert_ok(ts_block_append(&block, first[1].time, first[1].value));
+	len = ts_block_flush(&block);
+	zassert_equal(block_check(buf, len, first, 2), len);
+
+	for (int i = 2; i < ARRAY_SIZE(first); i++)
+	{
+		zassert_ok(ts_block_append(&block, first[i].time, first[i].value));
+	}
+	len = ts_block_flush(&block);
+
+	ts_block_init(&other, SERIES_ID, &buf[len], BLOCK_SIZE);
+	zassert_ok(ts_block_append(&other, second[0].time, second[0].value));
+	zassert_ok(ts_block_append(&other, second[1].time, second[1].value));
+
+	zassert_equal(block_check(buf, len + ts_block_flush(&other), first, ARRAY_SIZE(first)),
+				  len);
+	zassert_equal(block_check(&buf[len], BLOCK_SIZE, second, ARRAY_SIZE(second)),
+				  ts_block_flush(&other));
+}
+
+ZTEST(timeseries, test_truncated)
+{
+	struct ts_block_decoder dec;
+	int64_t time;
+	int32_t value;
+	uint8_t id;
+	size_t len;
+	int err;
+
+	ts_block_init(&block, SERIES_ID, buf, BLOCK_SIZE);
+
+	for (int i = 0; i < 10; i++)
+	{
+		zassert_ok(ts_block_append(&block, i * 100 + noise(50), noise(100000)));
+	}
+
+	len = ts_block_flush(&block);
+
+	zassert_equal(ts_block_decoder_init(&dec, buf, TS_BLOCK_HEADER_SIZE - 1, &id), -EBADMSG);
+
+	for (size_t cut = TS_BLOCK_HEADER_SIZE; cut < len; cut++)
+	{
+		zassert_ok(ts_block_decoder_init(&dec, buf, cut, &id));
+
+		while ((err = ts_block_decoder_next(&dec, &time, &value)) == 0)
+		{
+		}
+
+		zassert_equal(err, -EBADMSG, "cut %u", (uint32_t)cut);
+	}
+}
+
+ZTEST_SUITE(timeseries, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,566 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Transport queues with time to live: records drain oldest first or newest first, records older
+ * than the time to live are removed before every put and get and counted with the uptime range
+ * they were enqueued in, the summary of the expired records, and expired records make room for
+ * new ones. A queue without room drops the new record, drops the oldest one, decimates or merges,
+ * falling back to dropping the oldest record, and counts what it did. Records fill the byte budget
+ * of the pool without the heap running out first, queues borrow the capacity above the minimum
+ * quotas of the others up to their maximum quota.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "txqueue.c"
+
+#define POOL_SIZE 4096
+#define TTL_S 10
+#define TTL_MS (TTL_S * MSEC_PER_SEC)
+#define RECORD_LEN 16
+#define RECORD_SIZE TXQUEUE_CHUNK_SIZE(sizeof(struct txqueue_record) + RECORD_LEN)
+#define BOUNDED_RECORDS 4
+/* The shared pool holds SHARED_RECORDS records, the borrowing queues at least BORROW_MIN and at
+ * most BORROW_MAX each
+ */
+#define SHARED_RECORDS 8
+#define BORROW_MIN 2
+#define BORROW_MAX 6
+
+/* Merges up to two records into one, concatenated */
+static size_t merge2(const void *older, size_t older_len, bool older_aggregate, const void *newer,
+					 size_t newer_len, bool newer_aggregate, const void **merged)
+{
+	static uint8_t aggregate[2 * RECORD_LEN];
+
+	if (older_aggregate || newer_aggregate || (older_len + newer_len > sizeof(aggregate)))
+	{
+		return 0;
+	}
+
+	memcpy(aggregate, older, older_len);
+	memcpy(&aggregate[older_len], newer, newer_len);
+	*merged = aggregate;
+
+	return older_len + newer_len;
+}
+
+TXQUEUE_POOL_DEFINE(pool, POOL_SIZE);
+TXQUEUE_DEFINE(history, pool, 0, POOL_SIZE, TTL_S, false, TXQUEUE_DROP_NEWEST, NULL);
+TXQUEUE_DEFINE(live, pool, 0, POOL_SIZE, TTL_S, true, TXQUEUE_DROP_NEWEST, NULL);
+TXQUEUE_DEFINE(forever, pool, 0, POOL_SIZE, 0, false, TXQUEUE_DROP_NEWEST, NULL);
+/* Room for BOUNDED_RECORDS records */
+TXQUEUE_DEFINE(bounded, pool, 0, BOUNDED_RECORDS * RECORD_SIZE, 0, false, TXQUEUE_DROP_NEWEST,
+			   merge2);
+
+
+TXQUEUE_POOL_DEFINE(shared, SHARED_RECORDS * RECORD_SIZE);
+TXQUEUE_DEFINE(borrow_a, shared, BORROW_MIN * RECORD_SIZE, BORROW_MAX * RECORD_SIZE, 0, false,
+			   TXQUEUE_DROP_NEWEST, NULL);
+TXQUEUE_DEFINE(borrow_b, shared, BORROW_MIN * RECORD_SIZE, BORROW_MAX * RECORD_SIZE, 0, false,
+			   TXQUEUE_DROP_NEWEST, NULL);
+/* Without a minimum quota */
+TXQUEUE_DEFINE(borrow_c, shared, 0, SHARED_RECORDS * RECORD_SIZE, 0, false, TXQUEUE_DROP_NEWEST,
+			   NULL);
+
+static struct txqueue *const queues[] = {&history,	&live,	   &forever, &bounded,
+										 &borrow_a, &borrow_b, &borrow_c};
+static struct txqueue_pool *const pools[] = {&pool, &shared};
+
+static int put_len(struct txqueue *queue, uint32_t seq, size_t len)
+{
+	static uint8_t record[POOL_SIZE];
+
+	memset(record, seq, len);
+	memcpy(record, &seq, sizeof(seq));
+
+	return txqueue_put(queue, record, len);
+}
+
+static int put(struct txqueue *queue, uint32_t seq)
+{
+	return put_len(queue, seq, RECORD_LEN);
+}
+
+/* Returns the sequence number of the next record, or a negative error code */
+static int get(struct txqueue *queue)
+{
+	uint8_t record[RECORD_LEN];
+	uint32_t seq;
+	int len = txqueue_get(queue, record, sizeof(record));
+
+	if (len < 0)
+	{
+		return len;
+	}
+
+	memcpy(&seq, record, sizeof(seq));
+
+	return (len == RECORD_LEN) ? (int)seq : -EMSGSIZE;
+}
+
+/* Drains the queue, the sequence numbers of merged records are listed in order */
+static void check_records(struct txqueue *queue, const uint32_t *expected, size_t count)
+{
+	uint8_t record[2 * RECORD_LEN];
+	size_t index = 0;
+	int len;
+
+	while ((len = txqueue_get(queue, record, sizeof(record))) > 0)
+	{
+		zassert_equal(len % RECORD_LEN, 0);
+
+		for (int offset = 0; offset < len; offset += RECORD_LEN)
+		{
+			uint32_t seq;
+
+			memcpy(&seq, &record[offset], sizeof(seq));
+			zassert_true(index < count, "record %u", (uint32_t)index);
+			zassert_equal(seq, expected[index], "record %u", (uint32_t)index);
+			index++;
+		}
+	}
+
+	zassert_equal(len, -ENOMSG);
+	zassert_equal(index, count);
+	zassert_equal(txqueue_bytes_get(queue), 0);
+}
+
+/* Fills the bounded queue with records 0 to BOUNDED_RECORDS - 1 */
+static void fill(enum txqueue_overflow overflow)
+{
+	txqueue_overflow_set(&bounded, overflow);
+
+	for (uint32_t seq = 0; seq < BOUNDED_RECORDS; seq++)
+	{
+		zassert_ok(put(&bounded, seq));
+	}
+}
+
+static void check_overflows(uint32_t drop_newest, uint32_t drop_oldest, uint32_t decimate,
+							uint32_t merge)
+{
+	zassert_equal(bounded.overflows[TXQUEUE_DROP_NEWEST], drop_newest);
+	zassert_equal(bounded.overflows[TXQUEUE_DROP_OLDEST], drop_oldest);
+	zassert_equal(bounded.overflows[TXQUEUE_DECIMATE], decimate);
+	zassert_equal(bounded.overflows[TXQUEUE_MERGE], merge);
+}
+
+static void check_expired(struct txqueue *queue, uint32_t expired, int64_t oldest, int64_t newest)
+{
+	int64_t expired_oldest;
+	int64_t expired_newest;
+
+	zassert_equal(txqueue_expired_take(queue, &expired_oldest, &expired_newest), expired);
+
+	if (expired > 0)
+	{
+		zassert_equal(expired_oldest, oldest);
+		zassert_equal(expired_newest, newest);
+	}
+}
+
+/* Frees all records and restores the queues as defined */
+static void txqueue_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	for (size_t i = 0; i < ARRAY_SIZE(queues); i++)
+	{
+		struct txqueue *queue = queues[i];
+		struct txqueue_record *record;
+
+		while ((record = record_get(sys_dlist_peek_head(&queue->records))) != NULL)
+		{
+			record_free(queue, record);
+		}
+
+		queue->bytes_high_water = 0;
+		queue->used_high_water = 0;
+		queue->overflow = TXQUEUE_DROP_NEWEST;
+		memset(queue->overflows, 0, sizeof(queue->overflows));
+		queue->expired = 0;
+	}
+
+	bounded.merge = merge2;
+
+	for (size_t i = 0; i < ARRAY_SIZE(pools); i++)
+	{
+		pools[i]->used = 0;
+		pools[i]->reserved = 0;
+		pools[i]->high_water = 0;
+		pools[i]->fragmented = 0;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(queues); i++)
+	{
+		txqueue_init(queues[i]);
+	}
+}
+
+ZTEST(txqueue, test_oldest_first)
+{
+	for (uint32_t seq = 0; seq < 5; seq++)
+	{
+		zassert_ok(put(&history, seq));
+	}
+
+	zassert_equal(txqueue_num_used_get(&history), 5);
+	zassert_equal(get(&history), 0);
+	zassert_equal(get(&history), 1);
+	zassert_ok(put(&history, 5));
+
+	for (uint32_t seq = 2; seq <= 5; seq++)
+	{
+		zassert_equal(get(&history), seq);
+	}
+
+	zassert_equal(get(&history), -ENOMSG);
+	zassert_equal(txqueue_num_used_get(&history), 0);
+	zassert_equal(txqueue_bytes_get(&history), 0);
+	zassert_equal(pool.used, 0);
+}
+
+ZTEST(txqueue, test_newest_first)
+{
+	for (uint32_t seq = 0; seq < 5; seq++)
+	{
+		zassert_ok(put(&live, seq));
+	}
+
+	zassert_equal(get(&live), 4);
+	zassert_equal(get(&live), 3);
+	zassert_ok(put(&live, 5));
+	zassert_equal(get(&live), 5);
+
+	for (int seq = 2; seq >= 0; seq--)
+	{
+		zassert_equal(get(&live), seq);
+	}
+
+	zassert_equal(get(&live), -ENOMSG);
+	zassert_equal(pool.used, 0);
+}
+
+/* A taken record keeps its room until it is freed */
+ZTEST(txqueue, test_take_free)
+{
+	size_t bytes;
+	size_t len;
+	uint8_t *record;
+
+	zassert_ok(put(&history, 7));
+	bytes = txqueue_bytes_get(&history);
+	zassert_true(bytes > RECORD_LEN);
+
+	record = txqueue_take(&history, &len);
+	zassert_not_null(record);
+	zassert_equal(len, RECORD_LEN);
+	zassert_equal(record[0], 7);
+	zassert_equal(txqueue_num_used_get(&history), 0);
+	zassert_equal(txqueue_bytes_get(&history), bytes);
+	zassert_is_null(txqueue_take(&history, &len));
+
+	txqueue_free(&history, record);
+	zassert_equal(txqueue_bytes_get(&history), 0);
+	zassert_equal(pool.used, 0);
+	zassert_equal(history.used_high_water, 1);
+	zassert_equal(history.bytes_high_water, bytes);
+}
+
+/* Records expire once they are older than the time to live, the summary covers the uptime range
+ * they were enqueued in and is reset when taken
+ */
+ZTEST(txqueue, test_ttl)
+{
+	int64_t start = k_uptime_get();
+
+	zassert_ok(put(&history, 0));
+	k_sleep(K_MSEC(1000));
+	zassert_ok(put(&history, 1));
+	k_sleep(K_MSEC(4000));
+	zassert_ok(put(&history, 2));
+
+	/* As old as the time to live */
+	k_sleep(K_MSEC(5000));
+	zassert_equal(get(&history), 0);
+	check_expired(&history, 0, 0, 0);
+
+	k_sleep(K_MSEC(1001));
+	zassert_equal(get(&history), 2);
+	check_expired(&history, 1, start + 1000, start + 1000);
+	check_expired(&history, 0, 0, 0);
+
+	zassert_ok(put(&history, 3));
+	k_sleep(K_MSEC(1000));
+	zassert_ok(put(&history, 4));
+	k_sleep(K_MSEC(3 * TTL_MS));
+	zassert_equal(txqueue_num_used_get(&history), 2);
+	zassert_equal(get(&history), -ENOMSG);
+	zassert_equal(txqueue_num_used_get(&history), 0);
+	zassert_equal(txqueue_bytes_get(&history), 0);
+	check_expired(&history, 2, start + 11001, start + 12001);
+	check_expired(&history, 0, 0, 0);
+}
+
+/* The newest record is only taken once the expired ones are gone */
+ZTEST(txqueue, test_ttl_newest_first)
+{
+	int64_t start = k_uptime_get();
+
+	zassert_ok(put(&live, 0));
+	k_sleep(K_MSEC(6000));
+	zassert_ok(put(&live, 1));
+	k_sleep(K_MSEC(6000));
+	zassert_ok(put(&live, 2));
+
+	zassert_equal(get(&live), 2);
+	zassert_equal(txqueue_num_used_get(&live), 1);
+	check_expired(&live, 1, start, start);
+
+	k_sleep(K_MSEC(TTL_MS));
+	zassert_equal(get(&live), -ENOMSG);
+	check_expired(&live, 1, start + 6000, start + 6000);
+}
+
+/* Expired records are removed before a put, they do not take the room of new records */
+ZTEST(txqueue, test_ttl_room)
+{
+	int64_t start = k_uptime_get();
+	uint32_t count = 0;
+
+	while (put(&history, count) == 0)
+	{
+		count++;
+	}
+
+	zassert_true(count > 1);
+	zassert_equal(history.overflows[TXQUEUE_DROP_NEWEST], 1);
+
+	k_sleep(K_MSEC(TTL_MS + 1));
+	zassert_ok(put(&history, count));
+	zassert_equal(history.overflows[TXQUEUE_DROP_NEWEST], 1);
+	zassert_equal(txqueue_num_used_get(&history), 1);
+	check_expired(&history, count, start, start);
+	zassert_equal(get(&history), count);
+}
+
+/* Without time to live records never expire */
+ZTEST(txqueue, test_no_ttl)
+{
+	zassert_ok(put(&forever, 0));
+	k_sleep(K_MSEC(24 * 60 * 60 * MSEC_PER_SEC));
+	zassert_ok(put(&forever, 1));
+	zassert_equal(get(&forever), 0);
+	zassert_equal(get(&forever), 1);
+	check_expired(&forever, 0, 0, 0);
+}
+
+ZTEST(txqueue, test_drop_newest)
+{
+	static const uint32_t expected[] = {0, 1, 2, 3};
+
+	fill(TXQUEUE_DROP_NEWEST);
+	zassert_equal(put(&bounded, 4), -ENOMSG);
+	zassert_equal(put(&bounded, 5), -ENOMSG);
+	check_overflows(2, 0, 0, 0);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+ZTEST(txqueue, test_drop_oldest)
+{
+	static const uint32_t expected[] = {2, 3, 4, 5};
+
+	fill(TXQUEUE_DROP_OLDEST);
+	zassert_ok(put(&bounded, 4));
+	zassert_ok(put(&bounded, 5));
+	check_overflows(0, 2, 0, 0);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+/* Every second record is kept, counting back from the newest one */
+ZTEST(txqueue, test_decimate)
+{
+	static const uint32_t expected[] = {3, 5, 6};
+
+	fill(TXQUEUE_DECIMATE);
+	zassert_ok(put(&bounded, 4));
+	zassert_equal(txqueue_num_used_get(&bounded), 3);
+	zassert_ok(put(&bounded, 5));
+	check_overflows(0, 0, 1, 0);
+
+	/* 1, 3, 4, 5 decimated to 3, 5 */
+	zassert_ok(put(&bounded, 6));
+	check_overflows(0, 0, 2, 0);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+/* A single record cannot be decimated, it is dropped instead */
+ZTEST(txqueue, test_decimate_single)
+{
+	static const uint32_t expected[] = {1};
+	size_t len = bounded.max_bytes - RECORD_SIZE;
+
+	txqueue_overflow_set(&bounded, TXQUEUE_DECIMATE);
+	zassert_ok(put_len(&bounded, 0, len));
+	zassert_ok(put(&bounded, 1));
+	check_overflows(0, 1, 0, 0);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+/* The oldest records that can be merged are, until there is room. Without records that can be
+ * merged the oldest one is dropped.
+ */
+ZTEST(txqueue, test_merge)
+{
+	static const uint32_t expected[] = {2, 3, 4, 5};
+
+	fill(TXQUEUE_MERGE);
+
+	/* 0 and 1 merged, then 2 and 3 */
+	zassert_ok(put(&bounded, 4));
+	check_overflows(0, 0, 0, 2);
+	zassert_equal(txqueue_num_used_get(&bounded), 3);
+
+	/* Aggregates are not merged again, [0, 1] is dropped */
+	zassert_ok(put(&bounded, 5));
+	check_overflows(0, 1, 0, 2);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+ZTEST(txqueue, test_merge_none)
+{
+	static const uint32_t expected[] = {1, 2, 3, 4};
+
+	bounded.merge = NULL;
+	fill(TXQUEUE_MERGE);
+	zassert_ok(put(&bounded, 4));
+	check_overflows(0, 1, 0, 0);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+/* A record beyond the maximum quota is dropped right away, whatever the policy */
+ZTEST(txqueue, test_too_large)
+{
+	static const uint32_t expected[] = {0, 1, 2, 3};
+
+	fill(TXQUEUE_DROP_OLDEST);
+	zassert_equal(put_len(&bounded, 4, bounded.max_bytes), -ENOMSG);
+	check_overflows(1, 0, 0, 0);
+	check_records(&bounded, expected, ARRAY_SIZE(expected));
+}
+
+/* The quotas count the heap chunks of the records, the heap has room for the whole budget */
+ZTEST(txqueue, test_heap_overhead)
+{
+	uint32_t count = 0;
+
+	while (put(&history, count) == 0)
+	{
+		count++;
+	}
+
+	zassert_equal(count, POOL_SIZE / RECORD_SIZE);
+	zassert_equal(pool.used, count * RECORD_SIZE);
+	zassert_equal(pool.fragmented, 0);
+	zassert_equal(history.overflows[TXQUEUE_DROP_NEWEST], 1);
+
+	/* The same with records of all sizes */
+	for (uint32_t seq = 0; seq < count; seq++)
+	{
+		zassert_equal(get(&history), seq);
+	}
+
+	for (count = 0; put_len(&history, count, sizeof(uint32_t) + count % 97) == 0; count++)
+	{
+	}
+
+	zassert_true(pool.used + record_size(sizeof(uint32_t) + count % 97) > POOL_SIZE);
+	zassert_equal(pool.fragmented, 0);
+	zassert_equal(history.overflows[TXQUEUE_DROP_NEWEST], 2);
+	TC_PRINT("%u records of %u bytes in a %u byte budget, heap of %u bytes\n",
+			 POOL_SIZE / (uint32_t)RECORD_SIZE, RECORD_LEN, POOL_SIZE,
+			 (uint32_t)TXQUEUE_HEAP_SIZE(POOL_SIZE));
+}
+
+/* A full queue makes room within its own records and never takes the minimum quota of another
+ * one, capacity above the minimum quotas goes to the queue that asks first
+ */
+ZTEST(txqueue, test_borrow)
+{
+	uint32_t count;
+
+	/* The minimum quota of b stays reserved */
+	for (count = 0; put(&borrow_a, count) == 0; count++)
+	{
+	}
+
+	zassert_equal(count, BORROW_MAX);
+	zassert_equal(txqueue_capacity_get(&borrow_a), BORROW_MAX * RECORD_SIZE);
+	zassert_equal(txqueue_capacity_get(&borrow_b), BORROW_MIN * RECORD_SIZE);
+	zassert_equal(txqueue_capacity_get(&borrow_c), 0);
+
+	txqueue_overflow_set(&borrow_b, TXQUEUE_DROP_OLDEST);
+	txqueue_overflow_set(&borrow_c, TXQUEUE_DROP_OLDEST);
+
+	for (count = 0; count < BORROW_MIN + 1; count++)
+	{
+		zassert_ok(put(&borrow_b, count));
+	}
+
+	zassert_equal(txqueue_num_used_get(&borrow_b), BORROW_MIN);
+	zassert_equal(borrow_b.overflows[TXQUEUE_DROP_OLDEST], 1);
+
+	/* A queue without records and without room drops the new one */
+	zassert_equal(put(&borrow_c, 0), -ENOMSG);
+	zassert_equal(borrow_c.overflows[TXQUEUE_DROP_NEWEST], 1);
+	zassert_equal(shared.used, SHARED_RECORDS * RECORD_SIZE);
+	zassert_equal(shared.high_water, SHARED_RECORDS * RECORD_SIZE);
+
+	/* b borrows what a gives back, up to its maximum quota */
+	for (count = 0; count < BORROW_MAX; count++)
+	{
+		zassert_true(get(&borrow_a) >= 0);
+	}
+
+	zassert_equal(txqueue_capacity_get(&borrow_b), BORROW_MAX * RECORD_SIZE);
+
+	for (count = 0; count < BORROW_MAX - BORROW_MIN; count++)
+	{
+		zassert_ok(put(&borrow_b, count));
+	}
+
+	zassert_equal(borrow_b.overflows[TXQUEUE_DROP_OLDEST], 1);
+	zassert_ok(put(&borrow_b, count));
+	zassert_equal(borrow_b.overflows[TXQUEUE_DROP_OLDEST], 2);
+	zassert_equal(txqueue_num_used_get(&borrow_b), BORROW_MAX);
+
+	/* The minimum quota of a is back, c gets nothing */
+	zassert_equal(txqueue_capacity_get(&borrow_a), BORROW_MIN * RECORD_SIZE);
+	zassert_equal(put(&borrow_c, 0), -ENOMSG);
+	zassert_equal(borrow_c.overflows[TXQUEUE_DROP_NEWEST], 2);
+	zassert_equal(shared.reserved, BORROW_MIN * RECORD_SIZE);
+	zassert_equal(shared.fragmented, 0);
+
+	zassert_ok(put(&borrow_a, 0));
+	zassert_ok(put(&borrow_a, 1));
+	zassert_equal(put(&borrow_a, 2), -ENOMSG);
+	zassert_equal(shared.used, SHARED_RECORDS * RECORD_SIZE);
+}
+
+ZTEST(txqueue, test_overflow_names)
+{
+	for (int overflow = 0; overflow < TXQUEUE_OVERFLOW_COUNT; overflow++)
+	{
+		zassert_equal(txqueue_overflow_parse(txqueue_overflow_name(overflow)), overflow);
+	}
+
+	zassert_equal(txqueue_overflow_parse("decimate"), TXQUEUE_DECIMATE);
+	zassert_equal(txqueue_overflow_parse("drop"), -EINVAL);
+	zassert_str_equal(txqueue_overflow_name(TXQUEUE_OVERFLOW_COUNT), "unknown");
+}
+
+ZTEST_SUITE(txqueue, NULL, NULL, txqueue_before, NULL, NULL);
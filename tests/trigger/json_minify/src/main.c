@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* JSON filter of the trigger module: valid texts against their minified form, whitespace inside
+ * strings, truncated texts, trailing data, invalid escapes, numbers and literals, and the nesting
+ * limit. Reports the bytes saved and the time per line over the recorded Nina trace.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "json_minify.h"
+#include "nina_trace.h"
+
+#define BUF_SIZE 512
+#define ROUNDS 20000
+
+static char buf[BUF_SIZE];
+
+/* Minifies a copy of the text, all texts fit the buffer */
+static int minify(const char *text, size_t len)
+{
+	memcpy(buf, text, len);
+
+	return json_minify(buf, len);
+}
+
+static void check_valid(const char *text, const char *expected)
+{
+	int len = minify(text, strlen(text));
+
+	zassert_equal(len, strlen(expected), "%s", text);
+	zassert_mem_equal(buf, expected, len, "%s", text);
+}
+
+static void check_invalid(const char *text, int err)
+{
+	zassert_equal(minify(text, strlen(text)), err, "%s", text);
+}
+
+ZTEST(json_minify, test_valid)
+{
+	check_valid("{}", "{}");
+	check_valid("[]", "[]");
+	check_valid(" \t\r\n{ } \r\n", "{}");
+	check_valid("[ [ ] , { } ]", "[[],{}]");
+	check_valid("{ \"a\" : 1 , \"b\" : [ true , false , null ] }",
+				"{\"a\":1,\"b\":[true,false,null]}");
+	check_valid("[0, -0, 1.5, -12.25e+3, 3E-2, 1e9, 0.0]", "[0,-0,1.5,-12.25e+3,3E-2,1e9,0.0]");
+	check_valid("{\"s\" : \"\\\" \\\\ \\/ \\b \\f \\n \\r \\t \\u00e9 \\uABCD\"}",
+				"{\"s\":\"\\\" \\\\ \\/ \\b \\f \\n \\r \\t \\u00e9 \\uABCD\"}");
+	check_valid("{\"nested\" : {\"a\" : [ {\"b\" : { } } ] } }",
+				"{\"nested\":{\"a\":[{\"b\":{}}]}}");
+}
+
+/* Whitespace and JSON punctuation inside strings is kept */
+ZTEST(json_minify, test_string_whitespace)
+{
+	check_valid("{ \"a key\" : \"  two  spaces \\t , : { } [ ] \" }",
+				"{\"a key\":\"  two  spaces \\t , : { } [ ] \"}");
+	check_valid("[ \" \" , \"\" ]", "[\" \",\"\"]");
+	check_valid("{\"\\\"\" : \" \\\" \"}", "{\"\\\"\":\" \\\" \"}");
+}
+
+/* Every prefix of a valid text is rejected */
+ZTEST(json_minify, test_truncated)
+{
+	static const char *const texts[] = {
+		"{\"speed\" : \"23.41\", \"cadence\" : 81, \"lights\" : true, \"errors\" : [1, -2.5e3]}",
+		"[{\"a\":null},[false,\"\\u00e9\"]]",
+	};
+
+	for (size_t t = 0; t < ARRAY_SIZE(texts); t++)
+	{
+		size_t len = strlen(texts[t]);
+
+		for (size_t cut = 0; cut < len; cut++)
+		{
+			zassert_equal(minify(texts[t], cut), -EBADMSG, "%s cut %u", texts[t],
+						  (uint32_t)cut);
+		}
+
+		zassert_true(minify(texts[t], len) > 0);
+	}
+}
+
+ZTEST(json_minify, test_trailing)
+{
+	check_invalid("{}{}", -EBADMSG);
+	check_invalid("{} []", -EBADMSG);
+	check_invalid("{\"a\":1}}", -EBADMSG);
+	check_invalid("[1]]", -EBADMSG);
+	check_invalid("{\"a\":1} x", -EBADMSG);
+	check_invalid("[1],", -EBADMSG);
+}
+
+ZTEST(json_minify, test_escapes)
+{
+	check_invalid("[\"\\x\"]", -EBADMSG);
+	check_invalid("[\"\\'\"]", -EBADMSG);
+	check_invalid("[\"\\u12\"]", -EBADMSG);
+	check_invalid("[\"\\u12G4\"]", -EBADMSG);
+	check_invalid("[\"\\\"]", -EBADMSG);
+	check_invalid("[\"tab\there\"]", -EBADMSG);
+	check_invalid("[\"line\nbreak\"]", -EBADMSG);
+}
+
+ZTEST(json_minify, test_syntax)
+{
+	static const char *const texts[] = {
+		"",
+		"   ",
+		"\"text\"",
+		"42",
+		"true",
+		"{\"a\"}",
+		"{\"a\":}",
+		"{\"a\" 1}",
+		"{\"a\":1,}",
+		"[1,]",
+		"[,1]",
+		"[1 2]",
+		"{a:1}",
+		"{\"a\":1]",
+		"[1}",
+		"[01]",
+		"[1.]",
+		"[.5]",
+		"[1e]",
+		"[-]",
+		"[+1]",
+		"[tru]",
+		"[nul]",
+		"[True]",
+		"{1:2}",
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(texts); i++)
+	{
+		check_invalid(texts[i], -EBADMSG);
+	}
+}
+
+/* Nesting up to JSON_MINIFY_MAX_DEPTH is accepted, one level more is not */
+ZTEST(json_minify, test_depth)
+{
+	char text[2 * (JSON_MINIFY_MAX_DEPTH + 1) + 1];
+	size_t depth;
+
+	for (depth = JSON_MINIFY_MAX_DEPTH; depth <= JSON_MINIFY_MAX_DEPTH + 1; depth++)
+	{
+		for (size_t i = 0; i < depth; i++)
+		{
+			text[i] = '[';
+			text[2 * depth - 1 - i] = ']';
+		}
+
+		text[2 * depth] = '\0';
+
+		if (depth <= JSON_MINIFY_MAX_DEPTH)
+		{
+			check_valid(text, text);
+		}
+		else
+		{
+			check_invalid(text, -E2BIG);
+		}
+	}
+
+	/* Objects and arrays count alike */
+	check_invalid("{\"a\":[{\"b\":[{\"c\":[{\"d\":[{\"e\":[{\"f\":[{\"g\":[{\"h\":[{\"i\":[{"
+				  "\"j\":[{\"k\":[{\"l\":[{\"m\":[{\"n\":[{\"o\":[{\"p\":[{\"q\":[]}]}]}]}]}]}"
+				  "]}]}]}]}]}]}]}]}]}]}]}",
+				  -E2BIG);
+}
+
+/* The recorded Nina lines, minified in their payload buffer */
+ZTEST(json_minify, test_trace)
+{
+	size_t lens[NINA_TRACE_LINES];
+	uint32_t bytes_in = 0;
+	uint32_t bytes_out = 0;
+	uint32_t lines = ROUNDS * NINA_TRACE_LINES;
+	int64_t start;
+	int64_t copy_ns;
+	int64_t ns;
+
+	for (size_t i = 0; i < NINA_TRACE_LINES; i++)
+	{
+		int len;
+
+		lens[i] = strlen(nina_trace[i]);
+		len = minify(nina_trace[i], lens[i]);
+
+		zassert_true(len > 0, "line %u", (uint32_t)i);
+		bytes_in += lens[i];
+		bytes_out += len;
+	}
+
+	/* Copying the lines alone, subtracted from the time of the filter */
+	start = bench_cpu_ns();
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (size_t i = 0; i < NINA_TRACE_LINES; i++)
+		{
+			memcpy(buf, nina_trace[i], lens[i]);
+			compiler_barrier();
+		}
+	}
+
+	copy_ns = bench_cpu_ns() - start;
+	start = bench_cpu_ns();
+
+	for (int round = 0; round < ROUNDS; round++)
+	{
+		for (size_t i = 0; i < NINA_TRACE_LINES; i++)
+		{
+			memcpy(buf, nina_trace[i], lens[i]);
+			json_minify(buf, lens[i]);
+		}
+	}
+
+	ns = MAX(bench_cpu_ns() - start - copy_ns, 0);
+
+	TC_PRINT("%u lines, %u -> %u bytes, %u.%u %% saved, %u ns/line, %u ns/KB\n",
+			 (uint32_t)NINA_TRACE_LINES, bytes_in, bytes_out,
+			 (bytes_in - bytes_out) * 100 / bytes_in,
+			 (bytes_in - bytes_out) * 1000 / bytes_in % 10, (uint32_t)(ns / lines),
+			 (uint32_t)(ns * 1024 / ((int64_t)bytes_in * ROUNDS)));
+}
+
+ZTEST_SUITE(json_minify, NULL, NULL, NULL, NULL, NULL);
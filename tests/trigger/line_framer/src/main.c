@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Line framer of the trigger module: the word at a time search against memchr, lines split at
+ * every possible chunk boundary, overruns and resets, and the search speed against the byte loop
+ * it replaced.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "line_framer.h"
+#include "nina_trace.h"
+
+#define TRACE_SIZE (16 * 1024)
+#define CARRY_SIZE 512
+#define ROUNDS 500
+
+static uint8_t trace[TRACE_SIZE];
+static size_t trace_len;
+static uint32_t trace_lines;
+
+static struct line_framer framer;
+static char carry[CARRY_SIZE];
+
+/* Lines received by the callback, checked against the trace */
+static uint32_t lines;
+static uint32_t mismatches;
+static char last_line[CARRY_SIZE + 1];
+
+static void line_cb(const char *line, size_t line_size, void *user_data)
+{
+	const char *expected = nina_trace[lines % NINA_TRACE_LINES];
+
+	ARG_UNUSED(user_data);
+
+	if ((line_size != strlen(expected)) || (memcmp(line, expected, line_size) != 0))
+	{
+		mismatches++;
+	}
+
+	memcpy(last_line, line, line_size);
+	last_line[line_size] = '\0';
+	lines++;
+}
+
+static void feed_string(const char *s)
+{
+	line_framer_feed(&framer, (const uint8_t *)s, strlen(s));
+}
+
+/* Byte at a time search of the framer before the word at a time version */
+static const uint8_t *__noinline find_bytewise(const uint8_t *data, size_t len, uint8_t byte)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		if (data[i] == byte)
+		{
+			return &data[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void *framer_setup(void)
+{
+	trace_len = nina_trace_fill(trace, sizeof(trace), '\n', &trace_lines);
+
+	return NULL;
+}
+
+static void framer_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	lines = 0;
+	mismatches = 0;
+	line_framer_init(&framer, '\n', carry, sizeof(carry), line_cb, NULL);
+}
+
+/* Every alignment, length and match position, with bytes that set the high bit of a word */
+ZTEST(line_framer, test_find_memchr)
+{
+	static const uint8_t fill[] = {0x01, 0x7F, 0x80, 0xFE, 0xFF, 0x0A, 0x00};
+	uint8_t buf[64 + sizeof(uintptr_t)];
+
+	for (size_t f = 0; f < ARRAY_SIZE(fill); f++)
+	{
+		for (size_t b = 0; b < ARRAY_SIZE(fill); b++)
+		{
+			if (fill[f] == fill[b])
+			{
+				continue;
+			}
+
+			for (size_t offset = 0; offset < sizeof(uintptr_t); offset++)
+			{
+				for (size_t len = 0; len <= 64; len++)
+				{
+					for (size_t pos = 0; pos <= len; pos++)
+					{
+						uint8_t *data = &buf[offset];
+
+						memset(buf, fill[f], sizeof(buf));
+						if (pos < len)
+						{
+							data[pos] = fill[b];
+						}
+
+						zassert_equal_ptr(line_framer_find(data, len, fill[b]),
+										  memchr(data, fill[b], len),
+										  "fill 0x%02x byte 0x%02x offset %u len %u",
+										  fill[f], fill[b], offset, len);
+					}
+				}
+			}
+		}
+	}
+}
+
+/* The first of several matches in one word */
+ZTEST(line_framer, test_find_first)
+{
+	static const uint8_t data[] = "ab\nc\n\nd\n";
+
+	zassert_equal_ptr(line_framer_find(data, sizeof(data) - 1, '\n'), &data[2]);
+	zassert_equal_ptr(line_framer_find(&data[3], sizeof(data) - 4, '\n'), &data[4]);
+	zassert_is_null(line_framer_find(data, 2, '\n'));
+}
+
+/* The trace comes out unchanged no matter where the chunks end */
+ZTEST(line_framer, test_chunk_boundaries)
+{
+	for (size_t chunk = 1; chunk <= 300; chunk++)
+	{
+		framer_before(NULL);
+
+		for (size_t i = 0; i < trace_len; i += chunk)
+		{
+			line_framer_feed(&framer, &trace[i], MIN(chunk, trace_len - i));
+		}
+
+		zassert_equal(lines, trace_lines, "chunk %u", chunk);
+		zassert_equal(mismatches, 0, "chunk %u", chunk);
+		zassert_equal(framer.lines, trace_lines);
+		zassert_equal(framer.overruns, 0);
+		zassert_equal(framer.carry_len, 0);
+	}
+}
+
+ZTEST(line_framer, test_empty_lines)
+{
+	feed_string("\n\n");
+	feed_string(nina_trace[0]);
+	feed_string("\n\n\n");
+
+	zassert_equal(lines, 1);
+	zassert_equal(mismatches, 0);
+}
+
+/* A line longer than the carry buffer is dropped, the framer recovers at the next delimiter */
+ZTEST(line_framer, test_overrun)
+{
+	static char long_line[CARRY_SIZE + 32];
+
+	memset(long_line, 'x', sizeof(long_line) - 1);
+
+	/* Split across chunks, overflowing the carry buffer */
+	feed_string(long_line);
+	feed_string("\n");
+	feed_string(nina_trace[0]);
+	feed_string("\n");
+
+	zassert_equal(framer.overruns, 1);
+	zassert_equal(lines, 1);
+	zassert_equal(mismatches, 0);
+
+	/* Completely contained in one chunk */
+	long_line[sizeof(long_line) - 2] = '\n';
+	feed_string(long_line);
+	feed_string(nina_trace[1]);
+	feed_string("\n");
+
+	zassert_equal(framer.overruns, 2);
+	zassert_equal(lines, 2);
+	zassert_equal(mismatches, 0);
+}
+
+/* Exactly the size of the carry buffer still fits */
+ZTEST(line_framer, test_carry_full)
+{
+	static char line[CARRY_SIZE + 1];
+
+	memset(line, 'y', CARRY_SIZE);
+	line_framer_feed(&framer, (const uint8_t *)line, CARRY_SIZE / 2);
+	line_framer_feed(&framer, (const uint8_t *)&line[CARRY_SIZE / 2], CARRY_SIZE / 2);
+	feed_string("\n");
+
+	zassert_equal(framer.overruns, 0);
+	zassert_equal(framer.lines, 1);
+	zassert_equal(strlen(last_line), CARRY_SIZE);
+}
+
+/* After lost data the rest of the interrupted line is dropped */
+ZTEST(line_framer, test_reset)
+{
+	feed_string("{\"speed\":");
+	line_framer_reset(&framer);
+	feed_string("\"23.41\"}\n");
+	feed_string(nina_trace[0]);
+	feed_string("\n");
+
+	zassert_equal(framer.overruns, 1);
+	zassert_equal(lines, 1);
+	zassert_equal(mismatches, 0);
+}
+
+/* A new delimiter starts a new line right away */
+ZTEST(line_framer, test_restart)
+{
+	feed_string("garbage");
+	line_framer_restart(&framer, '\0');
+	line_framer_feed(&framer, (const uint8_t *)nina_trace[0], strlen(nina_trace[0]) + 1);
+
+	zassert_equal(framer.overruns, 0);
+	zassert_equal(lines, 1);
+	zassert_equal(mismatches, 0);
+}
+
+static void bench_find(const char *name,
+					   const uint8_t *(*find)(const uint8_t *data, size_t len, uint8_t byte))
+{
+	uint32_t found = 0;
+	int64_t start = bench_cpu_ns();
+	int64_t ns;
+
+	for (int i = 0; i < ROUNDS; i++)
+	{
+		const uint8_t *data = trace;
+		const uint8_t *end = trace + trace_len;
+		const uint8_t *delim;
+
+		while ((delim = find(data, end - data, '\n')) != NULL)
+		{
+			found++;
+			data = delim + 1;
+		}
+	}
+
+	ns = MAX(bench_cpu_ns() - start, 1);
+	zassert_equal(found, trace_lines * ROUNDS, "%s", name);
+
+	TC_PRINT("%-10s %6u MB/s, %3u ns/line\n", name,
+			 (uint32_t)((int64_t)trace_len * ROUNDS * NSEC_PER_SEC / ns / 1000000),
+			 (uint32_t)(ns / found));
+}
+
+static const uint8_t *find_memchr(const uint8_t *data, size_t len, uint8_t byte)
+{
+	return memchr(data, byte, len);
+}
+
+ZTEST(line_framer, test_find_speed)
+{
+	bench_find("bytewise", find_bytewise);
+	bench_find("word", line_framer_find);
+	bench_find("memchr", find_memchr);
+}
+
+ZTEST_SUITE(line_framer, NULL, framer_setup, framer_before, NULL, NULL);
@@ -0,0 +1,487 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Binary framing of the Nina link: COBS block boundaries, CRC and COBS errors, frames split into
+ * chunks by the line framer, and the baud rate negotiation against a simulated Nina module.
+ */
+
+#include <zephyr/ztest.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/byteorder.h>
+
+#include "line_framer.h"
+#include "nina_link.h"
+#include "nina_trace.h"
+
+#define MAX_PAYLOAD 600
+#define DEFAULT_BAUDRATE 115200
+
+static uint8_t payload[MAX_PAYLOAD];
+static uint8_t frame[NINA_LINK_ENCODED_SIZE(MAX_PAYLOAD)];
+static uint8_t decoded[MAX_PAYLOAD + NINA_LINK_FRAME_OVERHEAD];
+
+/* Payload without zeros, or with a zero every seventh byte */
+static void payload_fill(size_t len, bool zeros)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		payload[i] = (zeros && (i % 7 == 0)) ? 0 : (uint8_t)(i % 255 + 1);
+	}
+}
+
+static void round_trip(size_t len)
+{
+	int frame_size = nina_link_frame_encode(NINA_LINK_FRAME_DATA, payload, len, frame,
+											sizeof(frame));
+	const uint8_t *data;
+	uint8_t type;
+	int decoded_len;
+
+	zassert_true(frame_size > 0, "len %u", len);
+	zassert_true(frame_size <= NINA_LINK_ENCODED_SIZE(len), "len %u", len);
+	zassert_equal(frame[frame_size - 1], NINA_LINK_DELIMITER);
+	zassert_is_null(memchr(frame, NINA_LINK_DELIMITER, frame_size - 1), "len %u", len);
+
+	decoded_len = nina_link_frame_decode(frame, frame_size - 1, decoded, sizeof(decoded), &type,
+										 &data);
+
+	zassert_equal(decoded_len, len);
+	zassert_equal(type, NINA_LINK_FRAME_DATA);
+	zassert_mem_equal(data, payload, len);
+}
+
+ZTEST(nina_link, test_round_trip)
+{
+	static const size_t lens[] = {0, 1, 2, 250, 251, 252, 253, 254, 255, 256, 504, 505, 506, 507};
+
+	for (size_t i = 0; i < ARRAY_SIZE(lens); i++)
+	{
+		payload_fill(lens[i], false);
+		round_trip(lens[i]);
+
+		payload_fill(lens[i], true);
+		round_trip(lens[i]);
+	}
+}
+
+/* Payload of len bytes for which the whole frame, CRC included, is free of zeros */
+static void payload_fill_nonzero_frame(size_t len)
+{
+	for (uint8_t fill = 1; fill != 0; fill++)
+	{
+		uint8_t type = NINA_LINK_FRAME_DATA;
+		uint16_t crc;
+
+		memset(payload, fill, len);
+		crc = crc16_itu_t(0xFFFF, &type, 1);
+		crc = crc16_itu_t(crc, payload, len);
+
+		if (((crc & 0xFF) != 0) && ((crc >> 8) != 0))
+		{
+			return;
+		}
+	}
+
+	ztest_test_fail();
+}
+
+static int encode_nonzero_frame(size_t frame_len)
+{
+	size_t len = frame_len - NINA_LINK_FRAME_OVERHEAD;
+	int frame_size;
+
+	payload_fill_nonzero_frame(len);
+	frame_size = nina_link_frame_encode(NINA_LINK_FRAME_DATA, payload, len, frame,
+										NINA_LINK_ENCODED_SIZE(len));
+
+	zassert_true(frame_size > 0, "frame %u", frame_len);
+	round_trip(len);
+
+	return frame_size;
+}
+
+/* 253 non-zero bytes fit one block */
+ZTEST(nina_link, test_cobs_253)
+{
+	int frame_size = encode_nonzero_frame(253);
+
+	zassert_equal(frame_size, 1 + 253 + 1);
+	zassert_equal(frame[0], 0xFE);
+}
+
+/* 254 non-zero bytes fill a block, the frame ends with an empty block of its own */
+ZTEST(nina_link, test_cobs_254)
+{
+	int frame_size = encode_nonzero_frame(254);
+
+	zassert_equal(frame_size, 1 + 254 + 1 + 1);
+	zassert_equal(frame_size, NINA_LINK_ENCODED_SIZE(254 - NINA_LINK_FRAME_OVERHEAD));
+	zassert_equal(frame[0], 0xFF);
+	zassert_equal(frame[255], 0x01);
+	zassert_equal(frame[256], NINA_LINK_DELIMITER);
+}
+
+/* 255 non-zero bytes, one byte in the second block */
+ZTEST(nina_link, test_cobs_255)
+{
+	int frame_size = encode_nonzero_frame(255);
+
+	zassert_equal(frame_size, 1 + 254 + 1 + 1 + 1);
+	zassert_equal(frame[0], 0xFF);
+	zassert_equal(frame[255], 0x02);
+	zassert_equal(frame[257], NINA_LINK_DELIMITER);
+}
+
+/* Two full blocks */
+ZTEST(nina_link, test_cobs_508)
+{
+	int frame_size = encode_nonzero_frame(508);
+
+	zassert_equal(frame_size, NINA_LINK_ENCODED_SIZE(508 - NINA_LINK_FRAME_OVERHEAD));
+	zassert_equal(frame[0], 0xFF);
+	zassert_equal(frame[255], 0xFF);
+	zassert_equal(frame[510], 0x01);
+}
+
+/* The worst case size is enough for every length and not larger than needed */
+ZTEST(nina_link, test_encoded_size)
+{
+	for (size_t len = 0; len <= MAX_PAYLOAD - 8; len++)
+	{
+		int frame_size;
+
+		payload_fill_nonzero_frame(len);
+		frame_size = nina_link_frame_encode(NINA_LINK_FRAME_DATA, payload, len, frame,
+											NINA_LINK_ENCODED_SIZE(len));
+
+		zassert_equal(frame_size, NINA_LINK_ENCODED_SIZE(len), "len %u", len);
+		zassert_equal(nina_link_frame_encode(NINA_LINK_FRAME_DATA, payload, len, frame,
+											 frame_size - 1),
+					  -ENOMEM, "len %u", len);
+	}
+}
+
+ZTEST(nina_link, test_crc_error)
+{
+	int frame_size;
+	const uint8_t *data;
+	uint8_t type;
+
+	memcpy(payload, "{\"speed\":\"23.41\"}", 17);
+	frame_size = nina_link_frame_encode(NINA_LINK_FRAME_DATA, payload, 17, frame, sizeof(frame));
+	zassert_true(frame_size > 0);
+
+	/* Every single bit error is detected */
+	for (int i = 0; i < frame_size - 1; i++)
+	{
+		for (int bit = 0; bit < 8; bit++)
+		{
+			frame[i] ^= BIT(bit);
+			zassert_true(nina_link_frame_decode(frame, frame_size - 1, decoded,
+												sizeof(decoded), &type, &data) < 0,
+						 "byte %d bit %d", i, bit);
+			frame[i] ^= BIT(bit);
+		}
+	}
+
+	/* A changed payload byte that keeps the COBS structure is a CRC error */
+	frame[5] ^= 0x03;
+	zassert_equal(nina_link_frame_decode(frame, frame_size - 1, decoded, sizeof(decoded), &type,
+										 &data),
+				  -EBADMSG);
+}
+
+ZTEST(nina_link, test_invalid_cobs)
+{
+	static const uint8_t zero_code[] = {0x03, 0x01, 0x02, 0x00, 0x01, 0x02, 0x03};
+	static const uint8_t past_end[] = {0x05, 0x01, 0x02};
+	static const uint8_t too_short[] = {0x03, 0x01, 0x02};
+	const uint8_t *data;
+	uint8_t type;
+	int frame_size;
+
+	zassert_equal(nina_link_frame_decode(zero_code, sizeof(zero_code), decoded,
+										 sizeof(decoded), &type, &data),
+				  -EINVAL);
+	zassert_equal(nina_link_frame_decode(past_end, sizeof(past_end), decoded, sizeof(decoded),
+										 &type, &data),
+				  -EINVAL);
+	zassert_equal(nina_link_frame_decode(too_short, sizeof(too_short), decoded, sizeof(decoded),
+										 &type, &data),
+				  -EINVAL);
+	zassert_equal(nina_link_frame_decode(NULL, 0, decoded, sizeof(decoded), &type, &data),
+				  -EINVAL);
+
+	payload_fill(100, true);
+	frame_size = nina_link_frame_encode(NINA_LINK_FRAME_DATA, payload, 100, frame, sizeof(frame));
+	zassert_true(frame_size > 0);
+	zassert_equal(nina_link_frame_decode(frame, frame_size - 1, decoded, 50, &type, &data),
+				  -ENOMEM);
+}
+
+/* Frames received in chunks are split by the line framer with the 0x00 delimiter */
+static uint32_t frames;
+static uint32_t frame_errors;
+
+static void frame_cb(const char *line, size_t line_size, void *user_data)
+{
+	const char *expected = nina_trace[frames % NINA_TRACE_LINES];
+	const uint8_t *data;
+	uint8_t type;
+	int len;
+
+	ARG_UNUSED(user_data);
+
+	len = nina_link_frame_decode((const uint8_t *)line, line_size, decoded, sizeof(decoded),
+								 &type, &data);
+
+	if ((len != strlen(expected)) || (type != NINA_LINK_FRAME_DATA) ||
+		(memcmp(data, expected, len) != 0))
+	{
+		frame_errors++;
+	}
+
+	frames++;
+}
+
+ZTEST(nina_link, test_framer)
+{
+	static uint8_t stream[8 * 1024];
+	static char carry[NINA_LINK_ENCODED_SIZE(MAX_PAYLOAD)];
+	struct line_framer framer;
+	uint32_t stream_frames = 0;
+	size_t stream_len = 0;
+
+	for (;;)
+	{
+		const char *line = nina_trace[stream_frames % NINA_TRACE_LINES];
+		int frame_size = nina_link_frame_encode(NINA_LINK_FRAME_DATA, (const uint8_t *)line,
+												strlen(line), &stream[stream_len],
+												sizeof(stream) - stream_len);
+
+		if (frame_size < 0)
+		{
+			break;
+		}
+
+		stream_len += frame_size;
+		stream_frames++;
+	}
+
+	for (size_t chunk = 1; chunk <= 300; chunk += 7)
+	{
+		frames = 0;
+		frame_errors = 0;
+		line_framer_init(&framer, NINA_LINK_DELIMITER, carry, sizeof(carry), frame_cb, NULL);
+
+		for (size_t i = 0; i < stream_len; i += chunk)
+		{
+			line_framer_feed(&framer, &stream[i], MIN(chunk, stream_len - i));
+		}
+
+		zassert_equal(frames, stream_frames, "chunk %u", chunk);
+		zassert_equal(frame_errors, 0, "chunk %u", chunk);
+	}
+}
+
+/* Simulated Nina module on the other end of the port */
+static struct
+{
+	/* Highest baud rate Nina supports, 0 if it only speaks text */
+	uint32_t max_baudrate;
+	uint8_t version;
+	/* Nina answers HELLO but does not come up at the new baud rate */
+	bool switch_fails;
+
+	uint32_t baudrate;
+	uint32_t nrf_baudrate;
+	int baudrate_set_err;
+	int baudrate_sets;
+
+	/* Answer waiting for the nRF91 and the baud rate it was sent at */
+	uint8_t answer_type;
+	uint32_t answer_baudrate;
+	uint8_t answer[NINA_LINK_HELLO_SIZE];
+	size_t answer_len;
+} nina;
+
+static void nina_answer(uint8_t type, const uint8_t *data, size_t len)
+{
+	nina.answer_type = type;
+	nina.answer_baudrate = nina.baudrate;
+	if (len > 0)
+	{
+		memcpy(nina.answer, data, len);
+	}
+	nina.answer_len = len;
+}
+
+static void port_send(const uint8_t *out, size_t len)
+{
+	const uint8_t *data;
+	uint8_t type;
+	int data_len;
+
+	zassert_equal(out[len - 1], NINA_LINK_DELIMITER);
+
+	/* Lost if both sides run at different baud rates */
+	if (nina.baudrate != nina.nrf_baudrate)
+	{
+		return;
+	}
+
+	data_len = nina_link_frame_decode(out, len - 1, decoded, sizeof(decoded), &type, &data);
+	zassert_true(data_len >= 0);
+
+	if ((type == NINA_LINK_FRAME_HELLO) && nina.max_baudrate)
+	{
+		uint8_t ack[NINA_LINK_HELLO_SIZE];
+		uint32_t baudrate;
+
+		zassert_equal(data_len, NINA_LINK_HELLO_SIZE);
+		zassert_equal(data[0], NINA_LINK_VERSION);
+
+		baudrate = MIN(sys_get_le32(&data[1]), nina.max_baudrate);
+		ack[0] = nina.version;
+		sys_put_le32(baudrate, &ack[1]);
+		nina_answer(NINA_LINK_FRAME_HELLO_ACK, ack, sizeof(ack));
+
+		if ((baudrate > DEFAULT_BAUDRATE) && !nina.switch_fails)
+		{
+			nina.baudrate = baudrate;
+		}
+	}
+	else if (type == NINA_LINK_FRAME_PROBE)
+	{
+		zassert_equal(data_len, 0);
+		nina_answer(NINA_LINK_FRAME_PROBE_ACK, NULL, 0);
+	}
+}
+
+static int port_receive(uint8_t type, uint8_t *data, size_t size, int32_t timeout_ms)
+{
+	zassert_true(timeout_ms > 0);
+
+	if ((nina.answer_type != type) || (nina.answer_baudrate != nina.nrf_baudrate))
+	{
+		return -ETIMEDOUT;
+	}
+
+	nina.answer_type = 0;
+	if (size > 0)
+	{
+		memcpy(data, nina.answer, MIN(size, nina.answer_len));
+	}
+
+	return nina.answer_len;
+}
+
+static int port_baudrate_set(uint32_t baudrate)
+{
+	nina.baudrate_sets++;
+
+	if (nina.baudrate_set_err)
+	{
+		return nina.baudrate_set_err;
+	}
+
+	nina.nrf_baudrate = baudrate;
+
+	return 0;
+}
+
+static const struct nina_link_port port = {
+	.send = port_send,
+	.receive = port_receive,
+	.baudrate_set = port_baudrate_set,
+};
+
+static int negotiate(uint32_t baudrate)
+{
+	return nina_link_negotiate(&port, DEFAULT_BAUDRATE, baudrate, 100);
+}
+
+static void nina_link_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	memset(&nina, 0, sizeof(nina));
+	nina.version = NINA_LINK_VERSION;
+	nina.baudrate = DEFAULT_BAUDRATE;
+	nina.nrf_baudrate = DEFAULT_BAUDRATE;
+}
+
+ZTEST(nina_link, test_negotiate)
+{
+	nina.max_baudrate = 1000000;
+
+	zassert_equal(negotiate(1000000), 1000000);
+	zassert_equal(nina.nrf_baudrate, 1000000);
+	zassert_equal(nina.baudrate_sets, 1);
+}
+
+/* Nina supports less than offered */
+ZTEST(nina_link, test_negotiate_lower)
+{
+	nina.max_baudrate = 460800;
+
+	zassert_equal(negotiate(1000000), 460800);
+	zassert_equal(nina.nrf_baudrate, 460800);
+}
+
+/* Older Nina firmware does not know HELLO */
+ZTEST(nina_link, test_negotiate_silent)
+{
+	zassert_equal(negotiate(1000000), -ETIMEDOUT);
+	zassert_equal(nina.nrf_baudrate, DEFAULT_BAUDRATE);
+	zassert_equal(nina.baudrate_sets, 0);
+}
+
+ZTEST(nina_link, test_negotiate_version)
+{
+	nina.max_baudrate = 1000000;
+	nina.version = NINA_LINK_VERSION + 1;
+
+	zassert_equal(negotiate(1000000), -EPROTONOSUPPORT);
+	zassert_equal(nina.baudrate_sets, 0);
+}
+
+/* Binary framing without a baud rate change */
+ZTEST(nina_link, test_negotiate_default)
+{
+	nina.max_baudrate = DEFAULT_BAUDRATE;
+
+	zassert_equal(negotiate(1000000), DEFAULT_BAUDRATE);
+	zassert_equal(nina.baudrate_sets, 0);
+
+	nina.max_baudrate = 1000000;
+
+	zassert_equal(negotiate(9600), DEFAULT_BAUDRATE);
+	zassert_equal(nina.baudrate_sets, 0);
+}
+
+/* No PROBE_ACK at the new baud rate, back to the default */
+ZTEST(nina_link, test_negotiate_probe_lost)
+{
+	nina.max_baudrate = 1000000;
+	nina.switch_fails = true;
+
+	zassert_equal(negotiate(1000000), -EIO);
+	zassert_equal(nina.nrf_baudrate, DEFAULT_BAUDRATE);
+	zassert_equal(nina.baudrate_sets, 2);
+}
+
+ZTEST(nina_link, test_negotiate_uart_error)
+{
+	nina.max_baudrate = 1000000;
+	nina.baudrate_set_err = -ENOTSUP;
+
+	zassert_equal(negotiate(1000000), -EIO);
+	zassert_equal(nina.nrf_baudrate, DEFAULT_BAUDRATE);
+	zassert_equal(nina.baudrate_sets, 2);
+}
+
+ZTEST_SUITE(nina_link, NULL, NULL, nina_link_before, NULL, NULL);
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2023 Nordic Semiconductor ASA
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+/* Lines per second the Nina reception paths of the trigger module sustain on a recorded trace:
+ * the original handler taking one interrupt per byte, the interrupt driven line ring and the
+ * asynchronous DMA reception with the line framer. Only the framing work is measured, the UART
+ * driver is not part of the test.
+ */
+
+#include <zephyr/ztest.h>
+
+#include "bench.h"
+#include "line_framer.h"
+#include "line_ring.h"
+#include "nina_trace.h"
+
+#define TRACE_SIZE (16 * 1024)
+#define PAYLOAD_SIZE 700
+#define FIFO_SIZE 16
+#define DMA_BUF_SIZE CONFIG_MQTT_SAMPLE_TRIGGER_ASYNC_BUF_SIZE
+#define ROUNDS 200
+
+static uint8_t trace[TRACE_SIZE];
+static size_t trace_len;
+static uint32_t trace_lines;
+
+/* What the trigger thread publishes, every path copies the line here */
+static char payload[PAYLOAD_SIZE];
+static uint32_t lines;
+static uint32_t line_bytes;
+
+/* Interrupts or DMA buffers the path handles, the per event cost of the driver comes on top */
+static uint32_t events;
+
+/* Checks every line against the trace instead of only counting it */
+static bool verify;
+static uint32_t mismatches;
+
+static void line_published(size_t len)
+{
+	if (verify)
+	{
+		const char *expected = nina_trace[lines % NINA_TRACE_LINES];
+
+		if ((len != strlen(expected)) || (memcmp(payload, expected, len) != 0))
+		{
+			mismatches++;
+		}
+	}
+
+	lines++;
+	line_bytes += len;
+}
+
+/* Original interrupt handler, one interrupt per byte, the line is copied with snprintk */
+static char byte_rx_buf[512];
+static int byte_index;
+
+static void __noinline byte_irq_handler(uint8_t rx_byte)
+{
+	events++;
+
+	if (rx_byte == '\n')
+	{
+		memset(payload, 0, sizeof(payload));
+		line_published(snprintk(payload, sizeof(payload), "%s", byte_rx_buf));
+		memset(byte_rx_buf, 0, sizeof(byte_rx_buf));
+		byte_index = 0;
+	}
+	else if (byte_index < sizeof(byte_rx_buf) - 1)
+	{
+		byte_rx_buf[byte_index++] = rx_byte;
+	}
+}
+
+static void byte_irq_run(void)
+{
+	for (size_t i = 0; i < trace_len; i++)
+	{
+		byte_irq_handler(trace[i]);
+	}
+}
+
+/* Interrupt driven reception, one interrupt per FIFO fill into the line ring, the trigger thread
+ * reassembles spilled lines
+ */
+static struct line_ring ring;
+static size_t ring_payload_len;
+
+static bool __noinline ring_irq_handler(const uint8_t *fifo, size_t len)
+{
+	bool line_complete = false;
+
+	events++;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		line_complete |= line_ring_put(&ring, fifo[i], '\n');
+	}
+
+	return line_complete;
+}
+
+static void ring_process(void)
+{
+	struct line_ring_slot *slot;
+
+	while ((slot = line_ring_peek(&ring)) != NULL)
+	{
+		if (!(slot->flags & LINE_RING_FLAG_CONT))
+		{
+			ring_payload_len = 0;
+		}
+
+		size_t copy = MIN(slot->len, sizeof(payload) - 1 - ring_payload_len);
+
+		memcpy(&payload[ring_payload_len], slot->data, copy);
+		ring_payload_len += copy;
+
+		if (!(slot->flags & LINE_RING_FLAG_MORE))
+		{
+			payload[ring_payload_len] = '\0';
+			line_published(ring_payload_len);
+		}
+
+		line_ring_release(&ring);
+	}
+}
+
+static void ring_irq_run(void)
+{
+	for (size_t i = 0; i < trace_len; i += FIFO_SIZE)
+	{
+		if (ring_irq_handler(&trace[i], MIN(FIFO_SIZE, trace_len - i)))
+		{
+			ring_process();
+		}
+	}
+}
+
+/* Asynchronous reception, the trigger thread frames every DMA buffer */
+static struct line_framer framer;
+static char carry[512];
+
+static void framer_line_cb(const char *line, size_t line_size, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	line_size = MIN(line_size, sizeof(payload) - 1);
+	memcpy(payload, line, line_size);
+	payload[line_size] = '\0';
+	line_published(line_size);
+}
+
+static void async_run(void)
+{
+	for (size_t i = 0; i < trace_len; i += DMA_BUF_SIZE)
+	{
+		events++;
+		line_framer_feed(&framer, &trace[i], MIN(DMA_BUF_SIZE, trace_len - i));
+	}
+}
+
+static void *rx_setup(void)
+{
+	trace_len = nina_trace_fill(trace, sizeof(trace), '\n', &trace_lines);
+
+	return NULL;
+}
+
+static void rx_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	lines = 0;
+	line_bytes = 0;
+	events = 0;
+	mismatches = 0;
+	byte_index = 0;
+	memset(byte_rx_buf, 0, sizeof(byte_rx_buf));
+	line_ring_init(&ring);
+	line_framer_init(&framer, '\n', carry, sizeof(carry), framer_line_cb, NULL);
+}
+
+/* Lines per second of the last run */
+static uint32_t lines_per_s;
+
+/* Runs a path over the trace and checks the lines it publishes */
+static void run(const char *name, void (*path)(void))
+{
+	int64_t start;
+	int64_t ns;
+
+	verify = true;
+	path();
+	zassert_equal(lines, trace_lines, "%s: lines lost", name);
+	zassert_equal(mismatches, 0, "%s: lines corrupted", name);
+
+	verify = false;
+	lines = 0;
+	line_bytes = 0;
+	events = 0;
+	start = bench_cpu_ns();
+
+	for (int i = 0; i < ROUNDS; i++)
+	{
+		path();
+	}
+
+	ns = MAX(bench_cpu_ns() - start, 1);
+	zassert_equal(lines, trace_lines * ROUNDS);
+
+	lines_per_s = (uint32_t)((int64_t)lines * NSEC_PER_SEC / ns);
+	TC_PRINT("%-10s %8u lines/s, %6u kB/s, %4u ns/line, %u.%02u events/line\n", name,
+			 lines_per_s, (uint32_t)((int64_t)line_bytes * NSEC_PER_SEC / ns / 1024),
+			 (uint32_t)(ns / lines), events / lines, (events % lines) * 100 / lines);
+}
+
+ZTEST(rx_throughput, test_byte_irq)
+{
+	run("byte irq", byte_irq_run);
+}
+
+ZTEST(rx_throughput, test_ring_irq)
+{
+	run("ring irq", ring_irq_run);
+}
+
+ZTEST(rx_throughput, test_async)
+{
+	run("async", async_run);
+}
+
+/* At 115200 baud the Nina link carries about 11520 bytes per second, every path has to keep up
+ * with it by far.
+ */
+ZTEST(rx_throughput, test_line_rate)
+{
+	run("async", async_run);
+	zassert_true((uint64_t)lines_per_s * (trace_len / trace_lines) > 10 * 11520,
+				 "Framing slower than ten times the line rate");
+}
+
+ZTEST_SUITE(rx_throughput, NULL, rx_setup, rx_before, NULL, NULL);